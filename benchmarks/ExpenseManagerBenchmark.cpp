@@ -0,0 +1,274 @@
+#include <benchmark/benchmark.h>
+#include <fstream>
+#include "LedgerGenerator.h"
+
+// Every benchmark takes the ledger size as its argument. Results can be saved
+// for comparison between releases with:
+//   pfm_benchmarks --benchmark_out=results.json --benchmark_out_format=json
+
+namespace {
+
+void ledgerSizes(benchmark::internal::Benchmark* benchmark)
+{
+    benchmark->RangeMultiplier(10)->Range(10000, 10000000)->Unit(benchmark::kMillisecond);
+}
+
+void ledgerSizesByFormat(benchmark::internal::Benchmark* benchmark)
+{
+    benchmark->ArgsProduct({benchmark::CreateRange(10000, 10000000, 10),
+                            {static_cast<int>(StorageFormat::Json), static_cast<int>(StorageFormat::Compact)}})
+             ->Unit(benchmark::kMillisecond);
+}
+
+// Rewrites a ledger in the single-file format so that loading it marks every
+// partition dirty and the next save writes all of them, in the given format
+std::string legacyCopy(size_t rows, StorageFormat format = StorageFormat::Json)
+{
+    std::string dataFile = LedgerGenerator::scratchCopy(rows, format == StorageFormat::Compact ? "legacy_compact"
+                                                                                              : "legacy");
+    ExpenseManager manager(dataFile);
+    
+    json j;
+    j["expenses"] = json::array();
+    for (const auto& expense : manager.snapshot()->getAllExpenses()) {
+        j["expenses"].push_back({
+            {"id", expense.id},
+            {"amount", expense.amount},
+            {"description", expense.description},
+            {"category", expense.category},
+            {"date", expense.date}
+        });
+    }
+    j["categories"] = json::array();
+    for (const auto& category : manager.getAllCategories()) {
+        j["categories"].push_back({{"name", category.name}, {"description", category.description}});
+    }
+    j["nextExpenseId"] = static_cast<int>(rows) + 1;
+    j["storage"] = format == StorageFormat::Compact ? "compact" : "json";
+    
+    std::string legacyFile = dataFile + ".legacy";
+    std::ofstream file(legacyFile);
+    file << j.dump();
+    return legacyFile;
+}
+
+// Copy of the ledger converted to the given storage format
+std::string formatCopy(size_t rows, StorageFormat format)
+{
+    std::string dataFile = LedgerGenerator::scratchCopy(rows, format == StorageFormat::Compact ? "compact" : "json");
+    ExpenseManager manager(dataFile);
+    manager.setStorageFormat(format);
+    return dataFile;
+}
+
+// Manifest plus partitions, leaving out the benchmark's own legacy copy
+double bytesOnDisk(const std::string& dataFile)
+{
+    double bytes = 0;
+    for (const auto& entry : std::filesystem::directory_iterator(std::filesystem::path(dataFile).parent_path())) {
+        if (entry.path().extension() != ".legacy") {
+            bytes += entry.file_size();
+        }
+    }
+    return bytes;
+}
+
+} // namespace
+
+// Startup cost: manifest plus the current year
+static void BM_LoadData(benchmark::State& state)
+{
+    ExpenseManager manager(LedgerGenerator::ledgerPath(state.range(0)));
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(manager.loadData());
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_LoadData)->Apply(ledgerSizes);
+
+// Cost of a report that touches every year
+static void BM_LoadAllPartitions(benchmark::State& state)
+{
+    ExpenseManager manager(LedgerGenerator::ledgerPath(state.range(0)));
+    for (auto _ : state) {
+        manager.loadData();
+        benchmark::DoNotOptimize(manager.snapshot());
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_LoadAllPartitions)->Apply(ledgerSizes);
+
+// Full save of every partition and the manifest
+static void BM_SaveData(benchmark::State& state)
+{
+    std::string legacyFile = legacyCopy(state.range(0));
+    std::string dataFile = legacyFile.substr(0, legacyFile.size() - std::string(".legacy").size());
+    ExpenseManager manager(dataFile);
+    for (auto _ : state) {
+        state.PauseTiming();
+        std::filesystem::copy_file(legacyFile, dataFile, std::filesystem::copy_options::overwrite_existing);
+        manager.loadData();
+        state.ResumeTiming();
+        
+        benchmark::DoNotOptimize(manager.saveData());
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_SaveData)->Apply(ledgerSizes);
+
+// Full save in each storage format; the second argument is the StorageFormat.
+// The "bytes" counter is the size of the ledger on disk.
+static void BM_SaveDataByFormat(benchmark::State& state)
+{
+    std::string legacyFile = legacyCopy(state.range(0), static_cast<StorageFormat>(state.range(1)));
+    std::string dataFile = legacyFile.substr(0, legacyFile.size() - std::string(".legacy").size());
+    ExpenseManager manager(dataFile);
+    for (auto _ : state) {
+        state.PauseTiming();
+        std::filesystem::copy_file(legacyFile, dataFile, std::filesystem::copy_options::overwrite_existing);
+        manager.loadData();
+        state.ResumeTiming();
+        
+        benchmark::DoNotOptimize(manager.saveData());
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+    state.counters["bytes"] = bytesOnDisk(dataFile);
+}
+BENCHMARK(BM_SaveDataByFormat)->Apply(ledgerSizesByFormat);
+
+// Load of every partition in each storage format
+static void BM_LoadAllPartitionsByFormat(benchmark::State& state)
+{
+    std::string dataFile = formatCopy(state.range(0), static_cast<StorageFormat>(state.range(1)));
+    ExpenseManager manager(dataFile);
+    for (auto _ : state) {
+        manager.loadData();
+        benchmark::DoNotOptimize(manager.snapshot());
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+    state.counters["bytes"] = bytesOnDisk(dataFile);
+}
+BENCHMARK(BM_LoadAllPartitionsByFormat)->Apply(ledgerSizesByFormat);
+
+// Startup integrity check of every partition in each storage format
+static void BM_VerifyStorage(benchmark::State& state)
+{
+    std::string dataFile = formatCopy(state.range(0), static_cast<StorageFormat>(state.range(1)));
+    ExpenseManager manager(dataFile);
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(manager.verifyStorage());
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+    state.counters["bytes"] = bytesOnDisk(dataFile);
+}
+BENCHMARK(BM_VerifyStorage)->Apply(ledgerSizesByFormat)->UseRealTime();
+
+// Single insert, including the save of the current year
+static void BM_AddExpense(benchmark::State& state)
+{
+    ExpenseManager manager(LedgerGenerator::scratchCopy(state.range(0), "add"));
+    LedgerGenerator generator(7);
+    std::vector<Expense> expenses = generator.generate(1000, 1);
+    size_t next = 0;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(manager.addExpense(expenses[next++ % expenses.size()]));
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_AddExpense)->Apply(ledgerSizes);
+
+// Batch insert of 1000 expenses with a single save
+static void BM_AddExpenseBatch(benchmark::State& state)
+{
+    ExpenseManager manager(LedgerGenerator::scratchCopy(state.range(0), "batch"));
+    LedgerGenerator generator(7);
+    std::vector<Expense> expenses = generator.generate(1000, 1);
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(manager.addExpenses(expenses));
+    }
+    state.SetItemsProcessed(state.iterations() * expenses.size());
+}
+BENCHMARK(BM_AddExpenseBatch)->Apply(ledgerSizes);
+
+static void BM_GetExpensesByMonth(benchmark::State& state)
+{
+    ExpenseManager manager(LedgerGenerator::ledgerPath(state.range(0)));
+    int year = DateUtils::currentYear();
+    int month = 0;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(manager.getExpensesByMonth(year, month++ % 12 + 1));
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_GetExpensesByMonth)->Apply(ledgerSizes);
+
+// Month lookups from several threads at once
+static void BM_GetExpensesByMonthConcurrent(benchmark::State& state)
+{
+    static ExpenseManager* manager = nullptr;
+    if (state.thread_index() == 0) {
+        manager = new ExpenseManager(LedgerGenerator::ledgerPath(state.range(0)));
+    }
+    int year = DateUtils::currentYear();
+    int month = state.thread_index();
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(manager->getExpensesByMonth(year, month++ % 12 + 1));
+    }
+    state.SetItemsProcessed(state.iterations());
+    if (state.thread_index() == 0) {
+        delete manager;
+        manager = nullptr;
+    }
+}
+BENCHMARK(BM_GetExpensesByMonthConcurrent)->Apply(ledgerSizes)->Threads(4)->UseRealTime();
+
+static void BM_GenerateCategorySummary(benchmark::State& state)
+{
+    ExpenseManager manager(LedgerGenerator::ledgerPath(state.range(0)));
+    int firstYear = DateUtils::currentYear() - 9;
+    int month = 0;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(manager.generateCategorySummary(firstYear + month / 12 % 10, month % 12 + 1));
+        ++month;
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_GenerateCategorySummary)->Apply(ledgerSizes);
+
+// Adding and deleting an unused category, each with its save
+static void BM_CategoryOps(benchmark::State& state)
+{
+    ExpenseManager manager(LedgerGenerator::scratchCopy(state.range(0), "category"));
+    Category category("Benchmark", "Temporary category");
+    for (auto _ : state) {
+        manager.addCategory(category);
+        benchmark::DoNotOptimize(manager.deleteCategory(category.name));
+    }
+    state.SetItemsProcessed(state.iterations() * 2);
+}
+BENCHMARK(BM_CategoryOps)->Apply(ledgerSizes);
+
+static void BM_SearchExpenses(benchmark::State& state)
+{
+    ExpenseManager manager(LedgerGenerator::ledgerPath(state.range(0)));
+    SearchFilters filters;
+    filters.limit = 500;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(manager.searchExpenses("star cof", filters));
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_SearchExpenses)->Apply(ledgerSizes);
+
+// Whole-ledger dedup pass; the second argument is the thread count
+static void BM_FindDuplicateGroups(benchmark::State& state)
+{
+    ExpenseManager manager(LedgerGenerator::ledgerPath(state.range(0)));
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(manager.findDuplicateGroups(static_cast<unsigned int>(state.range(1))));
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_FindDuplicateGroups)
+    ->ArgsProduct({benchmark::CreateRange(10000, 10000000, 10), {1, 4}})
+    ->Unit(benchmark::kMillisecond);
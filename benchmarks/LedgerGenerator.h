@@ -0,0 +1,89 @@
+#ifndef LEDGER_GENERATOR_H
+#define LEDGER_GENERATOR_H
+
+#include <string>
+#include <vector>
+#include <random>
+#include <filesystem>
+#include "core/Expense.h"
+#include "core/ExpenseManager.h"
+#include "core/DateUtils.h"
+
+// Deterministic synthetic ledgers for benchmarking. The same row count
+// always produces the same data, so results are comparable between runs.
+class LedgerGenerator {
+public:
+    explicit LedgerGenerator(unsigned int seed = 20240101) : m_random(seed) {}
+    
+    // Rows spread evenly over the last `years` years, ending in the current one
+    std::vector<Expense> generate(size_t rows, int years = 10)
+    {
+        static const char* merchants[] = {
+            "Uber ride", "Netflix subscription", "Whole Foods groceries", "Shell gas station",
+            "Starbucks coffee", "Amazon order", "City power bill", "Comcast internet",
+            "CVS pharmacy", "Cinema tickets", "Rent payment", "Gym membership",
+            "Bookstore", "Spotify premium", "Airline tickets", "Pizza delivery"
+        };
+        static const char* categories[] = {
+            "Transportation", "Entertainment", "Food", "Transportation",
+            "Food", "Miscellaneous", "Utilities", "Utilities",
+            "Health", "Entertainment", "Housing", "Health",
+            "Education", "Entertainment", "Transportation", "Food"
+        };
+        const size_t merchantCount = sizeof(merchants) / sizeof(merchants[0]);
+        
+        int lastYear = DateUtils::currentYear();
+        int firstYear = lastYear - years + 1;
+        std::uniform_int_distribution<size_t> merchant(0, merchantCount - 1);
+        std::uniform_int_distribution<int> year(firstYear, lastYear);
+        std::uniform_int_distribution<int> month(1, 12);
+        std::uniform_int_distribution<int> day(1, 28);
+        std::uniform_int_distribution<int> cents(100, 50000);
+        std::uniform_int_distribution<int> reference(1, 9999);
+        
+        std::vector<Expense> expenses;
+        expenses.reserve(rows);
+        for (size_t i = 0; i < rows; ++i) {
+            size_t index = merchant(m_random);
+            expenses.push_back(Expense(0, cents(m_random) / 100.0,
+                                       std::string(merchants[index]) + " #" + std::to_string(reference(m_random)),
+                                       categories[index],
+                                       DateUtils::formatDate(year(m_random), month(m_random), day(m_random))));
+        }
+        return expenses;
+    }
+    
+    // Path of a saved ledger with `rows` expenses, generated on first use and
+    // reused by later runs from the system temp directory
+    static std::string ledgerPath(size_t rows)
+    {
+        std::filesystem::path directory = std::filesystem::temp_directory_path() / "pfm_benchmarks" /
+                                          std::to_string(rows);
+        std::filesystem::path dataFile = directory / "expenses.json";
+        if (!std::filesystem::exists(dataFile)) {
+            std::filesystem::remove_all(directory);
+            std::filesystem::create_directories(directory);
+            
+            ExpenseManager manager(dataFile.string());
+            LedgerGenerator generator;
+            manager.addExpenses(generator.generate(rows));
+        }
+        return dataFile.string();
+    }
+    
+    // Private copy of the ledger for benchmarks that modify it
+    static std::string scratchCopy(size_t rows, const std::string& name)
+    {
+        std::filesystem::path source = std::filesystem::path(ledgerPath(rows)).parent_path();
+        std::filesystem::path directory = std::filesystem::temp_directory_path() / "pfm_benchmarks" /
+                                          (name + "_" + std::to_string(rows));
+        std::filesystem::remove_all(directory);
+        std::filesystem::copy(source, directory, std::filesystem::copy_options::recursive);
+        return (directory / "expenses.json").string();
+    }
+    
+private:
+    std::mt19937 m_random;
+};
+
+#endif // LEDGER_GENERATOR_H
@@ -0,0 +1,79 @@
+#ifndef COMMAND_PROCESSOR_H
+#define COMMAND_PROCESSOR_H
+
+#include <string>
+#include <vector>
+#include <functional>
+#include "../core/ExpenseManager.h"
+#include "../core/Workspace.h"
+
+// Executes JSON requests against an ExpenseManager, or against the ledgers of
+// a Workspace, picked by the request's "ledger" field. Shared by one-off CLI
+// invocations and the query server, so both speak the same protocol:
+//
+//   {"command": "month", "year": 2024, "month": 3}
+//   -> {"ok": true, "result": [...]}  or  {"ok": false, "error": "..."}
+//
+// An array of requests is a batch and yields an array of responses, one per
+// request, in order. Safe to call from several threads at once.
+class CommandProcessor {
+public:
+    CommandProcessor(ExpenseManager* manager);
+    CommandProcessor(Workspace* workspace);  // Requests without a "ledger" go to its first one
+    
+    json execute(const json& request);
+    json executeLine(const std::string& line);  // Parses first; malformed JSON gives an error response
+    
+    // Serializes a request or response without throwing: text imported in
+    // another encoding may not be valid UTF-8, and is replaced with U+FFFD
+    static std::string dump(const json& message, int indent = -1);
+    
+    // Called by the "shutdown" command; without a handler the command fails
+    void setShutdownHandler(std::function<void()> handler);
+    
+    // Names of the supported commands, for usage output
+    static std::vector<std::string> commandNames();
+    
+private:
+    ExpenseManager* m_manager;
+    Workspace* m_workspace;
+    std::function<void()> m_shutdownHandler;
+    
+    json executeOne(const json& request);
+    json addExpense(const json& request);
+    json updateExpense(const json& request);
+    json deleteExpense(const json& request);
+    json getExpense(const json& request);
+    json expensesByMonth(const json& request);
+    json expensesByCategory(const json& request);
+    json search(const json& request);
+    json query(const json& request);
+    json report(const json& request);
+    json categories(const json& request);
+    json addCategory(const json& request);
+    json deleteCategory(const json& request);
+    json budgets(const json& request);
+    json setBudget(const json& request);
+    json removeBudget(const json& request);
+    json recurringRules(const json& request);
+    json addRecurringRule(const json& request);
+    json deleteRecurringRule(const json& request);
+    json materializeRecurring(const json& request);
+    json duplicates(const json& request);
+    json deduplicate(const json& request);
+    json duplicatePolicy(const json& request);
+    json undo(const json& request);
+    json redo(const json& request);
+    json storageFormat(const json& request);
+    json verifyStorage(const json& request);
+    json recoverData(const json& request);
+    json importFile(const json& request);
+    json exportFile(const json& request);
+    json metrics(const json& request);
+    json ledgers(const json& request);
+    json addLedger(const json& request);
+    json removeLedger(const json& request);
+    json consolidatedReport(const json& request);
+};
+
+#endif // COMMAND_PROCESSOR_H
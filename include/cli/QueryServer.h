@@ -0,0 +1,44 @@
+#ifndef QUERY_SERVER_H
+#define QUERY_SERVER_H
+
+#include <string>
+#include <vector>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include "CommandProcessor.h"
+
+// Serves CommandProcessor requests over a Unix domain socket so scripts can
+// query a ledger that stays loaded and indexed between invocations.
+//
+// The protocol is newline-delimited JSON: each line a client sends is one
+// request (or a batch array) and gets exactly one response line back. Each
+// client is handled on its own thread; reads run concurrently under the
+// ExpenseManager's shared lock.
+class QueryServer {
+public:
+    QueryServer(CommandProcessor* processor, const std::string& socketPath);
+    ~QueryServer();
+    
+    bool start();  // Binds and listens; replaces a stale socket file
+    void run();    // Accepts clients until stop() is called
+    void stop();   // Safe from any thread and from signal handlers; run() returns shortly after
+    
+    // Sends one request line to a running server and waits for the reply
+    static bool sendRequest(const std::string& socketPath, const std::string& requestLine,
+                            std::string& responseLine);
+                            
+private:
+    CommandProcessor* m_processor;
+    std::string m_socketPath;
+    int m_listenSocket;
+    std::atomic<bool> m_running;
+    
+    std::mutex m_clientsMutex;
+    std::condition_variable m_clientsDone;
+    std::vector<int> m_clientSockets;  // Connected clients; run() waits for them to finish
+    
+    void serveClient(int clientSocket);
+};
+
+#endif // QUERY_SERVER_H
@@ -0,0 +1,47 @@
+#ifndef BUDGET_H
+#define BUDGET_H
+
+#include <string>
+#include <vector>
+
+enum class BudgetPeriod {
+    Monthly,
+    Yearly
+};
+
+// Spending limit for one category, or for all spending when category is empty
+struct Budget {
+    std::string category;
+    BudgetPeriod period;
+    double limit;
+    std::vector<double> thresholds;  // Fractions of the limit that raise an alert when crossed
+    
+    Budget() : period(BudgetPeriod::Monthly), limit(0.0), thresholds({0.8, 1.0}) {}
+    
+    Budget(const std::string& category, BudgetPeriod period, double limit)
+        : category(category), period(period), limit(limit), thresholds({0.8, 1.0}) {}
+    
+    bool isOverall() const { return category.empty(); }
+};
+
+// Spending against a budget in one period
+struct BudgetStatus {
+    Budget budget;
+    int year;
+    int month;     // 0 for yearly budgets
+    double spent;
+    
+    BudgetStatus() : year(0), month(0), spent(0.0) {}
+    
+    double utilization() const { return budget.limit > 0.0 ? spent / budget.limit : 0.0; }
+};
+
+// Raised when a change pushes spending across one of a budget's thresholds
+struct BudgetAlert {
+    BudgetStatus status;
+    double threshold;  // The highest threshold crossed
+    
+    BudgetAlert() : threshold(0.0) {}
+};
+
+#endif // BUDGET_H
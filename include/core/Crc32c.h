@@ -0,0 +1,23 @@
+#ifndef CRC32C_H
+#define CRC32C_H
+
+#include <cstddef>
+#include <cstdint>
+
+// CRC-32C (Castagnoli), as used by iSCSI and ext4. Computed with the SSE4.2
+// crc32 instruction when the CPU has it, otherwise with a slicing-by-8 table.
+namespace Crc32c {
+
+// Continues a checksum over more data; start from 0
+uint32_t extend(uint32_t crc, const void* data, size_t size);
+
+inline uint32_t compute(const void* data, size_t size)
+{
+    return extend(0, data, size);
+}
+
+bool isHardwareAccelerated();
+
+} // namespace Crc32c
+
+#endif // CRC32C_H
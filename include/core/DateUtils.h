@@ -0,0 +1,141 @@
+#ifndef DATE_UTILS_H
+#define DATE_UTILS_H
+
+#include <string>
+#include <cstdio>
+#include <ctime>
+
+// Helpers for the YYYY-MM-DD date strings stored in Expense::date
+namespace DateUtils {
+
+inline bool isLeapYear(int year)
+{
+    return (year % 4 == 0 && year % 100 != 0) || year % 400 == 0;
+}
+
+inline int daysInMonth(int year, int month)
+{
+    static const int days[] = {31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31};
+    if (month == 2 && isLeapYear(year)) {
+        return 29;
+    }
+    return days[month - 1];
+}
+
+// Strict parse of "YYYY-MM-DD"; returns false for malformed or out-of-range dates
+inline bool parseDate(const std::string& date, int& year, int& month, int& day)
+{
+    if (date.size() != 10 || date[4] != '-' || date[7] != '-') {
+        return false;
+    }
+    
+    int values[3] = {0, 0, 0};
+    const int starts[3] = {0, 5, 8};
+    const int lengths[3] = {4, 2, 2};
+    for (int part = 0; part < 3; ++part) {
+        for (int i = 0; i < lengths[part]; ++i) {
+            char c = date[starts[part] + i];
+            if (c < '0' || c > '9') {
+                return false;
+            }
+            values[part] = values[part] * 10 + (c - '0');
+        }
+    }
+    
+    if (values[1] < 1 || values[1] > 12 || values[2] < 1 || values[2] > daysInMonth(values[0], values[1])) {
+        return false;
+    }
+    
+    year = values[0];
+    month = values[1];
+    day = values[2];
+    return true;
+}
+
+inline bool isValidDate(const std::string& date)
+{
+    int year, month, day;
+    return parseDate(date, year, month, day);
+}
+
+// Storage key for the month of a date, YYYYMM; 0 for unparseable dates
+inline int monthKey(const std::string& date)
+{
+    int year, month, day;
+    return parseDate(date, year, month, day) ? year * 100 + month : 0;
+}
+
+inline int monthKey(int year, int month)
+{
+    return year * 100 + month;
+}
+
+// std::localtime shares one buffer between threads; ledgers are read from several
+inline std::tm localNow()
+{
+    std::time_t now = std::time(nullptr);
+    std::tm local;
+#ifdef _WIN32
+    localtime_s(&local, &now);
+#else
+    localtime_r(&now, &local);
+#endif
+    return local;
+}
+
+inline int currentYear()
+{
+    return localNow().tm_year + 1900;
+}
+
+inline std::string formatDate(int year, int month, int day)
+{
+    char buffer[32];
+    std::snprintf(buffer, sizeof(buffer), "%04d-%02d-%02d", year, month, day);
+    return buffer;
+}
+
+// Days since 1970-01-01 in the proleptic Gregorian calendar
+inline long daysFromCivil(int year, int month, int day)
+{
+    year -= month <= 2;
+    long era = (year >= 0 ? year : year - 399) / 400;
+    long yearOfEra = year - era * 400;
+    long dayOfYear = (153 * (month + (month > 2 ? -3 : 9)) + 2) / 5 + day - 1;
+    long dayOfEra = yearOfEra * 365 + yearOfEra / 4 - yearOfEra / 100 + dayOfYear;
+    return era * 146097 + dayOfEra - 719468;
+}
+
+inline void civilFromDays(long days, int& year, int& month, int& day)
+{
+    days += 719468;
+    long era = (days >= 0 ? days : days - 146096) / 146097;
+    long dayOfEra = days - era * 146097;
+    long yearOfEra = (dayOfEra - dayOfEra / 1460 + dayOfEra / 36524 - dayOfEra / 146096) / 365;
+    long dayOfYear = dayOfEra - (365 * yearOfEra + yearOfEra / 4 - yearOfEra / 100);
+    long monthIndex = (5 * dayOfYear + 2) / 153;
+    day = static_cast<int>(dayOfYear - (153 * monthIndex + 2) / 5 + 1);
+    month = static_cast<int>(monthIndex < 10 ? monthIndex + 3 : monthIndex - 9);
+    year = static_cast<int>(yearOfEra + era * 400 + (month <= 2));
+}
+
+// Shifts a valid date by a number of days; returns "" for malformed dates
+inline std::string addDays(const std::string& date, long days)
+{
+    int year, month, day;
+    if (!parseDate(date, year, month, day)) {
+        return "";
+    }
+    civilFromDays(daysFromCivil(year, month, day) + days, year, month, day);
+    return formatDate(year, month, day);
+}
+
+inline std::string today()
+{
+    std::tm local = localNow();
+    return formatDate(local.tm_year + 1900, local.tm_mon + 1, local.tm_mday);
+}
+
+} // namespace DateUtils
+
+#endif // DATE_UTILS_H
@@ -0,0 +1,58 @@
+#ifndef DUPLICATE_INDEX_H
+#define DUPLICATE_INDEX_H
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <cstdint>
+#include "Expense.h"
+
+enum class DuplicatePolicy {
+    Allow,   // Insert without checking
+    Flag,    // Insert, and report the expense it matched
+    Reject   // Skip the new expense
+};
+
+// A new expense and the stored one it was taken for a duplicate of
+struct DuplicateMatch {
+    Expense expense;
+    Expense existing;
+};
+
+// Expenses the dedup pass considers copies of one another
+struct DuplicateGroup {
+    Expense keeper;                   // Earliest date, then lowest id
+    std::vector<Expense> duplicates;  // Ascending by date, then id
+};
+
+// Hash index over a normalized fingerprint: the amount in cents, the category,
+// and the description lower-cased with runs of punctuation and spaces
+// collapsed. Entries are keyed by fingerprint and day, so a lookup probes one
+// bucket per day of the window no matter how often an expense recurs.
+class DuplicateIndex {
+public:
+    void add(const Expense& expense);
+    void remove(const Expense& expense);
+    void clear();
+    void reserve(size_t count);
+    
+    // Ids other than excludeId whose fingerprint matches and whose date is within
+    // windowDays, nearest date first. Fingerprints are hashes: confirm with equivalent().
+    std::vector<int> candidates(const Expense& expense, int windowDays, int excludeId = 0) const;
+    
+    static uint64_t fingerprint(const Expense& expense);
+    static bool equivalent(const Expense& a, const Expense& b);  // Same fingerprint fields, any date
+    static long dayNumber(const std::string& date);              // Days since 1970-01-01; 0 if malformed
+    
+private:
+    struct Entry {
+        int day;
+        int id;
+    };
+    
+    static uint64_t key(uint64_t fingerprint, long day);
+    
+    std::unordered_multimap<uint64_t, Entry> m_entries;  // Keyed by fingerprint and day
+};
+
+#endif // DUPLICATE_INDEX_H
@@ -0,0 +1,91 @@
+#ifndef EXPENSE_IMPORTER_H
+#define EXPENSE_IMPORTER_H
+
+#include <string>
+#include <vector>
+#include <cstddef>
+#include "ExpenseManager.h"
+
+enum class ImportFormat {
+    Auto,   // Detected from the file extension, then from the content
+    Csv,
+    Ofx
+};
+
+// How a CSV file signs its expenses. Rows of the other sign (refunds,
+// credits) are reported as errors. OFX debits are always negative.
+enum class AmountSign {
+    Auto,      // The sign most rows of the file have
+    Positive,
+    Negative   // As in most bank exports
+};
+
+// Maps a source category or description onto one of the ledger categories
+struct CategoryRule {
+    std::string pattern;   // Case-insensitive substring
+    std::string category;  // Must name an existing category
+    
+    CategoryRule() {}
+    
+    CategoryRule(const std::string& pattern, const std::string& category)
+        : pattern(pattern), category(category) {}
+};
+
+struct ImportError {
+    size_t line;
+    std::string message;
+    
+    ImportError() : line(0) {}
+    
+    ImportError(size_t line, const std::string& message)
+        : line(line), message(message) {}
+};
+
+struct ImportResult {
+    bool success;          // False if the file could not be read or the batch was not saved
+    size_t rowsRead;
+    size_t rowsImported;
+    size_t duplicateRows;  // Matched a stored expense; not imported under DuplicatePolicy::Reject
+    size_t bytesRead;
+    double parseSeconds;   // Mapping, parsing and validation
+    double commitSeconds;  // Batch insert and save
+    std::vector<ImportError> errors;  // Sorted by line
+    
+    ImportResult()
+        : success(false), rowsRead(0), rowsImported(0), duplicateRows(0), bytesRead(0),
+          parseSeconds(0.0), commitSeconds(0.0) {}
+    
+    double rowsPerSecond() const;
+    double megabytesPerSecond() const;
+};
+
+class ExpenseImporter {
+public:
+    ExpenseImporter(ExpenseManager* manager);
+    
+    // Category mapping
+    void addCategoryRule(const CategoryRule& rule);
+    void setCategoryRules(const std::vector<CategoryRule>& rules);
+    bool loadCategoryRules(const std::string& rulesFilePath);
+    void setDefaultCategory(const std::string& category);  // Empty rejects unmapped rows
+    void setAmountSign(AmountSign sign);
+    
+    // Tuning
+    void setThreadCount(unsigned int threadCount);  // 0 uses the ledger's pool, else the hardware concurrency
+    void setChunkSize(size_t bytes);
+    
+    // Parses and validates every row, then commits the valid ones as one batch.
+    // Invalid rows are reported in ImportResult::errors and skipped.
+    ImportResult importFile(const std::string& filePath, ImportFormat format = ImportFormat::Auto);
+    ImportResult importBuffer(const char* data, size_t size, ImportFormat format);
+    
+private:
+    ExpenseManager* m_manager;
+    std::vector<CategoryRule> m_rules;
+    std::string m_defaultCategory;
+    AmountSign m_amountSign;
+    unsigned int m_threadCount;
+    size_t m_chunkSize;
+};
+
+#endif // EXPENSE_IMPORTER_H
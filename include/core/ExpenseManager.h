@@ -4,49 +4,351 @@
 #include <string>
 #include <vector>
 #include <map>
+#include <deque>
 #include <nlohmann/json.hpp>
 #include <filesystem>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <unordered_map>
+#include <unordered_set>
+#include <functional>
+#include <algorithm>
+#include <limits>
 #include "Expense.h"
 #include "Category.h"
+#include "Budget.h"
+#include "RecurringRule.h"
+#include "DuplicateIndex.h"
+#include "PartitionCodec.h"
+#include "StorageHealth.h"
+#include "LedgerSnapshot.h"
+#include "MemoryBudget.h"
+#include "ThreadPool.h"
+#include "SearchIndex.h"
+#include "ExpenseQuery.h"
+#include "SharedMutex.h"
 
 using json = nlohmann::json;
 namespace fs = std::filesystem;
 
+// Thread-safe: readers run concurrently under a shared lock, writers
+// (including saveData/loadData) are serialized under an exclusive one.
+//
+// The data file is a manifest holding the categories and per-month totals;
+// expenses live in one partition file per year next to it. Only the current
+// year is loaded at startup. Other years are loaded when a query needs them
+// and evicted again, least recently used first, above the memory budget.
 class ExpenseManager {
 public:
     ExpenseManager(const std::string& dataFilePath);
     ~ExpenseManager();
     
     // Expense operations
-    bool addExpense(const Expense& expense);
+    // Expenses matching a stored one under the duplicate policy are appended to
+    // duplicates. Rejected ones are skipped; addExpense then returns false.
+    // Both save once and take the rows out again if that fails.
+    bool addExpense(const Expense& expense, std::vector<DuplicateMatch>* duplicates = nullptr);
+    bool addExpenses(const std::vector<Expense>& expenses, std::vector<DuplicateMatch>* duplicates = nullptr);
     bool updateExpense(int id, const Expense& expense);
     bool deleteExpense(int id);
+    bool deleteExpenses(const std::vector<int>& ids);  // Single save; false if any id was missing
+    bool getExpense(int id, Expense& expense) const;
     std::vector<Expense> getAllExpenses() const;
-    std::vector<Expense> getExpensesByMonth(int year, int month) const;
+    std::vector<Expense> getExpensesByMonth(int year, int month, bool includeProjected = true) const;
     std::vector<Expense> getExpensesByCategory(const std::string& category) const;
     
+    // Full-text search over descriptions; every query word matches as a prefix.
+    // Results are newest first. An empty query returns everything the filters allow.
+    std::vector<Expense> searchExpenses(const std::string& query,
+                                        const SearchFilters& filters = SearchFilters()) const;
+    
+    // Filtered, sorted and paginated query. Months are pruned by date and by
+    // the category totals before any partition is loaded, and only the rows of
+    // the requested page are copied out.
+    QueryResult query(const ExpenseQuery& query) const;
+    
     // Category operations
     bool addCategory(const Category& category);
     bool updateCategory(const std::string& name, const Category& category);
     bool deleteCategory(const std::string& name);
     std::vector<Category> getAllCategories() const;
     
-    // Reporting
+    // Budgets; spending is read from the running month totals, never rescanned
+    bool setBudget(const Budget& budget);  // Replaces the budget with the same category and period
+    bool removeBudget(const std::string& category, BudgetPeriod period);
+    std::vector<Budget> getBudgets() const;
+    std::vector<BudgetStatus> getBudgetStatus(int year, int month) const;
+    
+    // Called when an expense change pushes a budget across a threshold. Runs on
+    // the thread that made the change, after the lock is released.
+    void setBudgetAlertCallback(std::function<void(const BudgetAlert&)> callback);
+    
+    // Recurring rules. Occurrences up to today are stored as ordinary expenses,
+    // one batch per catch-up; later ones are projected into month listings and
+    // summaries when asked for and never stored.
+    bool addRecurringRule(const RecurringRule& rule);
+    bool updateRecurringRule(int id, const RecurringRule& rule);  // Stored occurrences are kept
+    bool deleteRecurringRule(int id);                             // Stored occurrences are kept
+    std::vector<RecurringRule> getRecurringRules() const;
+    // Returns the number of expenses added. Only takes the write lock when a
+    // rule is behind throughDate, so calling it on every refresh is cheap.
+    size_t materializeRecurring(const std::string& throughDate);
+    
+    // Duplicate detection. Every loaded expense is in a fingerprint index, so
+    // checking a new one is a single hash probe; windowDays widens the date match.
+    bool setDuplicatePolicy(DuplicatePolicy policy, int windowDays);
+    DuplicatePolicy getDuplicatePolicy() const;
+    int getDuplicateWindow() const;
+    std::vector<Expense> findDuplicates(const Expense& expense) const;  // Stored expenses it would match
+    
+    // One-shot pass over the whole ledger, fingerprinted and grouped on
+    // threadCount threads (0 uses the thread pool's size, or the hardware
+    // concurrency). Reads a snapshot, so edits are not blocked while it runs.
+    std::vector<DuplicateGroup> findDuplicateGroups(unsigned int threadCount = 0) const;
+    
+    // Undo/redo of expense and category edits. Each edit is logged as the rows
+    // and category it replaced, not as a copy of the ledger, and replayed
+    // through the same incremental paths as the edit itself. The log lasts for
+    // the session and keeps the last getUndoDepth() edits, fewer once the rows
+    // they hold copies of pass 32 MB; a new edit clears redo.
+    bool undo();
+    bool redo();
+    bool canUndo() const;
+    bool canRedo() const;
+    std::string undoDescription() const;  // Empty when there is nothing to undo
+    std::string redoDescription() const;
+    void setUndoDepth(size_t depth);      // 0 disables the log
+    size_t getUndoDepth() const;
+    
+    // Reporting; answered from running totals without loading any partition.
+    // Projected recurring occurrences in the month are included.
     std::map<std::string, double> generateCategorySummary(int year, int month) const;
     double getTotalExpenses(int year, int month) const;
     
+    // Consistent read-only view for long-running reports and exports; cheap to
+    // take and never blocks later edits. Loads every partition.
+    std::shared_ptr<const LedgerSnapshot> snapshot() const;
+    
+    // Partition cache
+    void setMemoryBudget(size_t bytes);
+    size_t getMemoryBudget() const;
+    std::vector<int> getLoadedYears() const;
+    size_t getCachedBytes() const;  // Estimated size of the loaded partitions
+    
+    // Counts the cache against a limit shared with other ledgers instead of
+    // the budget above; nullptr goes back to that
+    void setSharedMemoryBudget(std::shared_ptr<MemoryBudget> budget);
+    
+    // Parallel passes (duplicate grouping, storage verification) run their
+    // tasks on this pool instead of starting threads; not owned, nullptr to stop
+    void setThreadPool(ThreadPool* pool);
+    ThreadPool* threadPool() const;
+    
     // Save and load data
     bool saveData();
     bool loadData();
     
+    // Format partitions are written in. Switching rewrites every partition;
+    // loading detects the format of each file, so either setting reads both.
+    bool setStorageFormat(StorageFormat format);
+    StorageFormat getStorageFormat() const;
+    
+    // Integrity. Compact partitions checksum every month block, and the manifest
+    // records a CRC32C of each JSON partition, so verification reads every file
+    // once without parsing it and only digs into the damaged ones.
+    StorageReport verifyStorage() const;
+    
+    // Reloads whatever can still be read from damaged files, keeps a copy of
+    // each as FILE.damaged and saves the result. An unreadable manifest is
+    // rebuilt from the partition files it would have listed.
+    RecoveryReport recoverData();
+    
+    // The manifest could not be read: every edit is refused and nothing is
+    // saved, so nothing on disk is overwritten, until recoverData() has run
+    bool isReadOnly() const;
+    
 private:
+    struct YearPartition {
+        std::string fileName;
+        size_t expenseCount;
+        bool loaded;
+        bool dirty;   // Changed since the partition file was last written
+        bool failed;  // Partition file unreadable; writes to this year are refused
+        bool hasChecksum;   // JSON partitions only; compact ones checksum each block
+        uint32_t checksum;  // CRC32C of the file as last written
+        int minId;          // Every id in the partition lies in [minId, maxId], so an id
+        int maxId;          // lookup loads only the years that may hold it
+        mutable std::atomic<uint64_t> lastUsed;  // Touched by readers under the shared lock
+        
+        YearPartition()
+            : expenseCount(0), loaded(false), dirty(false), failed(false), hasChecksum(false), checksum(0),
+              minId(std::numeric_limits<int>::max()), maxId(std::numeric_limits<int>::min()), lastUsed(0) {}
+        
+        void noteId(int id)
+        {
+            minId = std::min(minId, id);
+            maxId = std::max(maxId, id);
+        }
+        bool mayHoldId(int id) const { return minId <= id && id <= maxId; }
+    };
+    
+    struct CategoryTotal {
+        double amount;
+        int count;
+        
+        CategoryTotal() : amount(0.0), count(0) {}
+    };
+    
+    struct QueryMonth {
+        int key;
+        size_t count;   // Rows in the requested categories
+        double amount;
+        bool whole;     // The date range covers the whole month
+    };
+    
+    // One logged edit: what it took out and what it put in. Undo swaps the two.
+    // Rows an edit put in are still in the ledger while it is on the undo log,
+    // so only their ids are kept there; undo copies them out for redo.
+    struct LedgerEdit {
+        std::string description;       // "Delete expense", for menus and status messages
+        std::vector<Expense> removed;  // With their ids, so they come back unchanged
+        std::vector<Expense> inserted; // On the redo log
+        std::vector<int> insertedIds;  // On the undo log
+        bool hadCategory;              // oldCategory existed before the edit
+        bool hasCategory;              // newCategory exists after it
+        Category oldCategory;
+        Category newCategory;
+        size_t categoryIndex;          // Position in the category list
+        std::vector<Budget> budgets;   // Dropped with the category by whichever side last removed it
+        
+        LedgerEdit() : hadCategory(false), hasCategory(false), categoryIndex(0) {}
+    };
+    
+    struct QueryPlan {
+        std::vector<QueryMonth> months;  // Ascending, months without candidate rows pruned
+        bool totalsExact;    // Counts, amounts and groups follow from the totals alone
+        size_t firstRead;    // Months whose rows must be read: [firstRead, lastRead)
+        size_t lastRead;
+        size_t skippedRows;  // Matches in months skipped ahead of the page
+        int fromYear;        // Partitions to load
+        int toYear;
+    };
+    
     std::string m_dataFilePath;
-    std::vector<Expense> m_expenses;
-    std::vector<Category> m_categories;
+    
+    // Expenses are stored in copy-on-write chunks, one per month, so a write
+    // copies at most one month while snapshots share the rest
+    std::map<int, std::shared_ptr<ExpenseChunk>> m_chunks;
+    
+    // Snapshots are released on their own threads, so use_count() cannot say
+    // when one is gone without racing it. Instead, each chunk and the category
+    // list are copied on their first write after any snapshot was taken.
+    mutable std::atomic<uint64_t> m_snapshotGeneration;  // Bumped by snapshot()
+    uint64_t m_ownedGeneration;           // Generation m_ownedChunks is valid for
+    std::unordered_set<int> m_ownedChunks;  // Month keys no snapshot can reference
+    bool m_ownsCategories;
+    std::unordered_map<int, int> m_expenseMonths;  // Expense id -> chunk key, loaded years only
+    std::shared_ptr<std::vector<Category>> m_categories;
+    SearchIndex m_searchIndex;  // Description tokens, maintained on every insert/remove
+    DuplicateIndex m_duplicateIndex;  // Fingerprints of the loaded years, maintained alongside
+    DuplicatePolicy m_duplicatePolicy;
+    int m_duplicateWindow;  // Days
+    StorageFormat m_storageFormat;
+    bool m_readOnly;  // Set when the manifest fails to load
+    std::vector<Budget> m_budgets;
+    std::vector<RecurringRule> m_recurringRules;
+    std::function<void(const BudgetAlert&)> m_budgetAlertCallback;
     int m_nextExpenseId;
+    int m_nextRuleId;
+    
+    std::map<int, YearPartition> m_partitions;  // Keyed by year, loaded or not
+    std::map<int, std::map<std::string, CategoryTotal>> m_monthTotals;  // Chunk key -> category totals
+    
+    // The manifest is the commit point of a save. Partitions are written to
+    // files named after the next generation, so the ones the manifest on disk
+    // lists stay intact until it is replaced; the files it no longer lists
+    // are removed after that.
+    uint64_t m_saveGeneration;  // Of the manifest on disk
+    std::vector<std::string> m_obsoleteFiles;
+    size_t m_memoryBudget;
+    std::shared_ptr<MemoryBudget> m_sharedBudget;
+    size_t m_reportedBytes;  // Counted against m_sharedBudget
+    std::atomic<ThreadPool*> m_threadPool;
+    mutable std::atomic<uint64_t> m_accessClock;
+    std::deque<LedgerEdit> m_undoLog;  // Oldest first
+    std::deque<LedgerEdit> m_redoLog;
+    size_t m_undoDepth;
+    mutable SharedMutex m_mutex;
     
     void initializeDefaultCategories();
     int getNextExpenseId();
+    
+    // Runs work(0) .. work(count - 1) in parallel and waits for all of them
+    template <typename Work>
+    void runParallel(unsigned int count, Work work) const;
+    unsigned int parallelism() const;  // Threads a parallel pass should split into
+    
+    // Callers must hold m_mutex (exclusively for the mutating ones)
+    ExpenseChunk& mutableChunk(int monthKey);
+    std::vector<Category>& mutableCategories();
+    void claimOwnershipLocked();  // Forgets what it owned once a snapshot was taken
+    void adjustTotalsLocked(int monthKey, const Expense& expense, int direction);
+    void indexExpenseLocked(const Expense& expense);
+    void bulkIndexLocked(const std::vector<Expense>& expenses);
+    void insertExpenseLocked(const Expense& expense);
+    bool removeExpenseLocked(int id, Expense* removed = nullptr);
+    bool addAndSave(const std::vector<Expense>& expenses, std::vector<DuplicateMatch>* duplicates, size_t& added);
+    bool addExpensesLocked(const std::vector<Expense>& expenses, std::vector<BudgetAlert>& alerts,
+                           std::vector<DuplicateMatch>* duplicates, std::vector<Expense>* inserted,
+                           bool checkDuplicates = true);
+    std::vector<const Expense*> filterDuplicatesLocked(const std::vector<Expense>& expenses,
+                                                       std::vector<DuplicateMatch>* duplicates);
+    const Expense* findExpenseLocked(int id) const;
+    bool categoryInUseLocked(const std::string& name) const;
+    void renameCategoryLocked(const std::string& oldName, const std::string& newName);  // Budgets and rules
+    QueryPlan planQueryLocked(const ExpenseQuery& query) const;
+    
+    // Budgets: sample the periods a change touches before it, compare after it
+    BudgetStatus budgetStatusLocked(const Budget& budget, int year, int month) const;
+    std::vector<BudgetStatus> affectedBudgetsLocked(const std::vector<int>& monthKeys) const;
+    void collectBudgetAlertsLocked(const std::vector<BudgetStatus>& before,
+                                   std::vector<BudgetAlert>& alerts) const;
+    void dispatchBudgetAlerts(const std::vector<BudgetAlert>& alerts) const;
+    
+    // Recurring rules: returns whether any rule advanced and needs saving
+    bool materializeRecurringLocked(const std::string& throughDate, size_t& added,
+                                    std::vector<BudgetAlert>& alerts);
+    std::vector<Expense> projectRecurringLocked(const std::string& fromDate, const std::string& toDate) const;
+    std::vector<Expense> projectMonthLocked(int year, int month) const;
+    bool saveDataLocked();
+    bool loadDataLocked();
+    bool refuseEditLocked() const;  // True, with a message, while the ledger is read-only
+    void clearLedgerLocked();
+    
+    // Undo log
+    void recordEditLocked(LedgerEdit edit);
+    void trimEditLogsLocked();
+    bool applyEditLocked(LedgerEdit& edit, bool reverse, std::vector<BudgetAlert>& alerts);
+    bool replayEdit(std::deque<LedgerEdit>& from, std::deque<LedgerEdit>& to, bool reverse);
+    
+    // Partitions
+    template <typename Reader>
+    auto readYears(int fromYear, int toYear, Reader reader) const -> decltype(reader());
+    bool yearsLoadedLocked(int fromYear, int toYear) const;
+    bool loadYearsLocked(int fromYear, int toYear);
+    bool loadYearLocked(int year);
+    bool loadYearsHoldingLocked(int id);  // Stops at the one that has it
+    void evictYearLocked(int year);
+    void evictColdPartitionsLocked();
+    YearPartition& partitionLocked(int year);
+    std::string partitionPath(const std::string& fileName) const;
+    std::string partitionFileName(int year) const;  // For the next generation
+    bool writePartitionLocked(int year);
+    void removeUnlistedPartitionFilesLocked();
+    PartitionHealth checkPartitionLocked(int year, const YearPartition& partition) const;
+    void rebuildPartitionListLocked();
+    bool loadLegacyLocked(const json& j);
 };
 
-#endif // EXPENSE_MANAGER_H
\ No newline at end of file
+#endif // EXPENSE_MANAGER_H
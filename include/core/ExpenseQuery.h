@@ -0,0 +1,79 @@
+#ifndef EXPENSE_QUERY_H
+#define EXPENSE_QUERY_H
+
+#include <string>
+#include <vector>
+#include <limits>
+#include <cstddef>
+#include "Expense.h"
+#include "DateUtils.h"
+
+enum class QuerySort {
+    Date,         // Ties broken by id
+    Amount,
+    Category,
+    Description
+};
+
+enum class QueryGroupBy {
+    None,
+    Category,
+    Month,        // Keys are YYYY-MM
+    Year
+};
+
+// Declarative expense query. Every restriction is optional and they combine
+// with AND. ExpenseManager::query plans it against the month chunks, the
+// per-month category totals and the description index.
+struct ExpenseQuery {
+    std::string fromDate;                 // Inclusive YYYY-MM-DD, empty for no lower bound
+    std::string toDate;                   // Inclusive YYYY-MM-DD, empty for no upper bound
+    std::vector<std::string> categories;  // Empty matches every category
+    double minAmount;                     // Inclusive
+    double maxAmount;                     // Inclusive
+    std::string text;                     // Every word must prefix a description word
+    
+    QuerySort sortBy;
+    bool descending;
+    size_t offset;                        // Rows to skip, for pagination
+    size_t limit;                         // Rows to return; 0 returns every match
+    QueryGroupBy groupBy;                 // Groups are computed over all matches, not the page
+    bool includeProjected;                // Adds projected recurring occurrences (negative ids)
+    
+    ExpenseQuery()
+        : minAmount(-std::numeric_limits<double>::infinity()),
+          maxAmount(std::numeric_limits<double>::infinity()),
+          sortBy(QuerySort::Date), descending(true), offset(0), limit(0),
+          groupBy(QueryGroupBy::None), includeProjected(false) {}
+    
+    // All expenses in one month, newest first
+    static ExpenseQuery forMonth(int year, int month);
+};
+
+struct QueryGroup {
+    std::string key;
+    double total;
+    size_t count;
+    
+    QueryGroup() : total(0.0), count(0) {}
+};
+
+struct QueryResult {
+    std::vector<Expense> rows;       // The requested page only
+    size_t totalMatches;             // Across all pages
+    double totalAmount;              // Across all pages
+    std::vector<QueryGroup> groups;  // Sorted by key
+    std::string plan;                // Access path taken, for diagnostics
+    
+    QueryResult() : totalMatches(0), totalAmount(0.0) {}
+};
+
+inline ExpenseQuery ExpenseQuery::forMonth(int year, int month)
+{
+    ExpenseQuery query;
+    query.fromDate = DateUtils::formatDate(year, month, 1);
+    query.toDate = DateUtils::formatDate(year, month, DateUtils::daysInMonth(year, month));
+    return query;
+}
+
+#endif // EXPENSE_QUERY_H
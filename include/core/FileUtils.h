@@ -0,0 +1,14 @@
+#ifndef FILE_UTILS_H
+#define FILE_UTILS_H
+
+#include <string>
+
+namespace FileUtils {
+
+// Writes next to the target and renames over it, so a crash mid-write leaves
+// the previous file intact rather than a truncated one
+bool writeAtomically(const std::string& path, const std::string& bytes);
+
+} // namespace FileUtils
+
+#endif // FILE_UTILS_H
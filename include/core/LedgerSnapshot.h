@@ -0,0 +1,50 @@
+#ifndef LEDGER_SNAPSHOT_H
+#define LEDGER_SNAPSHOT_H
+
+#include <string>
+#include <vector>
+#include <map>
+#include <memory>
+#include "Expense.h"
+#include "Category.h"
+
+// Expenses of one calendar month, sorted by id
+using ExpenseChunk = std::vector<Expense>;
+
+// Immutable, consistent view of a ledger at one point in time.
+// Chunks are shared with the live ExpenseManager, which copies a chunk
+// before modifying it while a snapshot still references it. Holding a
+// snapshot never blocks writers; its memory is released with the last copy.
+class LedgerSnapshot {
+public:
+    using ChunkMap = std::map<int, std::shared_ptr<const ExpenseChunk>>;  // Keyed by YYYYMM
+    
+    LedgerSnapshot(ChunkMap chunks, std::shared_ptr<const std::vector<Category>> categories);
+    
+    size_t expenseCount() const;
+    std::vector<Expense> getAllExpenses() const;
+    std::vector<Expense> getExpensesByMonth(int year, int month) const;
+    std::vector<Expense> getExpensesByCategory(const std::string& category) const;
+    const std::vector<Category>& getAllCategories() const;
+    
+    std::map<std::string, double> generateCategorySummary(int year, int month) const;
+    double getTotalExpenses(int year, int month) const;
+    
+    // Visits every expense in month order without copying
+    template <typename Visitor>
+    void forEachExpense(Visitor visitor) const
+    {
+        for (const auto& entry : m_chunks) {
+            for (const auto& expense : *entry.second) {
+                visitor(expense);
+            }
+        }
+    }
+    
+private:
+    ChunkMap m_chunks;
+    std::shared_ptr<const std::vector<Category>> m_categories;
+    size_t m_expenseCount;
+};
+
+#endif // LEDGER_SNAPSHOT_H
@@ -0,0 +1,39 @@
+#ifndef MEMORY_BUDGET_H
+#define MEMORY_BUDGET_H
+
+#include <atomic>
+#include <cstddef>
+
+// Memory limit shared by the partition caches of several ledgers. Each
+// ledger reports what its cache holds; one may grow into whatever the others
+// leave unused, and trims its own cache once the total is over the limit.
+class MemoryBudget {
+public:
+    explicit MemoryBudget(size_t limit) : m_limit(limit), m_used(0) {}
+    
+    void setLimit(size_t bytes) { m_limit = bytes; }
+    size_t limit() const { return m_limit; }
+    size_t used() const { return m_used; }
+    
+    // What one ledger may hold, given that it currently reports held bytes
+    size_t available(size_t held) const
+    {
+        size_t others = m_used - held;
+        return m_limit > others ? m_limit - others : 0;
+    }
+    
+    void update(size_t before, size_t after)
+    {
+        if (after > before) {
+            m_used += after - before;
+        } else {
+            m_used -= before - after;
+        }
+    }
+    
+private:
+    std::atomic<size_t> m_limit;
+    std::atomic<size_t> m_used;
+};
+
+#endif // MEMORY_BUDGET_H
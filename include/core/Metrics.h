@@ -0,0 +1,147 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <string>
+#include <vector>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+// Latency summary of one timer. Percentiles are the upper bound of their
+// power-of-two histogram bucket, so they overestimate by at most 2x.
+struct LatencyStats {
+    std::string name;
+    uint64_t count;
+    double totalMs;
+    double meanMs;
+    double p50Ms;
+    double p90Ms;
+    double p99Ms;
+    double maxMs;
+    
+    LatencyStats()
+        : count(0), totalMs(0.0), meanMs(0.0), p50Ms(0.0), p90Ms(0.0), p99Ms(0.0), maxMs(0.0) {}
+};
+
+struct MetricsReport {
+    std::vector<LatencyStats> timers;           // Sorted by name
+    std::map<std::string, uint64_t> counters;
+};
+
+// Lock-free histogram of durations in nanoseconds, one bucket per power of two
+class LatencyHistogram {
+public:
+    static const int kBucketCount = 64;
+    
+    LatencyHistogram();
+    
+    void record(uint64_t nanoseconds);
+    LatencyStats stats(const std::string& name) const;
+    void reset();
+    
+private:
+    std::atomic<uint64_t> m_buckets[kBucketCount];
+    std::atomic<uint64_t> m_totalNanoseconds;
+    std::atomic<uint64_t> m_maxNanoseconds;
+};
+
+// Process-wide registry of timers and counters. Instrument code through the
+// PFM_SCOPED_TIMER and PFM_COUNTER_ADD macros below rather than calling this
+// directly: they cache the lookup per call site and compile to nothing unless
+// PFM_ENABLE_METRICS is defined.
+class Metrics {
+public:
+    static Metrics& instance();
+    static bool isCompiledIn();
+    
+    // Returned pointers stay valid for the life of the process
+    LatencyHistogram* timer(const char* name);
+    std::atomic<uint64_t>* counter(const char* name);
+    
+    MetricsReport report() const;
+    void reset();
+    
+    // Trace recording keeps every timed scope for a Chrome trace dump
+    // (chrome://tracing or https://ui.perfetto.dev). Off by default.
+    void setTracing(bool enabled);
+    bool isTracing() const;
+    void recordTraceEvent(const char* name, std::chrono::steady_clock::time_point start,
+                          uint64_t durationNanoseconds);
+    size_t traceEventCount() const;
+    bool writeChromeTrace(const std::string& filePath) const;
+    
+private:
+    struct TraceEvent {
+        const char* name;  // Always a string literal
+        uint64_t threadId;
+        uint64_t startNanoseconds;
+        uint64_t durationNanoseconds;
+    };
+    
+    Metrics();
+    
+    mutable std::mutex m_mutex;
+    std::map<std::string, std::unique_ptr<LatencyHistogram>> m_timers;
+    std::map<std::string, std::unique_ptr<std::atomic<uint64_t>>> m_counters;
+    
+    std::atomic<bool> m_tracing;
+    mutable std::mutex m_traceMutex;
+    std::vector<TraceEvent> m_traceEvents;  // Capped; later events are dropped
+    uint64_t m_droppedTraceEvents;
+    std::chrono::steady_clock::time_point m_epoch;
+};
+
+class ScopedTimer {
+public:
+    ScopedTimer(LatencyHistogram* histogram, const char* name)
+        : m_histogram(histogram), m_name(name), m_start(std::chrono::steady_clock::now()) {}
+    
+    ~ScopedTimer()
+    {
+        uint64_t elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - m_start).count();
+        m_histogram->record(elapsed);
+        
+        Metrics& metrics = Metrics::instance();
+        if (metrics.isTracing()) {
+            metrics.recordTraceEvent(m_name, m_start, elapsed);
+        }
+    }
+    
+    ScopedTimer(const ScopedTimer&) = delete;
+    ScopedTimer& operator=(const ScopedTimer&) = delete;
+    
+private:
+    LatencyHistogram* m_histogram;
+    const char* m_name;
+    std::chrono::steady_clock::time_point m_start;
+};
+
+#define PFM_METRICS_CONCAT_INNER(a, b) a##b
+#define PFM_METRICS_CONCAT(a, b) PFM_METRICS_CONCAT_INNER(a, b)
+
+#ifdef PFM_ENABLE_METRICS
+
+// Times the rest of the enclosing scope; `name` must be a string literal
+#define PFM_SCOPED_TIMER(name) \
+    static LatencyHistogram* const PFM_METRICS_CONCAT(pfmTimer, __LINE__) = Metrics::instance().timer(name); \
+    ScopedTimer PFM_METRICS_CONCAT(pfmScopedTimer, __LINE__)(PFM_METRICS_CONCAT(pfmTimer, __LINE__), name)
+
+// Adds `value` to a counter; `value` is not evaluated when metrics are disabled
+#define PFM_COUNTER_ADD(name, value) \
+    do { \
+        static std::atomic<uint64_t>* const pfmCounter = Metrics::instance().counter(name); \
+        pfmCounter->fetch_add(static_cast<uint64_t>(value), std::memory_order_relaxed); \
+    } while (0)
+
+#else
+
+#define PFM_SCOPED_TIMER(name) do {} while (0)
+#define PFM_COUNTER_ADD(name, value) do { (void)sizeof(value); } while (0)
+
+#endif // PFM_ENABLE_METRICS
+
+#endif // METRICS_H
@@ -0,0 +1,46 @@
+#ifndef PARTITION_CODEC_H
+#define PARTITION_CODEC_H
+
+#include <string>
+#include <vector>
+#include "LedgerSnapshot.h"
+
+enum class StorageFormat {
+    Json,     // Pretty-printed, one object per expense
+    Compact   // Column-encoded binary partitions, minified manifest
+};
+
+// Result of checking a compact partition block by block
+struct PartitionCheck {
+    size_t intactBlocks;
+    size_t damagedRegions;  // Runs of bytes belonging to no intact block
+    
+    PartitionCheck() : intactBlocks(0), damagedRegions(0) {}
+    
+    bool intact() const { return damagedRegions == 0; }
+};
+
+// Column-encoded layout for year partitions. The file starts with a magic
+// number, so a loader can tell it apart from JSON without any other hint,
+// followed by one block per month. Each block carries a marker, a CRC32C and
+// its month key, so damage is confined to the blocks it hits and the rest can
+// still be read. Within a block each column is stored on its own: ids and day
+// numbers as varint deltas, categories and descriptions through a per-block
+// dictionary, and amounts as whole cents where that is exact.
+class PartitionCodec {
+public:
+    static bool isCompact(const std::string& bytes);
+    static std::string encode(const std::vector<const ExpenseChunk*>& chunks);
+    
+    // Throws std::runtime_error if any block is damaged, truncated or malformed
+    static std::vector<Expense> decode(const std::string& bytes);
+    
+    // Checksums every block without decoding any rows
+    static PartitionCheck check(const std::string& bytes);
+    
+    // Rows of every intact block, skipping damaged ones. Works even when the
+    // file header itself is lost.
+    static std::vector<Expense> salvage(const std::string& bytes, PartitionCheck* check = nullptr);
+};
+
+#endif // PARTITION_CODEC_H
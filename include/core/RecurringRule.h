@@ -0,0 +1,46 @@
+#ifndef RECURRING_RULE_H
+#define RECURRING_RULE_H
+
+#include <string>
+#include <vector>
+#include "Expense.h"
+
+enum class RecurrenceFrequency {
+    Weekly,
+    Monthly,   // Same day of the month as the start date, clamped to shorter months
+    Custom     // Every interval days
+};
+
+// Template for an expense that repeats, such as rent or a subscription.
+// Occurrences up to materializedThrough are stored as ordinary expenses; later
+// ones are only projected when a query asks for their months.
+struct RecurringRule {
+    int id;
+    double amount;
+    std::string description;
+    std::string category;
+    RecurrenceFrequency frequency;
+    int interval;                      // Every interval weeks, months or days
+    std::string startDate;             // First occurrence, YYYY-MM-DD
+    std::string endDate;               // Last possible occurrence; empty for no end
+    std::string materializedThrough;   // Empty until the first catch-up
+    
+    RecurringRule() : id(0), amount(0.0), frequency(RecurrenceFrequency::Monthly), interval(1) {}
+    
+    bool isValid() const;
+    
+    // Occurrence dates within [fromDate, toDate], ascending
+    std::vector<std::string> occurrences(const std::string& fromDate, const std::string& toDate) const;
+    
+    // The expense for one occurrence. Projected ones carry the negated rule id,
+    // since they have no id of their own until they are materialized.
+    Expense occurrence(const std::string& date, bool projected) const;
+};
+
+// Projected occurrences are read-only; editing one means editing its rule
+inline bool isProjectedExpense(const Expense& expense)
+{
+    return expense.id < 0;
+}
+
+#endif // RECURRING_RULE_H
@@ -0,0 +1,50 @@
+#ifndef SEARCH_INDEX_H
+#define SEARCH_INDEX_H
+
+#include <string>
+#include <vector>
+#include <map>
+#include <utility>
+#include <cstddef>
+
+// Optional restrictions applied to full-text search results
+struct SearchFilters {
+    std::string fromDate;  // Inclusive YYYY-MM-DD, empty for no lower bound
+    std::string toDate;    // Inclusive YYYY-MM-DD, empty for no upper bound
+    std::vector<std::string> categories;  // Empty matches every category
+    size_t limit;          // 0 returns every match
+    
+    SearchFilters() : limit(0) {}
+};
+
+// Inverted index from description tokens to the ids of the expenses using them.
+// Tokens are kept in sorted order so a prefix maps to one contiguous range.
+class SearchIndex {
+public:
+    void add(int id, const std::string& text);
+    void remove(int id, const std::string& text);
+    void clear();
+    
+    // Batch forms for loading or evicting a whole partition: each posting list
+    // is merged once instead of shifting it for every id
+    void addAll(const std::vector<std::pair<int, const std::string*>>& documents);
+    void removeAll(const std::vector<std::pair<int, const std::string*>>& documents);
+    
+    // Ids (ascending) whose text has, for every query token, a token starting with it
+    std::vector<int> search(const std::string& query) const;
+    
+    // Lower-cased runs of letters and digits; bytes of UTF-8 sequences count as letters
+    static std::vector<std::string> tokenize(const std::string& text);
+    
+    // Same test as search() for a single text, given already tokenized query words
+    static bool matches(const std::vector<std::string>& queryTokens, const std::string& text);
+    
+private:
+    std::map<std::string, std::vector<int>> m_postings;  // Token -> sorted ids
+    
+    std::vector<int> prefixMatches(const std::string& prefix) const;
+    static std::map<std::string, std::vector<int>> invert(
+        const std::vector<std::pair<int, const std::string*>>& documents);
+};
+
+#endif // SEARCH_INDEX_H
@@ -0,0 +1,65 @@
+#ifndef SHARED_MUTEX_H
+#define SHARED_MUTEX_H
+
+#include <mutex>
+#include <condition_variable>
+
+// Writer-preferring reader-writer lock. std::shared_mutex on glibc favours
+// readers, so a steady stream of queries can starve addExpense forever; here a
+// waiting writer blocks new readers until it has run.
+// Usable with std::shared_lock and std::unique_lock.
+class SharedMutex {
+public:
+    SharedMutex() : m_readers(0), m_waitingWriters(0), m_writing(false) {}
+    
+    SharedMutex(const SharedMutex&) = delete;
+    SharedMutex& operator=(const SharedMutex&) = delete;
+    
+    void lock()
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        ++m_waitingWriters;
+        m_writerQueue.wait(lock, [this]() { return !m_writing && m_readers == 0; });
+        --m_waitingWriters;
+        m_writing = true;
+    }
+    
+    void unlock()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_writing = false;
+        }
+        m_writerQueue.notify_one();
+        m_readerQueue.notify_all();
+    }
+    
+    void lock_shared()
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_readerQueue.wait(lock, [this]() { return !m_writing && m_waitingWriters == 0; });
+        ++m_readers;
+    }
+    
+    void unlock_shared()
+    {
+        bool lastReader;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            lastReader = --m_readers == 0;
+        }
+        if (lastReader) {
+            m_writerQueue.notify_one();
+        }
+    }
+    
+private:
+    std::mutex m_mutex;
+    std::condition_variable m_readerQueue;
+    std::condition_variable m_writerQueue;
+    int m_readers;
+    int m_waitingWriters;
+    bool m_writing;
+};
+
+#endif // SHARED_MUTEX_H
@@ -0,0 +1,52 @@
+#ifndef STORAGE_HEALTH_H
+#define STORAGE_HEALTH_H
+
+#include <string>
+#include <vector>
+
+enum class PartitionStatus {
+    Ok,
+    Unverified,  // JSON written before checksums were recorded; readable as far as is known
+    Missing,
+    Damaged
+};
+
+struct PartitionHealth {
+    int year;
+    std::string fileName;
+    PartitionStatus status;
+    size_t expectedRows;             // From the manifest
+    std::vector<int> damagedMonths;  // Month keys with rows that cannot be read back
+    
+    PartitionHealth() : year(0), status(PartitionStatus::Ok), expectedRows(0) {}
+};
+
+// Result of ExpenseManager::verifyStorage()
+struct StorageReport {
+    bool manifestReadable;
+    std::vector<PartitionHealth> partitions;  // Ascending by year
+    
+    StorageReport() : manifestReadable(true) {}
+    
+    bool ok() const
+    {
+        for (const auto& partition : partitions) {
+            if (partition.status == PartitionStatus::Missing || partition.status == PartitionStatus::Damaged) {
+                return false;
+            }
+        }
+        return manifestReadable;
+    }
+};
+
+// Result of ExpenseManager::recoverData()
+struct RecoveryReport {
+    bool manifestRebuilt;   // Budgets and recurring rules were in it and are gone
+    size_t rowsRecovered;   // Read back from damaged partitions
+    size_t rowsLost;        // Counted by the manifest but unreadable; unknown once it is rebuilt
+    std::vector<std::string> backups;  // Copies of the damaged files, kept next to the ledger
+    
+    RecoveryReport() : manifestRebuilt(false), rowsRecovered(0), rowsLost(0) {}
+};
+
+#endif // STORAGE_HEALTH_H
@@ -0,0 +1,54 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed set of worker threads shared by everything in a process that works
+// in parallel, so several ledgers do not each start threads of their own.
+//
+// A job is split into numbered tasks that workers claim one at a time. The
+// calling thread claims tasks too, so a job finishes even when every worker
+// is busy, and a task may itself run a job on the same pool.
+class ThreadPool {
+public:
+    explicit ThreadPool(unsigned int threadCount = 0);  // 0 uses the hardware concurrency
+    ~ThreadPool();
+    
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+    
+    // Threads a job can run on: the workers plus the caller
+    unsigned int threadCount() const;
+    
+    // Runs work(0) .. work(count - 1) and returns once all of them have; work must not throw
+    void run(unsigned int count, const std::function<void(unsigned int)>& work);
+    
+private:
+    struct Job {
+        const std::function<void(unsigned int)>* work;
+        unsigned int count;
+        std::atomic<unsigned int> next;  // Next task to claim
+        unsigned int finished;           // Guarded by ThreadPool::m_mutex
+        
+        Job() : work(nullptr), count(0), next(0), finished(0) {}
+    };
+    
+    std::vector<std::thread> m_workers;
+    std::deque<std::shared_ptr<Job>> m_jobs;  // Jobs with tasks left to claim
+    std::mutex m_mutex;
+    std::condition_variable m_wakeup;
+    std::condition_variable m_finished;
+    bool m_stopping;
+    
+    void workerLoop();
+    void runTasks(Job& job);
+};
+
+#endif // THREAD_POOL_H
@@ -0,0 +1,88 @@
+#ifndef WORKSPACE_H
+#define WORKSPACE_H
+
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+#include "ExpenseManager.h"
+#include "MemoryBudget.h"
+#include "ThreadPool.h"
+#include "SharedMutex.h"
+
+// Totals of one ledger within a consolidated report
+struct LedgerTotals {
+    std::string ledger;
+    std::map<std::string, double> categories;
+    double total;
+    
+    LedgerTotals() : total(0.0) {}
+};
+
+// One month across every ledger; categories with the same name are added up
+struct ConsolidatedReport {
+    int year;
+    int month;
+    std::vector<LedgerTotals> ledgers;  // In workspace order
+    std::map<std::string, double> categories;
+    double total;
+    
+    ConsolidatedReport() : year(0), month(0), total(0.0) {}
+};
+
+// Several ledgers open in one process, e.g. one per household and one per
+// business. They share a thread pool and one memory budget for their
+// partition caches, and all stay open, so switching between them costs nothing.
+//
+// The workspace file lists the ledgers by name and data file, relative to
+// the workspace file:
+//
+//   {"ledgers": [{"name": "Household", "file": "household.json"}, ...]}
+//
+// A missing workspace file starts out with a single ledger, expenses.json.
+// Thread-safe; ledgers handed out stay usable after they are closed.
+class Workspace {
+public:
+    Workspace(const std::string& workspaceFilePath, unsigned int threadCount = 0);
+    ~Workspace();
+    
+    std::vector<std::string> getLedgerNames() const;  // In workspace order
+    std::shared_ptr<ExpenseManager> ledger(const std::string& name) const;  // nullptr if there is none
+    std::shared_ptr<ExpenseManager> defaultLedger() const;  // The first one
+    std::string ledgerFile(const std::string& name) const;
+    
+    // Opens the ledger (creating its data file if needed) and records it in
+    // the workspace file. Names and data files are unique.
+    bool addLedger(const std::string& name, const std::string& dataFilePath);
+    bool removeLedger(const std::string& name);  // Closes it; its files stay. The last one stays open.
+    
+    // One limit for the caches of every ledger
+    void setMemoryBudget(size_t bytes);
+    size_t getMemoryBudget() const;
+    size_t getCachedBytes() const;
+    
+    ThreadPool& threadPool();
+    
+    // Each ledger is summarized on its own thread from its running totals
+    ConsolidatedReport consolidatedReport(int year, int month) const;
+    
+private:
+    struct Ledger {
+        std::string name;
+        std::string file;  // As written in the workspace file
+        std::shared_ptr<ExpenseManager> manager;
+    };
+    
+    std::string m_filePath;
+    mutable ThreadPool m_threadPool;
+    std::shared_ptr<MemoryBudget> m_memoryBudget;
+    std::vector<Ledger> m_ledgers;
+    mutable SharedMutex m_mutex;
+    
+    std::string dataPath(const std::string& file) const;
+    bool hasLedgerLocked(const std::string& name, const std::string& file) const;
+    std::shared_ptr<ExpenseManager> openLedger(const std::string& file);
+    bool saveLocked() const;
+};
+
+#endif // WORKSPACE_H
@@ -13,7 +13,11 @@
 #include <QChart>
 #include <QChartView>
 #include <QPieSeries>
+#include <QTimer>
+#include <QSpinBox>
+#include <QCheckBox>
 #include "../core/ExpenseManager.h"
+#include "../core/Workspace.h"
 
 QT_CHARTS_USE_NAMESPACE
 
@@ -21,20 +25,35 @@ class MainWindow : public QMainWindow {
     Q_OBJECT
     
 public:
-    MainWindow(ExpenseManager* expenseManager, QWidget* parent = nullptr);
+    MainWindow(Workspace* workspace, QWidget* parent = nullptr);
     ~MainWindow();
     
 private slots:
     void addExpense();
     void editExpense();
     void deleteExpense();
+    void importExpenses();
     void manageCategories();
+    void manageBudgets();
+    void manageRecurring();
+    void manageDuplicates();
     void generateReport();
+    void generateConsolidatedReport();
+    void switchLedger(int index);
     void refreshData();
     void filterByMonth();
+    void searchExpenses();
+    void showMetrics();
+    void undo();
+    void redo();
+    void checkStorage();
+    void previousPage();
+    void nextPage();
     
 private:
-    ExpenseManager* m_expenseManager;
+    Workspace* m_workspace;
+    std::shared_ptr<ExpenseManager> m_ledger;  // The ledger shown
+    ExpenseManager* m_expenseManager;          // m_ledger.get()
     
     // UI components
     QTableWidget* m_expenseTable;
@@ -45,22 +64,41 @@ private:
     QPushButton* m_addButton;
     QPushButton* m_editButton;
     QPushButton* m_deleteButton;
+    QPushButton* m_importButton;
     QPushButton* m_generateReportButton;
+    QPushButton* m_consolidatedReportButton;
     QPushButton* m_manageCategoriesButton;
+    QPushButton* m_manageBudgetsButton;
+    QPushButton* m_manageRecurringButton;
+    QPushButton* m_manageDuplicatesButton;
+    QComboBox* m_ledgerComboBox;
     QComboBox* m_monthComboBox;
     QComboBox* m_yearComboBox;
     QLabel* m_totalExpensesLabel;
+    QLineEdit* m_searchEdit;
+    QTimer* m_searchTimer;
+    QPushButton* m_previousPageButton;
+    QPushButton* m_nextPageButton;
+    QLabel* m_pageLabel;
+    QLabel* m_budgetLabel;
+    size_t m_pageOffset;  // First row of the page shown in the table
+    std::string m_caughtUpThrough;  // Date of the last recurring catch-up for the ledger shown
     
     void setupUI();
     void updateCategoryComboBox();
     void updateExpenseTable(const std::vector<Expense>& expenses);
+    QueryResult showQueryPage(ExpenseQuery query);
     int getSelectedExpenseId() const;
-    void showReport(int year, int month);
+    void showReport(int year, int month, bool allLedgers);
+    void watchBudgetAlerts();
+    void updateBudgetStatus();
+    void showBudgetAlert(const BudgetAlert& alert);
+    void checkLedgerStorage(const QString& name, ExpenseManager* ledger);
     
     class CategoryDialog : public QDialog {
     public:
         CategoryDialog(ExpenseManager* manager, QWidget* parent = nullptr);
-        
+    
     private:
         ExpenseManager* m_manager;
         QTableWidget* m_categoryTable;
@@ -77,6 +115,77 @@ private:
         void deleteCategory();
         void selectCategory(int row, int column);
     };
+    
+    class BudgetDialog : public QDialog {
+    public:
+        BudgetDialog(ExpenseManager* manager, int year, int month, QWidget* parent = nullptr);
+    
+    private:
+        ExpenseManager* m_manager;
+        int m_year;   // Period whose spending is shown
+        int m_month;
+        QTableWidget* m_budgetTable;
+        QComboBox* m_categoryComboBox;
+        QComboBox* m_periodComboBox;
+        QDoubleSpinBox* m_limitSpinBox;
+        QPushButton* m_setButton;
+        QPushButton* m_removeButton;
+        
+        void setupUI();
+        void refreshBudgets();
+        void setBudget();
+        void removeBudget();
+        void selectBudget(int row, int column);
+    };
+    
+    class RecurringDialog : public QDialog {
+    public:
+        RecurringDialog(ExpenseManager* manager, QWidget* parent = nullptr);
+    
+    private:
+        ExpenseManager* m_manager;
+        QTableWidget* m_ruleTable;
+        QLineEdit* m_descriptionEdit;
+        QComboBox* m_categoryComboBox;
+        QDoubleSpinBox* m_amountSpinBox;
+        QComboBox* m_frequencyComboBox;
+        QSpinBox* m_intervalSpinBox;
+        QDateEdit* m_startDateEdit;
+        QCheckBox* m_endCheckBox;
+        QDateEdit* m_endDateEdit;
+        QPushButton* m_addButton;
+        QPushButton* m_updateButton;
+        QPushButton* m_deleteButton;
+        
+        void setupUI();
+        void refreshRules();
+        RecurringRule ruleFromForm() const;
+        int selectedRuleId() const;
+        void addRule();
+        void updateRule();
+        void deleteRule();
+        void selectRule(int row, int column);
+    };
+    
+    class DuplicateDialog : public QDialog {
+    public:
+        DuplicateDialog(ExpenseManager* manager, QWidget* parent = nullptr);
+    
+    private:
+        ExpenseManager* m_manager;
+        std::vector<DuplicateGroup> m_groups;  // Result of the last scan
+        QComboBox* m_policyComboBox;
+        QSpinBox* m_windowSpinBox;
+        QTableWidget* m_groupTable;
+        QLabel* m_summaryLabel;
+        QPushButton* m_scanButton;
+        QPushButton* m_deleteButton;
+        
+        void setupUI();
+        void applyPolicy();
+        void scan();
+        void deleteDuplicates();
+    };
 };
 
 #endif // MAIN_WINDOW_H
\ No newline at end of file
@@ -0,0 +1,883 @@
+#include "../../include/cli/CommandProcessor.h"
+#include "../../include/core/DateUtils.h"
+#include "../../include/core/ExpenseImporter.h"
+#include "../../include/core/Metrics.h"
+#include <fstream>
+#include <iomanip>
+#include <map>
+#include <stdexcept>
+
+namespace {
+
+typedef json (CommandProcessor::*Handler)(const json&);
+
+json expenseToJson(const Expense& expense)
+{
+    json result = {
+        {"id", expense.id},
+        {"amount", expense.amount},
+        {"description", expense.description},
+        {"category", expense.category},
+        {"date", expense.date}
+    };
+    if (isProjectedExpense(expense)) {
+        result["projected"] = true;
+    }
+    return result;
+}
+
+json expensesToJson(const std::vector<Expense>& expenses)
+{
+    json result = json::array();
+    for (const auto& expense : expenses) {
+        result.push_back(expenseToJson(expense));
+    }
+    return result;
+}
+
+json success(const json& result)
+{
+    return {{"ok", true}, {"result", result}};
+}
+
+json failure(const std::string& message)
+{
+    return {{"ok", false}, {"error", message}};
+}
+
+// Reads a required field, naming it in the error when missing or mistyped
+template <typename T>
+T field(const json& request, const char* name)
+{
+    auto it = request.find(name);
+    if (it == request.end()) {
+        throw std::invalid_argument(std::string("missing field '") + name + "'");
+    }
+    try {
+        return it->get<T>();
+    } catch (const json::exception&) {
+        throw std::invalid_argument(std::string("invalid field '") + name + "'");
+    }
+}
+
+template <typename T>
+T optionalField(const json& request, const char* name, const T& fallback)
+{
+    return request.contains(name) ? field<T>(request, name) : fallback;
+}
+
+void checkMonth(int year, int month)
+{
+    if (month < 1 || month > 12 || year < 1 || year > 9999) {
+        throw std::invalid_argument("invalid year or month");
+    }
+}
+
+void checkCategory(const ExpenseManager& manager, const std::string& name)
+{
+    for (const auto& category : manager.getAllCategories()) {
+        if (category.name == name) {
+            return;
+        }
+    }
+    throw std::invalid_argument("unknown category '" + name + "'");
+}
+
+BudgetPeriod budgetPeriod(const json& request)
+{
+    std::string period = optionalField<std::string>(request, "period", "monthly");
+    if (period != "monthly" && period != "yearly") {
+        throw std::invalid_argument("period must be 'monthly' or 'yearly'");
+    }
+    return period == "yearly" ? BudgetPeriod::Yearly : BudgetPeriod::Monthly;
+}
+
+RecurrenceFrequency recurrenceFrequency(const json& request)
+{
+    std::string frequency = optionalField<std::string>(request, "frequency", "monthly");
+    if (frequency != "weekly" && frequency != "monthly" && frequency != "custom") {
+        throw std::invalid_argument("frequency must be 'weekly', 'monthly' or 'custom'");
+    }
+    return frequency == "weekly" ? RecurrenceFrequency::Weekly
+         : frequency == "custom" ? RecurrenceFrequency::Custom : RecurrenceFrequency::Monthly;
+}
+
+std::string csvField(const std::string& value)
+{
+    if (value.find_first_of(",\"\n") == std::string::npos) {
+        return value;
+    }
+    
+    std::string quoted = "\"";
+    for (char c : value) {
+        if (c == '"') {
+            quoted += '"';
+        }
+        quoted += c;
+    }
+    return quoted + "\"";
+}
+}
+
+CommandProcessor::CommandProcessor(ExpenseManager* manager)
+    : m_manager(manager), m_workspace(nullptr)
+{
+}
+
+CommandProcessor::CommandProcessor(Workspace* workspace)
+    : m_manager(nullptr), m_workspace(workspace)
+{
+}
+
+void CommandProcessor::setShutdownHandler(std::function<void()> handler)
+{
+    m_shutdownHandler = handler;
+}
+
+std::vector<std::string> CommandProcessor::commandNames()
+{
+    return {"add", "update", "delete", "get", "month", "category", "search", "query", "report",
+            "categories", "add-category", "delete-category", "budgets", "set-budget",
+            "remove-budget", "recurring", "add-recurring", "delete-recurring", "materialize",
+            "duplicates", "dedup", "duplicate-policy", "undo", "redo", "storage", "verify", "recover",
+            "import", "export", "metrics", "ledgers", "add-ledger", "remove-ledger", "consolidated",
+            "ping", "shutdown"};
+}
+
+json CommandProcessor::executeLine(const std::string& line)
+{
+    json request;
+    try {
+        request = json::parse(line);
+    } catch (const json::exception& e) {
+        return failure(std::string("malformed request: ") + e.what());
+    }
+    
+    return execute(request);
+}
+
+std::string CommandProcessor::dump(const json& message, int indent)
+{
+    return message.dump(indent, ' ', false, json::error_handler_t::replace);
+}
+
+json CommandProcessor::execute(const json& request)
+{
+    if (!request.is_array()) {
+        return executeOne(request);
+    }
+    
+    // Batch: one response per request, in order
+    json responses = json::array();
+    for (const auto& item : request) {
+        responses.push_back(executeOne(item));
+    }
+    return responses;
+}
+
+json CommandProcessor::executeOne(const json& request)
+{
+    static const std::map<std::string, Handler> handlers = {
+        {"add", &CommandProcessor::addExpense},
+        {"update", &CommandProcessor::updateExpense},
+        {"delete", &CommandProcessor::deleteExpense},
+        {"get", &CommandProcessor::getExpense},
+        {"month", &CommandProcessor::expensesByMonth},
+        {"category", &CommandProcessor::expensesByCategory},
+        {"search", &CommandProcessor::search},
+        {"query", &CommandProcessor::query},
+        {"report", &CommandProcessor::report},
+        {"categories", &CommandProcessor::categories},
+        {"add-category", &CommandProcessor::addCategory},
+        {"delete-category", &CommandProcessor::deleteCategory},
+        {"budgets", &CommandProcessor::budgets},
+        {"set-budget", &CommandProcessor::setBudget},
+        {"remove-budget", &CommandProcessor::removeBudget},
+        {"recurring", &CommandProcessor::recurringRules},
+        {"add-recurring", &CommandProcessor::addRecurringRule},
+        {"delete-recurring", &CommandProcessor::deleteRecurringRule},
+        {"materialize", &CommandProcessor::materializeRecurring},
+        {"duplicates", &CommandProcessor::duplicates},
+        {"dedup", &CommandProcessor::deduplicate},
+        {"duplicate-policy", &CommandProcessor::duplicatePolicy},
+        {"undo", &CommandProcessor::undo},
+        {"redo", &CommandProcessor::redo},
+        {"storage", &CommandProcessor::storageFormat},
+        {"verify", &CommandProcessor::verifyStorage},
+        {"recover", &CommandProcessor::recoverData},
+        {"import", &CommandProcessor::importFile},
+        {"export", &CommandProcessor::exportFile},
+        {"metrics", &CommandProcessor::metrics}
+    };
+    static const std::map<std::string, Handler> workspaceHandlers = {
+        {"ledgers", &CommandProcessor::ledgers},
+        {"add-ledger", &CommandProcessor::addLedger},
+        {"remove-ledger", &CommandProcessor::removeLedger},
+        {"consolidated", &CommandProcessor::consolidatedReport}
+    };
+    
+    PFM_SCOPED_TIMER("CommandProcessor::execute");
+    try {
+        if (!request.is_object()) {
+            return failure("request must be a JSON object");
+        }
+        
+        std::string command = field<std::string>(request, "command");
+        if (command == "ping") {
+            return success("pong");
+        }
+        if (command == "shutdown") {
+            if (!m_shutdownHandler) {
+                return failure("not running as a server");
+            }
+            m_shutdownHandler();
+            return success(true);
+        }
+        
+        auto workspaceHandler = workspaceHandlers.find(command);
+        if (workspaceHandler != workspaceHandlers.end() || request.contains("ledger")) {
+            if (!m_workspace) {
+                return failure("no workspace is open");
+            }
+            if (workspaceHandler != workspaceHandlers.end()) {
+                return (this->*workspaceHandler->second)(request);
+            }
+        }
+        
+        // Every other command runs against one ledger of the workspace, held
+        // for the length of the request in case it is removed meanwhile
+        if (m_workspace) {
+            std::string name = optionalField<std::string>(request, "ledger", "");
+            std::shared_ptr<ExpenseManager> ledger = name.empty() ? m_workspace->defaultLedger()
+                                                                  : m_workspace->ledger(name);
+            if (!ledger) {
+                return failure("unknown ledger '" + name + "'");
+            }
+            json ledgerRequest = request;
+            ledgerRequest.erase("ledger");
+            return CommandProcessor(ledger.get()).executeOne(ledgerRequest);
+        }
+        
+        auto handler = handlers.find(command);
+        if (handler == handlers.end()) {
+            return failure("unknown command '" + command + "'");
+        }
+        return (this->*handler->second)(request);
+    } catch (const std::exception& e) {
+        return failure(e.what());
+    }
+}
+
+json CommandProcessor::addExpense(const json& request)
+{
+    Expense expense;
+    expense.amount = field<double>(request, "amount");
+    expense.description = field<std::string>(request, "description");
+    expense.category = field<std::string>(request, "category");
+    expense.date = optionalField<std::string>(request, "date", DateUtils::today());
+    
+    if (!(expense.amount > 0.0)) {
+        return failure("amount must be positive");
+    }
+    if (!DateUtils::isValidDate(expense.date)) {
+        return failure("invalid date '" + expense.date + "', expected YYYY-MM-DD");
+    }
+    checkCategory(*m_manager, expense.category);
+    
+    std::vector<DuplicateMatch> duplicates;
+    bool added = m_manager->addExpense(expense, &duplicates);
+    if (!added && !duplicates.empty()) {
+        return failure("rejected as a duplicate of expense " + std::to_string(duplicates.front().existing.id));
+    }
+    if (!added) {
+        return failure("failed to add expense");
+    }
+    
+    json response = success(true);
+    if (!duplicates.empty()) {
+        response["duplicateOf"] = duplicates.front().existing.id;
+    }
+    return response;
+}
+
+json CommandProcessor::updateExpense(const json& request)
+{
+    int id = field<int>(request, "id");
+    Expense expense;
+    if (!m_manager->getExpense(id, expense)) {
+        return failure("no expense with id " + std::to_string(id));
+    }
+    
+    // Only the fields present in the request change
+    expense.amount = optionalField<double>(request, "amount", expense.amount);
+    expense.description = optionalField<std::string>(request, "description", expense.description);
+    expense.category = optionalField<std::string>(request, "category", expense.category);
+    expense.date = optionalField<std::string>(request, "date", expense.date);
+    
+    if (!(expense.amount > 0.0)) {
+        return failure("amount must be positive");
+    }
+    if (!DateUtils::isValidDate(expense.date)) {
+        return failure("invalid date '" + expense.date + "', expected YYYY-MM-DD");
+    }
+    checkCategory(*m_manager, expense.category);
+    
+    if (!m_manager->updateExpense(id, expense)) {
+        return failure("failed to update expense " + std::to_string(id));
+    }
+    return success(expenseToJson(expense));
+}
+
+json CommandProcessor::deleteExpense(const json& request)
+{
+    int id = field<int>(request, "id");
+    if (!m_manager->deleteExpense(id)) {
+        return failure("failed to delete expense " + std::to_string(id));
+    }
+    return success(true);
+}
+
+json CommandProcessor::getExpense(const json& request)
+{
+    int id = field<int>(request, "id");
+    Expense expense;
+    if (!m_manager->getExpense(id, expense)) {
+        return failure("no expense with id " + std::to_string(id));
+    }
+    return success(expenseToJson(expense));
+}
+
+json CommandProcessor::expensesByMonth(const json& request)
+{
+    int year = field<int>(request, "year");
+    int month = field<int>(request, "month");
+    checkMonth(year, month);
+    return success(expensesToJson(m_manager->getExpensesByMonth(year, month)));
+}
+
+json CommandProcessor::expensesByCategory(const json& request)
+{
+    return success(expensesToJson(m_manager->getExpensesByCategory(field<std::string>(request, "category"))));
+}
+
+json CommandProcessor::search(const json& request)
+{
+    SearchFilters filters;
+    filters.fromDate = optionalField<std::string>(request, "from", "");
+    filters.toDate = optionalField<std::string>(request, "to", "");
+    filters.categories = optionalField<std::vector<std::string>>(request, "categories", {});
+    filters.limit = optionalField<size_t>(request, "limit", 0);
+    
+    std::string query = optionalField<std::string>(request, "query", "");
+    return success(expensesToJson(m_manager->searchExpenses(query, filters)));
+}
+
+json CommandProcessor::query(const json& request)
+{
+    static const std::map<std::string, QuerySort> sorts = {
+        {"date", QuerySort::Date},
+        {"amount", QuerySort::Amount},
+        {"category", QuerySort::Category},
+        {"description", QuerySort::Description}
+    };
+    static const std::map<std::string, QueryGroupBy> groupings = {
+        {"none", QueryGroupBy::None},
+        {"category", QueryGroupBy::Category},
+        {"month", QueryGroupBy::Month},
+        {"year", QueryGroupBy::Year}
+    };
+    
+    ExpenseQuery expenseQuery;
+    expenseQuery.fromDate = optionalField<std::string>(request, "from", "");
+    expenseQuery.toDate = optionalField<std::string>(request, "to", "");
+    expenseQuery.categories = optionalField<std::vector<std::string>>(request, "categories", {});
+    expenseQuery.minAmount = optionalField<double>(request, "minAmount", expenseQuery.minAmount);
+    expenseQuery.maxAmount = optionalField<double>(request, "maxAmount", expenseQuery.maxAmount);
+    expenseQuery.text = optionalField<std::string>(request, "text", "");
+    expenseQuery.descending = optionalField<std::string>(request, "order", "desc") != "asc";
+    expenseQuery.offset = optionalField<size_t>(request, "offset", 0);
+    expenseQuery.limit = optionalField<size_t>(request, "limit", 0);
+    expenseQuery.includeProjected = optionalField<bool>(request, "projected", false);
+    
+    auto sort = sorts.find(optionalField<std::string>(request, "sort", "date"));
+    auto grouping = groupings.find(optionalField<std::string>(request, "groupBy", "none"));
+    if (sort == sorts.end() || grouping == groupings.end()) {
+        return failure("invalid sort or groupBy");
+    }
+    expenseQuery.sortBy = sort->second;
+    expenseQuery.groupBy = grouping->second;
+    
+    if ((!expenseQuery.fromDate.empty() && !DateUtils::isValidDate(expenseQuery.fromDate)) ||
+        (!expenseQuery.toDate.empty() && !DateUtils::isValidDate(expenseQuery.toDate))) {
+        return failure("invalid date range, expected YYYY-MM-DD");
+    }
+    
+    QueryResult result = m_manager->query(expenseQuery);
+    
+    json groups = json::array();
+    for (const auto& group : result.groups) {
+        groups.push_back({{"key", group.key}, {"total", group.total}, {"count", group.count}});
+    }
+    
+    return success({
+        {"rows", expensesToJson(result.rows)},
+        {"totalMatches", result.totalMatches},
+        {"totalAmount", result.totalAmount},
+        {"groups", groups},
+        {"plan", result.plan}
+    });
+}
+
+json CommandProcessor::report(const json& request)
+{
+    int year = field<int>(request, "year");
+    int month = field<int>(request, "month");
+    checkMonth(year, month);
+    
+    json categories = json::object();
+    for (const auto& entry : m_manager->generateCategorySummary(year, month)) {
+        categories[entry.first] = entry.second;
+    }
+    
+    return success({
+        {"year", year},
+        {"month", month},
+        {"categories", categories},
+        {"total", m_manager->getTotalExpenses(year, month)}
+    });
+}
+
+json CommandProcessor::categories(const json&)
+{
+    json result = json::array();
+    for (const auto& category : m_manager->getAllCategories()) {
+        result.push_back({{"name", category.name}, {"description", category.description}});
+    }
+    return success(result);
+}
+
+json CommandProcessor::addCategory(const json& request)
+{
+    Category category(field<std::string>(request, "name"),
+                      optionalField<std::string>(request, "description", ""));
+    if (category.name.empty() || !m_manager->addCategory(category)) {
+        return failure("failed to add category '" + category.name + "'");
+    }
+    return success(true);
+}
+
+json CommandProcessor::deleteCategory(const json& request)
+{
+    std::string name = field<std::string>(request, "name");
+    if (!m_manager->deleteCategory(name)) {
+        return failure("failed to delete category '" + name + "'; it may be in use");
+    }
+    return success(true);
+}
+
+json CommandProcessor::budgets(const json& request)
+{
+    int year = field<int>(request, "year");
+    int month = field<int>(request, "month");
+    checkMonth(year, month);
+    
+    json result = json::array();
+    for (const auto& status : m_manager->getBudgetStatus(year, month)) {
+        result.push_back({
+            {"category", status.budget.category},
+            {"period", status.budget.period == BudgetPeriod::Yearly ? "yearly" : "monthly"},
+            {"limit", status.budget.limit},
+            {"spent", status.spent},
+            {"utilization", status.utilization()}
+        });
+    }
+    return success(result);
+}
+
+json CommandProcessor::setBudget(const json& request)
+{
+    Budget budget(optionalField<std::string>(request, "category", ""), budgetPeriod(request),
+                  field<double>(request, "limit"));
+    budget.thresholds = optionalField<std::vector<double>>(request, "thresholds", budget.thresholds);
+    
+    if (!m_manager->setBudget(budget)) {
+        return failure("failed to set budget; check the category, limit and thresholds");
+    }
+    return success(true);
+}
+
+json CommandProcessor::removeBudget(const json& request)
+{
+    if (!m_manager->removeBudget(optionalField<std::string>(request, "category", ""), budgetPeriod(request))) {
+        return failure("no such budget");
+    }
+    return success(true);
+}
+
+json CommandProcessor::recurringRules(const json&)
+{
+    json result = json::array();
+    for (const auto& rule : m_manager->getRecurringRules()) {
+        result.push_back({
+            {"id", rule.id},
+            {"amount", rule.amount},
+            {"description", rule.description},
+            {"category", rule.category},
+            {"frequency", rule.frequency == RecurrenceFrequency::Weekly ? "weekly"
+                        : rule.frequency == RecurrenceFrequency::Custom ? "custom" : "monthly"},
+            {"interval", rule.interval},
+            {"start", rule.startDate},
+            {"end", rule.endDate},
+            {"materializedThrough", rule.materializedThrough}
+        });
+    }
+    return success(result);
+}
+
+json CommandProcessor::addRecurringRule(const json& request)
+{
+    RecurringRule rule;
+    rule.amount = field<double>(request, "amount");
+    rule.description = field<std::string>(request, "description");
+    rule.category = field<std::string>(request, "category");
+    rule.frequency = recurrenceFrequency(request);
+    rule.interval = optionalField<int>(request, "interval", 1);
+    rule.startDate = optionalField<std::string>(request, "start", DateUtils::today());
+    rule.endDate = optionalField<std::string>(request, "end", "");
+    
+    if (!m_manager->addRecurringRule(rule)) {
+        return failure("failed to add recurring expense; check the category, amount, interval and dates");
+    }
+    return success(true);
+}
+
+json CommandProcessor::deleteRecurringRule(const json& request)
+{
+    if (!m_manager->deleteRecurringRule(field<int>(request, "id"))) {
+        return failure("no recurring expense with that id");
+    }
+    return success(true);
+}
+
+json CommandProcessor::materializeRecurring(const json& request)
+{
+    std::string throughDate = optionalField<std::string>(request, "through", DateUtils::today());
+    if (!DateUtils::isValidDate(throughDate)) {
+        return failure("invalid date, expected YYYY-MM-DD");
+    }
+    return success({{"added", m_manager->materializeRecurring(throughDate)}});
+}
+
+json CommandProcessor::duplicates(const json& request)
+{
+    json result = json::array();
+    for (const auto& group : m_manager->findDuplicateGroups(optionalField<unsigned int>(request, "threads", 0))) {
+        result.push_back({
+            {"keeper", expenseToJson(group.keeper)},
+            {"duplicates", expensesToJson(group.duplicates)}
+        });
+    }
+    return success(result);
+}
+
+json CommandProcessor::deduplicate(const json& request)
+{
+    // Keeps the earliest expense of every group and deletes the rest in one batch
+    std::vector<DuplicateGroup> groups = m_manager->findDuplicateGroups(optionalField<unsigned int>(request, "threads", 0));
+    std::vector<int> ids;
+    for (const auto& group : groups) {
+        for (const auto& duplicate : group.duplicates) {
+            ids.push_back(duplicate.id);
+        }
+    }
+    
+    if (!ids.empty() && !m_manager->deleteExpenses(ids)) {
+        return failure("failed to delete duplicates");
+    }
+    return success({{"groups", groups.size()}, {"deleted", ids.size()}});
+}
+
+json CommandProcessor::duplicatePolicy(const json& request)
+{
+    static const std::map<std::string, DuplicatePolicy> policies = {
+        {"allow", DuplicatePolicy::Allow},
+        {"flag", DuplicatePolicy::Flag},
+        {"reject", DuplicatePolicy::Reject}
+    };
+    
+    // Without a policy, reports the current one
+    if (request.contains("policy") || request.contains("window")) {
+        DuplicatePolicy policy = m_manager->getDuplicatePolicy();
+        if (request.contains("policy")) {
+            auto it = policies.find(field<std::string>(request, "policy"));
+            if (it == policies.end()) {
+                return failure("policy must be 'allow', 'flag' or 'reject'");
+            }
+            policy = it->second;
+        }
+        if (!m_manager->setDuplicatePolicy(policy, optionalField<int>(request, "window", m_manager->getDuplicateWindow()))) {
+            return failure("invalid duplicate window");
+        }
+    }
+    
+    std::string name;
+    for (const auto& entry : policies) {
+        if (entry.second == m_manager->getDuplicatePolicy()) {
+            name = entry.first;
+        }
+    }
+    return success({{"policy", name}, {"window", m_manager->getDuplicateWindow()}});
+}
+
+json CommandProcessor::undo(const json&)
+{
+    std::string description = m_manager->undoDescription();
+    if (description.empty()) {
+        return failure("nothing to undo");
+    }
+    if (!m_manager->undo()) {
+        return failure("failed to undo " + description);
+    }
+    return success({{"undone", description}});
+}
+
+json CommandProcessor::redo(const json&)
+{
+    std::string description = m_manager->redoDescription();
+    if (description.empty()) {
+        return failure("nothing to redo");
+    }
+    if (!m_manager->redo()) {
+        return failure("failed to redo " + description);
+    }
+    return success({{"redone", description}});
+}
+
+json CommandProcessor::storageFormat(const json& request)
+{
+    static const std::map<std::string, StorageFormat> formats = {
+        {"json", StorageFormat::Json},
+        {"compact", StorageFormat::Compact}
+    };
+    
+    // Without a format, reports the current one
+    if (request.contains("format")) {
+        auto it = formats.find(field<std::string>(request, "format"));
+        if (it == formats.end()) {
+            return failure("format must be 'json' or 'compact'");
+        }
+        if (!m_manager->setStorageFormat(it->second)) {
+            return failure("failed to rewrite the ledger");
+        }
+    }
+    
+    std::string name;
+    for (const auto& entry : formats) {
+        if (entry.second == m_manager->getStorageFormat()) {
+            name = entry.first;
+        }
+    }
+    return success({{"format", name}});
+}
+
+json CommandProcessor::verifyStorage(const json&)
+{
+    static const char* const statusNames[] = {"ok", "unverified", "missing", "damaged"};
+    
+    StorageReport report = m_manager->verifyStorage();
+    json partitions = json::array();
+    for (const auto& partition : report.partitions) {
+        partitions.push_back({
+            {"year", partition.year},
+            {"file", partition.fileName},
+            {"status", statusNames[static_cast<int>(partition.status)]},
+            {"rows", partition.expectedRows},
+            {"damagedMonths", partition.damagedMonths}
+        });
+    }
+    return success({
+        {"ok", report.ok()},
+        {"manifestReadable", report.manifestReadable},
+        {"partitions", partitions}
+    });
+}
+
+json CommandProcessor::recoverData(const json&)
+{
+    RecoveryReport report = m_manager->recoverData();
+    return success({
+        {"manifestRebuilt", report.manifestRebuilt},
+        {"rowsRecovered", report.rowsRecovered},
+        {"rowsLost", report.rowsLost},
+        {"backups", report.backups}
+    });
+}
+
+json CommandProcessor::importFile(const json& request)
+{
+    ExpenseImporter importer(m_manager);
+    std::string rulesFile = optionalField<std::string>(request, "rules", "import_rules.json");
+    if (!importer.loadCategoryRules(rulesFile)) {
+        importer.setDefaultCategory("Miscellaneous");
+    }
+    
+    static const std::map<std::string, AmountSign> signs = {
+        {"auto", AmountSign::Auto},
+        {"positive", AmountSign::Positive},
+        {"negative", AmountSign::Negative}
+    };
+    auto sign = signs.find(optionalField<std::string>(request, "sign", "auto"));
+    if (sign == signs.end()) {
+        throw std::invalid_argument("sign must be 'auto', 'positive' or 'negative'");
+    }
+    importer.setAmountSign(sign->second);
+    
+    ImportResult result = importer.importFile(field<std::string>(request, "file"));
+    
+    json errors = json::array();
+    for (const auto& error : result.errors) {
+        errors.push_back({{"line", error.line}, {"message", error.message}});
+    }
+    json summary = {
+        {"rowsRead", result.rowsRead},
+        {"rowsImported", result.rowsImported},
+        {"duplicateRows", result.duplicateRows},
+        {"rowsPerSecond", result.rowsPerSecond()},
+        {"errors", errors}
+    };
+    
+    if (!result.success) {
+        json response = failure(result.errors.empty() ? "failed to save imported expenses"
+                                                      : result.errors.front().message);
+        response["result"] = summary;
+        return response;
+    }
+    return success(summary);
+}
+
+json CommandProcessor::exportFile(const json& request)
+{
+    std::string filePath = field<std::string>(request, "file");
+    std::string format = optionalField<std::string>(request, "format",
+                                                    fs::path(filePath).extension() == ".json" ? "json" : "csv");
+    if (format != "csv" && format != "json") {
+        return failure("unknown export format '" + format + "'");
+    }
+    
+    // A single month, or a consistent snapshot of the whole ledger
+    std::vector<Expense> expenses;
+    if (request.contains("year") || request.contains("month")) {
+        int year = field<int>(request, "year");
+        int month = field<int>(request, "month");
+        checkMonth(year, month);
+        expenses = m_manager->getExpensesByMonth(year, month, false);  // Stored rows only
+    } else {
+        expenses = m_manager->snapshot()->getAllExpenses();
+    }
+    
+    std::ofstream file(filePath);
+    if (!file.is_open()) {
+        return failure("cannot open " + filePath + " for writing");
+    }
+    
+    if (format == "json") {
+        file << std::setw(4) << expensesToJson(expenses) << std::endl;
+    } else {
+        file << "ID,Date,Category,Description,Amount\n";
+        for (const auto& expense : expenses) {
+            file << expense.id << "," << expense.date << "," << csvField(expense.category) << ","
+                 << csvField(expense.description) << "," << std::fixed << std::setprecision(2)
+                 << expense.amount << "\n";
+        }
+    }
+    
+    if (!file.good()) {
+        return failure("failed to write " + filePath);
+    }
+    return success({{"file", filePath}, {"rows", expenses.size()}});
+}
+
+json CommandProcessor::metrics(const json&)
+{
+    MetricsReport report = Metrics::instance().report();
+    
+    json timers = json::object();
+    for (const auto& timer : report.timers) {
+        timers[timer.name] = {
+            {"count", timer.count},
+            {"meanMs", timer.meanMs},
+            {"p50Ms", timer.p50Ms},
+            {"p90Ms", timer.p90Ms},
+            {"p99Ms", timer.p99Ms},
+            {"maxMs", timer.maxMs}
+        };
+    }
+    
+    return success({{"timers", timers}, {"counters", report.counters}});
+}
+
+json CommandProcessor::ledgers(const json&)
+{
+    json result = json::array();
+    for (const auto& name : m_workspace->getLedgerNames()) {
+        std::shared_ptr<ExpenseManager> ledger = m_workspace->ledger(name);
+        if (!ledger) {
+            continue;  // Removed meanwhile
+        }
+        result.push_back({
+            {"name", name},
+            {"file", m_workspace->ledgerFile(name)},
+            {"loadedYears", ledger->getLoadedYears()},
+            {"cachedBytes", ledger->getCachedBytes()}
+        });
+    }
+    
+    return success({
+        {"ledgers", result},
+        {"memoryBudget", m_workspace->getMemoryBudget()},
+        {"cachedBytes", m_workspace->getCachedBytes()}
+    });
+}
+
+json CommandProcessor::addLedger(const json& request)
+{
+    std::string name = field<std::string>(request, "name");
+    if (!m_workspace->addLedger(name, field<std::string>(request, "file"))) {
+        return failure("ledger '" + name + "' or its file is already in the workspace");
+    }
+    return success(name);
+}
+
+json CommandProcessor::removeLedger(const json& request)
+{
+    std::string name = field<std::string>(request, "name");
+    if (!m_workspace->removeLedger(name)) {
+        return failure("cannot remove ledger '" + name + "'");
+    }
+    return success(name);
+}
+
+json CommandProcessor::consolidatedReport(const json& request)
+{
+    int year = field<int>(request, "year");
+    int month = field<int>(request, "month");
+    checkMonth(year, month);
+    
+    ConsolidatedReport report = m_workspace->consolidatedReport(year, month);
+    json ledgers = json::array();
+    for (const auto& totals : report.ledgers) {
+        ledgers.push_back({
+            {"ledger", totals.ledger},
+            {"categories", totals.categories},
+            {"total", totals.total}
+        });
+    }
+    
+    return success({
+        {"year", year},
+        {"month", month},
+        {"ledgers", ledgers},
+        {"categories", report.categories},
+        {"total", report.total}
+    });
+}
@@ -0,0 +1,266 @@
+#include "../../include/cli/QueryServer.h"
+#include <iostream>
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <thread>
+
+#ifndef _WIN32
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+// Longest request line accepted before the client is dropped
+const size_t kMaxRequestBytes = 64 * 1024 * 1024;
+const int kPollIntervalMs = 200;
+
+#ifndef _WIN32
+bool makeAddress(const std::string& socketPath, sockaddr_un& address)
+{
+    std::memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if (socketPath.empty() || socketPath.size() >= sizeof(address.sun_path)) {
+        std::cerr << "Invalid socket path: " << socketPath << std::endl;
+        return false;
+    }
+    std::strncpy(address.sun_path, socketPath.c_str(), sizeof(address.sun_path) - 1);
+    return true;
+}
+
+int connectTo(const std::string& socketPath)
+{
+    sockaddr_un address;
+    if (!makeAddress(socketPath, address)) {
+        return -1;
+    }
+    
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) {
+        return -1;
+    }
+    if (connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) < 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+bool sendAll(int fd, const std::string& data)
+{
+    size_t sent = 0;
+    while (sent < data.size()) {
+        ssize_t written = send(fd, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+        if (written < 0 && errno == EINTR) {
+            continue;
+        }
+        if (written <= 0) {
+            return false;
+        }
+        sent += static_cast<size_t>(written);
+    }
+    return true;
+}
+#endif
+}
+
+QueryServer::QueryServer(CommandProcessor* processor, const std::string& socketPath)
+    : m_processor(processor), m_socketPath(socketPath), m_listenSocket(-1), m_running(false)
+{
+}
+
+QueryServer::~QueryServer()
+{
+#ifndef _WIN32
+    if (m_listenSocket >= 0) {
+        close(m_listenSocket);
+        unlink(m_socketPath.c_str());
+    }
+#endif
+}
+
+#ifndef _WIN32
+
+bool QueryServer::start()
+{
+    sockaddr_un address;
+    if (!makeAddress(m_socketPath, address)) {
+        return false;
+    }
+    
+    // A socket file nobody answers on is left over from a crashed server
+    int existing = connectTo(m_socketPath);
+    if (existing >= 0) {
+        close(existing);
+        std::cerr << "Another server is already listening on " << m_socketPath << std::endl;
+        return false;
+    }
+    unlink(m_socketPath.c_str());
+    
+    m_listenSocket = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (m_listenSocket < 0 ||
+        bind(m_listenSocket, reinterpret_cast<sockaddr*>(&address), sizeof(address)) < 0 ||
+        listen(m_listenSocket, SOMAXCONN) < 0) {
+        std::cerr << "Error listening on " << m_socketPath << ": " << std::strerror(errno) << std::endl;
+        if (m_listenSocket >= 0) {
+            close(m_listenSocket);
+            m_listenSocket = -1;
+        }
+        return false;
+    }
+    
+    m_running = true;
+    return true;
+}
+
+void QueryServer::run()
+{
+    while (m_running) {
+        // Wake up regularly to notice stop()
+        pollfd listener = {m_listenSocket, POLLIN, 0};
+        if (poll(&listener, 1, kPollIntervalMs) <= 0) {
+            continue;
+        }
+        
+        int clientSocket = accept(m_listenSocket, nullptr, nullptr);
+        if (clientSocket < 0) {
+            continue;
+        }
+        
+        std::lock_guard<std::mutex> lock(m_clientsMutex);
+        m_clientSockets.push_back(clientSocket);
+        std::thread(&QueryServer::serveClient, this, clientSocket).detach();
+    }
+    
+    // Unblock clients waiting for their next request, let in-flight ones
+    // finish writing their response, then wait for every thread to exit
+    std::unique_lock<std::mutex> lock(m_clientsMutex);
+    for (int clientSocket : m_clientSockets) {
+        shutdown(clientSocket, SHUT_RD);
+    }
+    m_clientsDone.wait(lock, [this]() { return m_clientSockets.empty(); });
+}
+
+void QueryServer::stop()
+{
+    m_running = false;
+}
+
+void QueryServer::serveClient(int clientSocket)
+{
+    std::string buffer;
+    char chunk[64 * 1024];
+    bool open = true;
+    
+    while (open) {
+        ssize_t received = recv(clientSocket, chunk, sizeof(chunk), 0);
+        if (received < 0 && errno == EINTR) {
+            continue;
+        }
+        if (received <= 0) {
+            break;
+        }
+        buffer.append(chunk, static_cast<size_t>(received));
+        
+        // Answer every complete line; keep a partial one for the next read
+        size_t lineStart = 0;
+        for (size_t newline = buffer.find('\n'); newline != std::string::npos && open;
+             newline = buffer.find('\n', lineStart)) {
+            std::string line = buffer.substr(lineStart, newline - lineStart);
+            lineStart = newline + 1;
+            if (!line.empty() && line.back() == '\r') {
+                line.pop_back();
+            }
+            if (line.empty()) {
+                continue;
+            }
+            
+            // A throwing request must not take the server down with it
+            std::string response;
+            try {
+                response = CommandProcessor::dump(m_processor->executeLine(line));
+            } catch (const std::exception& e) {
+                response = CommandProcessor::dump(json({{"ok", false}, {"error", e.what()}}));
+            }
+            open = sendAll(clientSocket, response + "\n");
+        }
+        buffer.erase(0, lineStart);
+        
+        if (buffer.size() > kMaxRequestBytes) {
+            sendAll(clientSocket, CommandProcessor::dump(json({{"ok", false}, {"error", "request too large"}})) + "\n");
+            break;
+        }
+    }
+    
+    close(clientSocket);
+    
+    std::lock_guard<std::mutex> lock(m_clientsMutex);
+    m_clientSockets.erase(std::find(m_clientSockets.begin(), m_clientSockets.end(), clientSocket));
+    m_clientsDone.notify_all();
+}
+
+bool QueryServer::sendRequest(const std::string& socketPath, const std::string& requestLine,
+                              std::string& responseLine)
+{
+    int fd = connectTo(socketPath);
+    if (fd < 0) {
+        std::cerr << "Cannot connect to " << socketPath << ": " << std::strerror(errno) << std::endl;
+        return false;
+    }
+    
+    bool success = sendAll(fd, requestLine + "\n");
+    responseLine.clear();
+    
+    char chunk[64 * 1024];
+    while (success) {
+        ssize_t received = recv(fd, chunk, sizeof(chunk), 0);
+        if (received < 0 && errno == EINTR) {
+            continue;
+        }
+        if (received <= 0) {
+            success = false;
+            break;
+        }
+        
+        responseLine.append(chunk, static_cast<size_t>(received));
+        if (responseLine.back() == '\n') {
+            responseLine.pop_back();
+            break;
+        }
+    }
+    
+    close(fd);
+    return success;
+}
+
+#else
+
+bool QueryServer::start()
+{
+    std::cerr << "The query server needs Unix domain sockets and is not available on this platform" << std::endl;
+    return false;
+}
+
+void QueryServer::run()
+{
+}
+
+void QueryServer::stop()
+{
+    m_running = false;
+}
+
+void QueryServer::serveClient(int)
+{
+}
+
+bool QueryServer::sendRequest(const std::string&, const std::string&, std::string&)
+{
+    std::cerr << "The query server needs Unix domain sockets and is not available on this platform" << std::endl;
+    return false;
+}
+
+#endif
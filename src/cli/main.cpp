@@ -0,0 +1,403 @@
+#include "cli/CommandProcessor.h"
+#include "cli/QueryServer.h"
+#include "core/ExpenseManager.h"
+#include "core/Workspace.h"
+#include <iostream>
+#include <csignal>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace {
+
+QueryServer* g_server = nullptr;
+
+void handleSignal(int)
+{
+    if (g_server) {
+        g_server->stop();
+    }
+}
+
+void printUsage()
+{
+    std::cerr <<
+        "Usage: pfm [--data FILE | --workspace FILE [--ledger NAME]] [--socket PATH] COMMAND [ARGUMENTS]\n"
+        "\n"
+        "Runs one command against the ledger in FILE (default expenses.json), or\n"
+        "sends it to a server started with 'pfm serve' when --socket is given.\n"
+        "With --workspace, commands run against the ledger NAME of the workspace\n"
+        "(default its first).\n"
+        "\n"
+        "Commands:\n"
+        "  add AMOUNT DESCRIPTION CATEGORY [DATE]\n"
+        "  update ID [--amount A] [--description D] [--category C] [--date YYYY-MM-DD]\n"
+        "  delete ID\n"
+        "  get ID\n"
+        "  month YEAR MONTH\n"
+        "  category NAME\n"
+        "  search [QUERY] [--from DATE] [--to DATE] [--category NAME]... [--limit N]\n"
+        "  query [TEXT] [--from DATE] [--to DATE] [--category NAME]... [--min AMOUNT]\n"
+        "        [--max AMOUNT] [--sort date|amount|category|description] [--order asc|desc]\n"
+        "        [--offset N] [--limit N] [--group category|month|year]\n"
+        "  report YEAR MONTH\n"
+        "  categories\n"
+        "  add-category NAME [DESCRIPTION]\n"
+        "  delete-category NAME\n"
+        "  budgets YEAR MONTH\n"
+        "  set-budget LIMIT [--category NAME] [--period monthly|yearly]\n"
+        "  remove-budget [--category NAME] [--period monthly|yearly]\n"
+        "  recurring\n"
+        "  add-recurring AMOUNT DESCRIPTION CATEGORY [--start DATE] [--end DATE]\n"
+        "        [--every weekly|monthly|custom] [--interval N]\n"
+        "  delete-recurring ID\n"
+        "  materialize [DATE]    Store recurring expenses due up to DATE (default today)\n"
+        "  duplicates [--threads N]\n"
+        "  dedup [--threads N]   Delete all but the earliest expense of each duplicate group\n"
+        "  duplicate-policy [allow|flag|reject] [--window DAYS]\n"
+        "  undo, redo            Step through the server's edits since it started\n"
+        "  storage [json|compact] Rewrite the ledger in another format\n"
+        "  verify                Check every partition file against its checksums\n"
+        "  recover               Keep what is readable from damaged files and save it\n"
+        "  import FILE [--rules FILE] [--sign auto|positive|negative]\n"
+        "  export FILE [--format csv|json] [--year YEAR --month MONTH]\n"
+        "  metrics\n"
+        "  ledgers               List the ledgers of the workspace\n"
+        "  add-ledger NAME FILE\n"
+        "  remove-ledger NAME    Close a ledger; its files are kept\n"
+        "  consolidated YEAR MONTH  Category totals across every ledger\n"
+        "  exec JSON             Run a raw request, or an array of them as a batch\n"
+        "  serve                 Keep the ledger loaded and answer newline-delimited\n"
+        "                        JSON requests on --socket (default pfm.sock)\n"
+        "  shutdown              Stop the server on --socket\n";
+}
+
+struct Arguments {
+    std::vector<std::string> positional;
+    std::multimap<std::string, std::string> options;
+    
+    bool has(const std::string& name) const { return options.count(name) > 0; }
+    std::string option(const std::string& name) const { return options.find(name)->second; }
+};
+
+// Options take the next argument as their value
+bool parseArguments(int argc, char* argv[], Arguments& arguments)
+{
+    for (int i = 1; i < argc; ++i) {
+        std::string argument = argv[i];
+        if (argument.size() > 2 && argument.compare(0, 2, "--") == 0) {
+            if (i + 1 >= argc) {
+                std::cerr << "Missing value for " << argument << std::endl;
+                return false;
+            }
+            arguments.options.emplace(argument.substr(2), argv[++i]);
+        } else {
+            arguments.positional.push_back(argument);
+        }
+    }
+    return !arguments.positional.empty();
+}
+
+int toInt(const std::string& value)
+{
+    size_t used = 0;
+    int result = std::stoi(value, &used);
+    if (used != value.size()) {
+        throw std::invalid_argument("not a number: " + value);
+    }
+    return result;
+}
+
+double toDouble(const std::string& value)
+{
+    size_t used = 0;
+    double result = std::stod(value, &used);
+    if (used != value.size()) {
+        throw std::invalid_argument("not a number: " + value);
+    }
+    return result;
+}
+
+// Translates command-line arguments into a protocol request; false on a usage error
+bool buildRequest(const Arguments& arguments, json& request)
+{
+    const std::vector<std::string>& args = arguments.positional;
+    const std::string& command = args[0];
+    request = {{"command", command}};
+    
+    if (command == "add" && (args.size() == 4 || args.size() == 5)) {
+        request["amount"] = toDouble(args[1]);
+        request["description"] = args[2];
+        request["category"] = args[3];
+        if (args.size() == 5) {
+            request["date"] = args[4];
+        }
+    } else if (command == "update" && args.size() == 2) {
+        request["id"] = toInt(args[1]);
+        if (arguments.has("amount")) {
+            request["amount"] = toDouble(arguments.option("amount"));
+        }
+        for (const char* name : {"description", "category", "date"}) {
+            if (arguments.has(name)) {
+                request[name] = arguments.option(name);
+            }
+        }
+    } else if ((command == "delete" || command == "get") && args.size() == 2) {
+        request["id"] = toInt(args[1]);
+    } else if ((command == "month" || command == "report" || command == "budgets" || command == "consolidated") &&
+               args.size() == 3) {
+        request["year"] = toInt(args[1]);
+        request["month"] = toInt(args[2]);
+    } else if (command == "category" && args.size() == 2) {
+        request["category"] = args[1];
+    } else if (command == "search" && args.size() <= 2) {
+        request["query"] = args.size() == 2 ? args[1] : "";
+        if (arguments.has("from")) {
+            request["from"] = arguments.option("from");
+        }
+        if (arguments.has("to")) {
+            request["to"] = arguments.option("to");
+        }
+        if (arguments.has("limit")) {
+            request["limit"] = toInt(arguments.option("limit"));
+        }
+        auto range = arguments.options.equal_range("category");
+        for (auto it = range.first; it != range.second; ++it) {
+            request["categories"].push_back(it->second);
+        }
+    } else if (command == "query" && args.size() <= 2) {
+        request["text"] = args.size() == 2 ? args[1] : "";
+        const std::map<std::string, std::string> stringOptions = {
+            {"from", "from"}, {"to", "to"}, {"sort", "sort"}, {"order", "order"}, {"group", "groupBy"}
+        };
+        for (const auto& option : stringOptions) {
+            if (arguments.has(option.first)) {
+                request[option.second] = arguments.option(option.first);
+            }
+        }
+        if (arguments.has("min")) {
+            request["minAmount"] = toDouble(arguments.option("min"));
+        }
+        if (arguments.has("max")) {
+            request["maxAmount"] = toDouble(arguments.option("max"));
+        }
+        if (arguments.has("offset")) {
+            request["offset"] = toInt(arguments.option("offset"));
+        }
+        if (arguments.has("limit")) {
+            request["limit"] = toInt(arguments.option("limit"));
+        }
+        auto range = arguments.options.equal_range("category");
+        for (auto it = range.first; it != range.second; ++it) {
+            request["categories"].push_back(it->second);
+        }
+    } else if (command == "add-category" && (args.size() == 2 || args.size() == 3)) {
+        request["name"] = args[1];
+        request["description"] = args.size() == 3 ? args[2] : "";
+    } else if (command == "delete-category" && args.size() == 2) {
+        request["name"] = args[1];
+    } else if ((command == "set-budget" && args.size() == 2) || (command == "remove-budget" && args.size() == 1)) {
+        // Without --category the budget covers all spending
+        if (command == "set-budget") {
+            request["limit"] = toDouble(args[1]);
+        }
+        if (arguments.has("category")) {
+            request["category"] = arguments.option("category");
+        }
+        if (arguments.has("period")) {
+            request["period"] = arguments.option("period");
+        }
+    } else if (command == "add-recurring" && args.size() == 4) {
+        request["amount"] = toDouble(args[1]);
+        request["description"] = args[2];
+        request["category"] = args[3];
+        if (arguments.has("every")) {
+            request["frequency"] = arguments.option("every");
+        }
+        if (arguments.has("interval")) {
+            request["interval"] = toInt(arguments.option("interval"));
+        }
+        for (const char* name : {"start", "end"}) {
+            if (arguments.has(name)) {
+                request[name] = arguments.option(name);
+            }
+        }
+    } else if (command == "delete-recurring" && args.size() == 2) {
+        request["id"] = toInt(args[1]);
+    } else if (command == "materialize" && args.size() <= 2) {
+        if (args.size() == 2) {
+            request["through"] = args[1];
+        }
+    } else if ((command == "duplicates" || command == "dedup") && args.size() == 1) {
+        if (arguments.has("threads")) {
+            request["threads"] = toInt(arguments.option("threads"));
+        }
+    } else if (command == "duplicate-policy" && args.size() <= 2) {
+        if (args.size() == 2) {
+            request["policy"] = args[1];
+        }
+        if (arguments.has("window")) {
+            request["window"] = toInt(arguments.option("window"));
+        }
+    } else if (command == "storage" && args.size() <= 2) {
+        if (args.size() == 2) {
+            request["format"] = args[1];
+        }
+    } else if (command == "import" && args.size() == 2) {
+        // Absolute paths so a server in another directory finds the same files
+        request["file"] = fs::absolute(args[1]).string();
+        if (arguments.has("rules")) {
+            request["rules"] = fs::absolute(arguments.option("rules")).string();
+        }
+        if (arguments.has("sign")) {
+            request["sign"] = arguments.option("sign");
+        }
+    } else if (command == "export" && args.size() == 2) {
+        request["file"] = fs::absolute(args[1]).string();
+        if (arguments.has("format")) {
+            request["format"] = arguments.option("format");
+        }
+        if (arguments.has("year") || arguments.has("month")) {
+            if (!arguments.has("year") || !arguments.has("month")) {
+                return false;
+            }
+            request["year"] = toInt(arguments.option("year"));
+            request["month"] = toInt(arguments.option("month"));
+        }
+    } else if ((command == "categories" || command == "recurring" || command == "metrics" || command == "ping" ||
+                command == "undo" || command == "redo" || command == "verify" || command == "recover" ||
+                command == "ledgers" || command == "shutdown") && args.size() == 1) {
+    } else if (command == "add-ledger" && args.size() == 3) {
+        request["name"] = args[1];
+        request["file"] = fs::absolute(args[2]).string();
+    } else if (command == "remove-ledger" && args.size() == 2) {
+        request["name"] = args[1];
+    } else if (command == "exec" && args.size() == 2) {
+        request = json::parse(args[1]);
+    } else {
+        return false;
+    }
+    
+    // Commands other than the raw ones go to the chosen ledger of a workspace
+    if (arguments.has("ledger") && command != "exec") {
+        request["ledger"] = arguments.option("ledger");
+    }
+    
+    return true;
+}
+
+// Prints the result of a single request, or the raw responses of a batch
+bool printResponse(const json& response, bool raw)
+{
+    if (raw || response.is_array()) {
+        std::cout << CommandProcessor::dump(response, 2) << std::endl;
+        if (response.is_array()) {
+            for (const auto& item : response) {
+                if (!item.value("ok", false)) {
+                    return false;
+                }
+            }
+            return true;
+        }
+        return response.value("ok", false);
+    }
+    
+    if (!response.value("ok", false)) {
+        std::cerr << "Error: " << response.value("error", std::string("unknown error")) << std::endl;
+        if (response.contains("result")) {
+            std::cout << CommandProcessor::dump(response["result"], 2) << std::endl;
+        }
+        return false;
+    }
+    
+    std::cout << CommandProcessor::dump(response["result"], 2) << std::endl;
+    return true;
+}
+
+// Opens the workspace or the single ledger the arguments name
+struct Ledgers {
+    std::unique_ptr<Workspace> workspace;
+    std::unique_ptr<ExpenseManager> manager;
+    std::unique_ptr<CommandProcessor> processor;
+    std::string name;
+    
+    explicit Ledgers(const Arguments& arguments)
+    {
+        if (arguments.has("workspace")) {
+            name = arguments.option("workspace");
+            workspace.reset(new Workspace(name));
+            processor.reset(new CommandProcessor(workspace.get()));
+        } else {
+            name = arguments.has("data") ? arguments.option("data") : "expenses.json";
+            manager.reset(new ExpenseManager(name));
+            processor.reset(new CommandProcessor(manager.get()));
+        }
+    }
+};
+
+int serve(const Arguments& arguments)
+{
+    std::string socketPath = arguments.has("socket") ? arguments.option("socket") : "pfm.sock";
+    
+    Ledgers ledgers(arguments);
+    CommandProcessor& processor = *ledgers.processor;
+    QueryServer server(&processor, socketPath);
+    processor.setShutdownHandler([&server]() { server.stop(); });
+    
+    if (!server.start()) {
+        return 1;
+    }
+    
+    g_server = &server;
+    std::signal(SIGINT, handleSignal);
+    std::signal(SIGTERM, handleSignal);
+    
+    std::cerr << "Serving " << ledgers.name << " on " << socketPath << std::endl;
+    server.run();
+    g_server = nullptr;
+    
+    return 0;
+}
+}
+
+int main(int argc, char* argv[])
+{
+    Arguments arguments;
+    if (!parseArguments(argc, argv, arguments) || (arguments.has("data") && arguments.has("workspace"))) {
+        printUsage();
+        return 2;
+    }
+    
+    if (arguments.positional[0] == "serve") {
+        if (arguments.positional.size() != 1) {
+            printUsage();
+            return 2;
+        }
+        return serve(arguments);
+    }
+    
+    json request;
+    try {
+        if (!buildRequest(arguments, request)) {
+            printUsage();
+            return 2;
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "Invalid arguments: " << e.what() << std::endl;
+        return 2;
+    }
+    bool raw = arguments.positional[0] == "exec";
+    
+    // Forward to a running server, which already has the ledger loaded
+    if (arguments.has("socket")) {
+        std::string responseLine;
+        if (!QueryServer::sendRequest(arguments.option("socket"), CommandProcessor::dump(request), responseLine)) {
+            return 1;
+        }
+        return printResponse(json::parse(responseLine), raw) ? 0 : 1;
+    }
+    
+    Ledgers ledgers(arguments);
+    return printResponse(ledgers.processor->execute(request), raw) ? 0 : 1;
+}
@@ -0,0 +1,112 @@
+#include "../../include/core/Crc32c.h"
+#include <cstring>
+
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#include <nmmintrin.h>
+#define PFM_CRC32C_SSE42
+#endif
+
+namespace {
+
+const uint32_t kPolynomial = 0x82f63b78;  // Reflected Castagnoli polynomial
+
+// table[0] is the classic byte-at-a-time table; table[k] advances a byte
+// through k further zero bytes, so eight bytes fold in with eight lookups
+struct Tables {
+    uint32_t table[8][256];
+    
+    Tables()
+    {
+        for (uint32_t i = 0; i < 256; ++i) {
+            uint32_t crc = i;
+            for (int bit = 0; bit < 8; ++bit) {
+                crc = (crc & 1) ? (crc >> 1) ^ kPolynomial : crc >> 1;
+            }
+            table[0][i] = crc;
+        }
+        for (int k = 1; k < 8; ++k) {
+            for (uint32_t i = 0; i < 256; ++i) {
+                table[k][i] = (table[k - 1][i] >> 8) ^ table[0][table[k - 1][i] & 0xff];
+            }
+        }
+    }
+};
+
+uint32_t extendPortable(uint32_t crc, const unsigned char* data, size_t size)
+{
+    static const Tables tables;
+    const auto& table = tables.table;
+    
+    crc = ~crc;
+    while (size >= 8) {
+        uint32_t low = crc ^ (static_cast<uint32_t>(data[0]) | static_cast<uint32_t>(data[1]) << 8 |
+                              static_cast<uint32_t>(data[2]) << 16 | static_cast<uint32_t>(data[3]) << 24);
+        crc = table[7][low & 0xff] ^ table[6][(low >> 8) & 0xff] ^ table[5][(low >> 16) & 0xff] ^
+              table[4][low >> 24] ^ table[3][data[4]] ^ table[2][data[5]] ^ table[1][data[6]] ^ table[0][data[7]];
+        data += 8;
+        size -= 8;
+    }
+    while (size-- > 0) {
+        crc = table[0][(crc ^ *data++) & 0xff] ^ (crc >> 8);
+    }
+    return ~crc;
+}
+
+#ifdef PFM_CRC32C_SSE42
+__attribute__((target("sse4.2")))
+uint32_t extendSse42(uint32_t crc, const unsigned char* data, size_t size)
+{
+    crc = ~crc;
+#if defined(__x86_64__)
+    uint64_t wide = crc;
+    while (size >= 8) {
+        uint64_t word;
+        std::memcpy(&word, data, sizeof(word));
+        wide = _mm_crc32_u64(wide, word);
+        data += 8;
+        size -= 8;
+    }
+    crc = static_cast<uint32_t>(wide);
+#endif
+    while (size >= 4) {
+        uint32_t word;
+        std::memcpy(&word, data, sizeof(word));
+        crc = _mm_crc32_u32(crc, word);
+        data += 4;
+        size -= 4;
+    }
+    while (size-- > 0) {
+        crc = _mm_crc32_u8(crc, *data++);
+    }
+    return ~crc;
+}
+#endif
+
+using ExtendFunction = uint32_t (*)(uint32_t, const unsigned char*, size_t);
+
+// Picked once, on first use
+ExtendFunction extendFunction()
+{
+#ifdef PFM_CRC32C_SSE42
+    static const ExtendFunction function = __builtin_cpu_supports("sse4.2") ? extendSse42 : extendPortable;
+    return function;
+#else
+    return extendPortable;
+#endif
+}
+
+} // namespace
+
+namespace Crc32c {
+
+uint32_t extend(uint32_t crc, const void* data, size_t size)
+{
+    return extendFunction()(crc, static_cast<const unsigned char*>(data), size);
+}
+
+bool isHardwareAccelerated()
+{
+    return extendFunction() != extendPortable;
+}
+
+} // namespace Crc32c
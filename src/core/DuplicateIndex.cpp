@@ -0,0 +1,147 @@
+#include "../../include/core/DuplicateIndex.h"
+#include "../../include/core/DateUtils.h"
+#include <cmath>
+
+namespace {
+
+const uint64_t kFnvOffset = 14695981039346656037ULL;
+const uint64_t kFnvPrime = 1099511628211ULL;
+
+void hashByte(uint64_t& hash, unsigned char byte)
+{
+    hash = (hash ^ byte) * kFnvPrime;
+}
+
+long long amountInCents(double amount)
+{
+    return std::llround(amount * 100.0);
+}
+
+// Feeds the lower-cased runs of letters and digits of text to sink, joined by
+// single spaces; the same characters SearchIndex treats as word characters
+template <typename Sink>
+void forEachNormalized(const std::string& text, Sink sink)
+{
+    bool started = false;
+    bool pendingSpace = false;
+    
+    for (char c : text) {
+        unsigned char byte = static_cast<unsigned char>(c);
+        if (byte >= 'A' && byte <= 'Z') {
+            byte = static_cast<unsigned char>(byte - 'A' + 'a');
+        }
+        if ((byte >= 'a' && byte <= 'z') || (byte >= '0' && byte <= '9') || byte >= 0x80) {
+            if (pendingSpace && started) {
+                sink(' ');
+            }
+            sink(static_cast<char>(byte));
+            started = true;
+            pendingSpace = false;
+        } else {
+            pendingSpace = true;
+        }
+    }
+}
+
+std::string normalizeText(const std::string& text)
+{
+    std::string normalized;
+    normalized.reserve(text.size());
+    forEachNormalized(text, [&normalized](char c) { normalized.push_back(c); });
+    return normalized;
+}
+
+// Hashed without building the normalized string, since this runs for every loaded row
+void hashText(uint64_t& hash, const std::string& text)
+{
+    forEachNormalized(text, [&hash](char c) { hashByte(hash, static_cast<unsigned char>(c)); });
+    hashByte(hash, 0);  // Keeps "ab"+"c" apart from "a"+"bc"
+}
+}
+
+uint64_t DuplicateIndex::fingerprint(const Expense& expense)
+{
+    uint64_t hash = kFnvOffset;
+    long long cents = amountInCents(expense.amount);
+    for (int i = 0; i < 8; ++i) {
+        hashByte(hash, static_cast<unsigned char>(cents >> (i * 8)));
+    }
+    hashText(hash, expense.category);
+    hashText(hash, expense.description);
+    return hash;
+}
+
+bool DuplicateIndex::equivalent(const Expense& a, const Expense& b)
+{
+    return amountInCents(a.amount) == amountInCents(b.amount) &&
+           normalizeText(a.category) == normalizeText(b.category) &&
+           normalizeText(a.description) == normalizeText(b.description);
+}
+
+long DuplicateIndex::dayNumber(const std::string& date)
+{
+    int year, month, day;
+    return DateUtils::parseDate(date, year, month, day) ? DateUtils::daysFromCivil(year, month, day) : 0;
+}
+
+uint64_t DuplicateIndex::key(uint64_t fingerprint, long day)
+{
+    uint64_t hash = fingerprint;
+    for (int i = 0; i < 4; ++i) {
+        hashByte(hash, static_cast<unsigned char>(day >> (i * 8)));
+    }
+    return hash;
+}
+
+void DuplicateIndex::add(const Expense& expense)
+{
+    Entry entry;
+    entry.day = static_cast<int>(dayNumber(expense.date));
+    entry.id = expense.id;
+    m_entries.emplace(key(fingerprint(expense), entry.day), entry);
+}
+
+void DuplicateIndex::remove(const Expense& expense)
+{
+    auto range = m_entries.equal_range(key(fingerprint(expense), dayNumber(expense.date)));
+    for (auto it = range.first; it != range.second; ++it) {
+        if (it->second.id == expense.id) {
+            m_entries.erase(it);
+            return;
+        }
+    }
+}
+
+void DuplicateIndex::clear()
+{
+    m_entries.clear();
+}
+
+void DuplicateIndex::reserve(size_t count)
+{
+    m_entries.reserve(count);
+}
+
+std::vector<int> DuplicateIndex::candidates(const Expense& expense, int windowDays, int excludeId) const
+{
+    std::vector<int> ids;
+    uint64_t hash = fingerprint(expense);
+    long day = dayNumber(expense.date);
+    
+    // The day itself, then one day either side at a time, so nearer dates come first
+    for (long distance = 0; distance <= windowDays; ++distance) {
+        for (long probe : {day - distance, day + distance}) {
+            auto range = m_entries.equal_range(key(hash, probe));
+            for (auto it = range.first; it != range.second; ++it) {
+                if (it->second.day == probe && it->second.id != excludeId) {
+                    ids.push_back(it->second.id);
+                }
+            }
+            if (distance == 0) {
+                break;
+            }
+        }
+    }
+    
+    return ids;
+}
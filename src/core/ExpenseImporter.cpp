@@ -0,0 +1,762 @@
+#include "../../include/core/ExpenseImporter.h"
+#include "../../include/core/DateUtils.h"
+#include "../../include/core/Metrics.h"
+#include <fstream>
+#include <iostream>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cctype>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+#include <unordered_map>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+// Read-only view of a whole file; memory-mapped where the platform allows it
+class MappedFile {
+public:
+    explicit MappedFile(const std::string& filePath)
+        : m_data(nullptr), m_size(0), m_mapped(false)
+    {
+#ifndef _WIN32
+        int fd = ::open(filePath.c_str(), O_RDONLY);
+        if (fd < 0) {
+            return;
+        }
+        
+        struct stat st;
+        if (::fstat(fd, &st) == 0) {
+            if (st.st_size == 0) {
+                m_data = "";  // An empty file is readable, it just has no rows
+            } else {
+                void* address = ::mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+                if (address != MAP_FAILED) {
+                    ::madvise(address, static_cast<size_t>(st.st_size), MADV_SEQUENTIAL);
+                    m_data = static_cast<const char*>(address);
+                    m_size = static_cast<size_t>(st.st_size);
+                    m_mapped = true;
+                }
+            }
+        }
+        ::close(fd);
+        
+        if (m_data) {
+            return;
+        }
+#endif
+        // Fall back to reading the file into memory
+        std::ifstream file(filePath, std::ios::binary);
+        if (!file.is_open()) {
+            return;
+        }
+        m_buffer.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+        m_data = m_buffer.data();
+        m_size = m_buffer.size();
+    }
+    
+    ~MappedFile()
+    {
+#ifndef _WIN32
+        if (m_mapped) {
+            ::munmap(const_cast<char*>(m_data), m_size);
+        }
+#endif
+    }
+    
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+    
+    bool isOpen() const { return m_data != nullptr; }
+    const char* data() const { return m_data; }
+    size_t size() const { return m_size; }
+    
+private:
+    const char* m_data;
+    size_t m_size;
+    bool m_mapped;
+    std::string m_buffer;
+};
+
+struct ParsedRow {
+    size_t line;  // Relative to the start of the chunk
+    Expense expense;
+};
+
+struct ChunkResult {
+    std::vector<ParsedRow> rows;      // Amounts as signed in the file
+    std::vector<ImportError> errors;  // Lines relative to the start of the chunk
+    size_t newlines = 0;
+    size_t rowsRead = 0;
+    size_t negativeRows = 0;
+};
+
+struct CsvColumns {
+    int date = 0;
+    int amount = 1;
+    int category = 2;
+    int description = 3;
+};
+
+std::string toLower(std::string text)
+{
+    std::transform(text.begin(), text.end(), text.begin(),
+                   [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+    return text;
+}
+
+std::string trim(const std::string& text)
+{
+    size_t begin = text.find_first_not_of(" \t\r\n");
+    if (begin == std::string::npos) {
+        return std::string();
+    }
+    size_t end = text.find_last_not_of(" \t\r\n");
+    return text.substr(begin, end - begin + 1);
+}
+
+// End of the CSV record starting at begin: the first newline outside double
+// quotes, or end. Every quote flips the state, which also covers "" escapes;
+// inQuotes is the state at begin.
+const char* findRecordEnd(const char* begin, const char* end, bool inQuotes = false)
+{
+    const char* p = begin;
+    while (p < end) {
+        const char* newline = static_cast<const char*>(std::memchr(p, '\n', end - p));
+        const char* stop = newline ? newline : end;
+        inQuotes = inQuotes != (std::count(p, stop, '"') % 2 != 0);
+        if (!inQuotes || !newline) {
+            return stop;
+        }
+        p = newline + 1;
+    }
+    return end;
+}
+
+// Splits one CSV record, honouring double-quoted fields and "" escapes. Line
+// breaks inside a quoted field, as in multi-line bank memos, become spaces.
+std::vector<std::string> splitCsvLine(const char* begin, const char* end)
+{
+    std::vector<std::string> fields;
+    std::string field;
+    bool inQuotes = false;
+    
+    for (const char* p = begin; p < end; ++p) {
+        char c = *p;
+        if (inQuotes) {
+            if (c == '"') {
+                if (p + 1 < end && p[1] == '"') {
+                    field.push_back('"');
+                    ++p;
+                } else {
+                    inQuotes = false;
+                }
+            } else if (c == '\n') {
+                field.push_back(' ');
+            } else if (c != '\r') {
+                field.push_back(c);
+            }
+        } else if (c == '"') {
+            inQuotes = true;
+        } else if (c == ',') {
+            fields.push_back(trim(field));
+            field.clear();
+        } else {
+            field.push_back(c);
+        }
+    }
+    fields.push_back(trim(field));
+    return fields;
+}
+
+bool parseAmount(const std::string& text, double& amount)
+{
+    std::string cleaned;
+    cleaned.reserve(text.size());
+    for (char c : text) {
+        if (c != '$' && c != ',' && c != ' ') {
+            cleaned.push_back(c);
+        }
+    }
+    if (cleaned.empty()) {
+        return false;
+    }
+    
+    char* end = nullptr;
+    amount = std::strtod(cleaned.c_str(), &end);
+    return end == cleaned.c_str() + cleaned.size() && std::isfinite(amount);
+}
+
+// Accepts YYYY-MM-DD, YYYY/MM/DD and the OFX YYYYMMDD[hhmmss...] form
+bool normalizeDate(const std::string& text, std::string& date)
+{
+    if (text.size() >= 10 && (text[4] == '-' || text[4] == '/') && text[7] == text[4]) {
+        date = text.substr(0, 10);
+        date[4] = '-';
+        date[7] = '-';
+    } else if (text.size() >= 8 &&
+               std::all_of(text.begin(), text.begin() + 8, [](unsigned char c) { return std::isdigit(c) != 0; })) {
+        date = text.substr(0, 4) + "-" + text.substr(4, 2) + "-" + text.substr(6, 2);
+    } else {
+        return false;
+    }
+    return DateUtils::isValidDate(date);
+}
+
+const char* findText(const char* begin, const char* end, const char* needle)
+{
+    size_t length = std::strlen(needle);
+    const char* found = std::search(begin, end, needle, needle + length);
+    return found == end ? nullptr : found;
+}
+
+// Value of an OFX SGML element, which may or may not have a closing tag
+std::string ofxValue(const char* begin, const char* end, const char* tag)
+{
+    const char* start = findText(begin, end, tag);
+    if (!start) {
+        return std::string();
+    }
+    start += std::strlen(tag);
+    
+    const char* stop = start;
+    while (stop < end && *stop != '<' && *stop != '\n' && *stop != '\r') {
+        ++stop;
+    }
+    
+    std::string value = trim(std::string(start, stop));
+    size_t pos = 0;
+    while ((pos = value.find('&', pos)) != std::string::npos) {
+        if (value.compare(pos, 5, "&amp;") == 0) {
+            value.replace(pos, 5, "&");
+        } else if (value.compare(pos, 4, "&lt;") == 0) {
+            value.replace(pos, 4, "<");
+        } else if (value.compare(pos, 4, "&gt;") == 0) {
+            value.replace(pos, 4, ">");
+        }
+        ++pos;
+    }
+    return value;
+}
+
+class CategoryResolver {
+public:
+    CategoryResolver(const std::vector<Category>& categories,
+                     const std::vector<CategoryRule>& rules,
+                     const std::string& defaultCategory)
+    {
+        for (const auto& category : categories) {
+            m_categories[toLower(category.name)] = category.name;
+        }
+        for (const auto& rule : rules) {
+            if (!rule.pattern.empty()) {
+                m_rules.push_back(CategoryRule(toLower(rule.pattern), rule.category));
+            }
+        }
+        m_defaultCategory = defaultCategory;
+    }
+    
+    // Returns false and sets error when no existing category can be assigned
+    bool resolve(const std::string& source, const std::string& description,
+                 std::string& category, std::string& error) const
+    {
+        std::string lowerSource = toLower(source);
+        auto known = m_categories.find(lowerSource);
+        if (known != m_categories.end()) {
+            category = known->second;
+            return true;
+        }
+        
+        std::string lowerDescription = toLower(description);
+        for (const auto& rule : m_rules) {
+            if ((!lowerSource.empty() && lowerSource.find(rule.pattern) != std::string::npos) ||
+                lowerDescription.find(rule.pattern) != std::string::npos) {
+                return canonical(rule.category, category, error);
+            }
+        }
+        
+        if (!m_defaultCategory.empty()) {
+            return canonical(m_defaultCategory, category, error);
+        }
+        
+        error = source.empty() ? "no category and no matching rule"
+                               : "unknown category '" + source + "'";
+        return false;
+    }
+    
+private:
+    std::unordered_map<std::string, std::string> m_categories;  // Lower-cased name -> name
+    std::vector<CategoryRule> m_rules;
+    std::string m_defaultCategory;
+    
+    bool canonical(const std::string& name, std::string& category, std::string& error) const
+    {
+        auto it = m_categories.find(toLower(name));
+        if (it == m_categories.end()) {
+            error = "rule maps to unknown category '" + name + "'";
+            return false;
+        }
+        category = it->second;
+        return true;
+    }
+};
+
+// Strict UTF-8: no overlong forms, surrogates or code points above U+10FFFF
+bool isValidUtf8(const std::string& text)
+{
+    const unsigned char* p = reinterpret_cast<const unsigned char*>(text.data());
+    const unsigned char* end = p + text.size();
+    while (p < end) {
+        unsigned char c = *p++;
+        if (c < 0x80) {
+            continue;
+        }
+        
+        int continuation;
+        unsigned int codePoint;
+        if (c >= 0xc2 && c <= 0xdf) {
+            continuation = 1;
+            codePoint = c & 0x1f;
+        } else if (c >= 0xe0 && c <= 0xef) {
+            continuation = 2;
+            codePoint = c & 0x0f;
+        } else if (c >= 0xf0 && c <= 0xf4) {
+            continuation = 3;
+            codePoint = c & 0x07;
+        } else {
+            return false;
+        }
+        if (end - p < continuation) {
+            return false;
+        }
+        for (int i = 0; i < continuation; ++i, ++p) {
+            if ((*p & 0xc0) != 0x80) {
+                return false;
+            }
+            codePoint = (codePoint << 6) | (*p & 0x3f);
+        }
+        if ((continuation == 2 && (codePoint < 0x800 || (codePoint >= 0xd800 && codePoint <= 0xdfff))) ||
+            (continuation == 3 && (codePoint < 0x10000 || codePoint > 0x10ffff))) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void validateRow(const std::string& dateText, const std::string& amountText,
+                 const std::string& sourceCategory, const std::string& description,
+                 size_t line, const CategoryResolver& resolver, ChunkResult& result)
+{
+    ++result.rowsRead;
+    
+    Expense expense;
+    if (!normalizeDate(dateText, expense.date)) {
+        result.errors.push_back(ImportError(line, "invalid date '" + dateText + "'"));
+        return;
+    }
+    
+    if (!parseAmount(amountText, expense.amount)) {
+        result.errors.push_back(ImportError(line, "invalid amount '" + amountText + "'"));
+        return;
+    }
+    if (expense.amount == 0.0) {
+        result.errors.push_back(ImportError(line, "amount must not be zero"));
+        return;
+    }
+    
+    // The ledger is stored as JSON, which must be UTF-8; a Latin-1 export would
+    // otherwise import fine and then fail to save
+    if (!isValidUtf8(description)) {
+        result.errors.push_back(ImportError(line, "description is not valid UTF-8; convert the file to UTF-8"));
+        return;
+    }
+    
+    std::string error;
+    if (!resolver.resolve(sourceCategory, description, expense.category, error)) {
+        result.errors.push_back(ImportError(line, error));
+        return;
+    }
+    
+    expense.description = description;
+    result.rows.push_back({line, expense});
+    result.negativeRows += expense.amount < 0.0 ? 1 : 0;
+}
+
+void parseCsvChunk(const char* begin, const char* end, const CsvColumns& columns,
+                   const CategoryResolver& resolver, ChunkResult& result)
+{
+    size_t nextLine = 1;
+    const char* lineStart = begin;
+    
+    while (lineStart < end) {
+        // A record spans several lines when a quoted field has line breaks;
+        // errors are reported on its first line
+        const char* lineEnd = findRecordEnd(lineStart, end);
+        size_t line = nextLine;
+        size_t newlines = std::count(lineStart, lineEnd, '\n') + (lineEnd < end ? 1 : 0);
+        result.newlines += newlines;
+        nextLine += newlines;
+        
+        const char* contentEnd = lineEnd;
+        if (contentEnd > lineStart && contentEnd[-1] == '\r') {
+            --contentEnd;
+        }
+        
+        if (contentEnd > lineStart) {
+            std::vector<std::string> fields = splitCsvLine(lineStart, contentEnd);
+            auto field = [&fields](int index) {
+                return index >= 0 && index < static_cast<int>(fields.size()) ? fields[index] : std::string();
+            };
+            
+            if (fields.size() == 1 && fields[0].empty()) {
+                // Whitespace-only line
+            } else {
+                validateRow(field(columns.date), field(columns.amount),
+                            field(columns.category), field(columns.description),
+                            line, resolver, result);
+            }
+        }
+        
+        lineStart = lineEnd + 1;
+    }
+}
+
+void parseOfxChunk(const char* begin, const char* end, const CategoryResolver& resolver, ChunkResult& result)
+{
+    static const char* openTag = "<STMTTRN>";
+    static const char* closeTag = "</STMTTRN>";
+    
+    size_t line = 1;
+    const char* counted = begin;
+    const char* cursor = begin;
+    
+    while (const char* blockStart = findText(cursor, end, openTag)) {
+        line += std::count(counted, blockStart, '\n');
+        counted = blockStart;
+        
+        const char* bodyStart = blockStart + std::strlen(openTag);
+        const char* blockEnd = findText(bodyStart, end, closeTag);
+        const char* nextBlock = findText(bodyStart, end, openTag);
+        if (!blockEnd || (nextBlock && nextBlock < blockEnd)) {
+            blockEnd = nextBlock ? nextBlock : end;
+        }
+        
+        std::string name = ofxValue(bodyStart, blockEnd, "<NAME>");
+        std::string memo = ofxValue(bodyStart, blockEnd, "<MEMO>");
+        std::string description = name.empty() ? memo : name;
+        
+        validateRow(ofxValue(bodyStart, blockEnd, "<DTPOSTED>"), ofxValue(bodyStart, blockEnd, "<TRNAMT>"),
+                    std::string(), description, line, resolver, result);
+        
+        cursor = blockEnd;
+    }
+    
+    result.newlines = std::count(begin, end, '\n');
+}
+
+// SGML OFX starts with its OFXHEADER block and XML OFX with an <?OFX
+// instruction after the XML declaration. Mentioning OFX elsewhere, say in a
+// CSV description, does not count.
+bool looksLikeOfx(const char* data, size_t size)
+{
+    size_t start = size >= 3 && std::memcmp(data, "\xef\xbb\xbf", 3) == 0 ? 3 : 0;
+    while (start < size && std::isspace(static_cast<unsigned char>(data[start]))) {
+        ++start;
+    }
+    auto startsWith = [&](const char* prefix) {
+        size_t length = std::strlen(prefix);
+        return size - start >= length && std::memcmp(data + start, prefix, length) == 0;
+    };
+    if (startsWith("OFXHEADER:") || startsWith("<OFX>")) {
+        return true;
+    }
+    return startsWith("<?xml") && findText(data + start, data + std::min<size_t>(size, 4096), "<?OFX");
+}
+
+// Returns the offset just past the CSV header, filling columns from it, or 0 if there is none
+size_t parseCsvHeader(const char* data, size_t size, CsvColumns& columns)
+{
+    const char* end = findRecordEnd(data, data + size);
+    const char* lineEnd = end < data + size ? end : nullptr;
+    std::vector<std::string> fields = splitCsvLine(data, end);
+    
+    CsvColumns header;
+    header.date = header.amount = header.category = header.description = -1;
+    for (size_t i = 0; i < fields.size(); ++i) {
+        std::string name = toLower(fields[i]);
+        int index = static_cast<int>(i);
+        if (name == "date" || name == "posted date" || name == "transaction date") {
+            header.date = index;
+        } else if (name == "amount") {
+            header.amount = index;
+        } else if (name == "category") {
+            header.category = index;
+        } else if (name == "description" || name == "memo" || name == "payee" || name == "name") {
+            if (header.description < 0) {
+                header.description = index;
+            }
+        }
+    }
+    
+    if (header.date < 0 || header.amount < 0) {
+        return 0;
+    }
+    columns = header;
+    return lineEnd ? static_cast<size_t>(lineEnd - data) + 1 : size;
+}
+
+// Byte ranges ending on record boundaries, roughly chunkSize bytes each
+std::vector<std::pair<size_t, size_t>> splitChunks(const char* data, size_t start, size_t size,
+                                                   size_t chunkSize, ImportFormat format)
+{
+    std::vector<std::pair<size_t, size_t>> chunks;
+    
+    while (start < size) {
+        size_t target = std::min(size, start + chunkSize);
+        size_t boundary = size;
+        
+        if (target < size) {
+            if (format == ImportFormat::Ofx) {
+                const char* next = findText(data + target, data + size, "<STMTTRN>");
+                boundary = next ? static_cast<size_t>(next - data) : size;
+            } else {
+                // start is a record boundary, so the quotes before target say
+                // whether target is inside a quoted field
+                bool inQuotes = std::count(data + start, data + target, '"') % 2 != 0;
+                const char* recordEnd = findRecordEnd(data + target, data + size, inQuotes);
+                boundary = recordEnd < data + size ? static_cast<size_t>(recordEnd - data) + 1 : size;
+            }
+        }
+        
+        chunks.push_back(std::make_pair(start, boundary));
+        start = boundary;
+    }
+    
+    return chunks;
+}
+
+double secondsSince(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+} // namespace
+
+double ImportResult::rowsPerSecond() const
+{
+    double seconds = parseSeconds + commitSeconds;
+    return seconds > 0.0 ? static_cast<double>(rowsRead) / seconds : 0.0;
+}
+
+double ImportResult::megabytesPerSecond() const
+{
+    return parseSeconds > 0.0 ? static_cast<double>(bytesRead) / (1024.0 * 1024.0) / parseSeconds : 0.0;
+}
+
+ExpenseImporter::ExpenseImporter(ExpenseManager* manager)
+    : m_manager(manager), m_amountSign(AmountSign::Auto), m_threadCount(0), m_chunkSize(1 << 20)
+{
+}
+
+void ExpenseImporter::addCategoryRule(const CategoryRule& rule)
+{
+    m_rules.push_back(rule);
+}
+
+void ExpenseImporter::setCategoryRules(const std::vector<CategoryRule>& rules)
+{
+    m_rules = rules;
+}
+
+bool ExpenseImporter::loadCategoryRules(const std::string& rulesFilePath)
+{
+    try {
+        std::ifstream file(rulesFilePath);
+        if (!file.is_open()) {
+            return false;
+        }
+        
+        json j;
+        file >> j;
+        
+        std::vector<CategoryRule> rules;
+        for (const auto& ruleJson : j["rules"]) {
+            rules.push_back(CategoryRule(ruleJson["pattern"].get<std::string>(),
+                                         ruleJson["category"].get<std::string>()));
+        }
+        m_rules = rules;
+        
+        if (j.contains("defaultCategory")) {
+            m_defaultCategory = j["defaultCategory"].get<std::string>();
+        }
+        return true;
+    } catch (const std::exception& e) {
+        std::cerr << "Error loading import rules: " << e.what() << std::endl;
+        return false;
+    }
+}
+
+void ExpenseImporter::setDefaultCategory(const std::string& category)
+{
+    m_defaultCategory = category;
+}
+
+void ExpenseImporter::setAmountSign(AmountSign sign)
+{
+    m_amountSign = sign;
+}
+
+void ExpenseImporter::setThreadCount(unsigned int threadCount)
+{
+    m_threadCount = threadCount;
+}
+
+void ExpenseImporter::setChunkSize(size_t bytes)
+{
+    m_chunkSize = std::max<size_t>(bytes, 4096);
+}
+
+ImportResult ExpenseImporter::importFile(const std::string& filePath, ImportFormat format)
+{
+    if (format == ImportFormat::Auto) {
+        std::string extension = toLower(fs::path(filePath).extension().string());
+        if (extension == ".ofx" || extension == ".qfx") {
+            format = ImportFormat::Ofx;
+        } else if (extension == ".csv") {
+            format = ImportFormat::Csv;
+        }
+    }
+    
+    auto start = std::chrono::steady_clock::now();
+    MappedFile file(filePath);
+    if (!file.isOpen()) {
+        ImportResult result;
+        result.errors.push_back(ImportError(0, "cannot open " + filePath));
+        return result;
+    }
+    
+    ImportResult result = importBuffer(file.data(), file.size(), format);
+    result.parseSeconds = secondsSince(start) - result.commitSeconds;  // Include the mapping time
+    return result;
+}
+
+ImportResult ExpenseImporter::importBuffer(const char* data, size_t size, ImportFormat format)
+{
+    PFM_SCOPED_TIMER("ExpenseImporter::importBuffer");
+    ImportResult result;
+    result.bytesRead = size;
+    auto start = std::chrono::steady_clock::now();
+    
+    if (format == ImportFormat::Auto) {
+        format = looksLikeOfx(data, size) ? ImportFormat::Ofx : ImportFormat::Csv;
+    }
+    
+    CsvColumns columns;
+    size_t dataStart = 0;
+    if (format == ImportFormat::Csv) {
+        dataStart = parseCsvHeader(data, size, columns);
+    }
+    size_t headerLines = std::count(data, data + dataStart, '\n');
+    
+    CategoryResolver resolver(m_manager->getAllCategories(), m_rules, m_defaultCategory);
+    std::vector<std::pair<size_t, size_t>> chunks = splitChunks(data, dataStart, size, m_chunkSize, format);
+    std::vector<ChunkResult> chunkResults(chunks.size());
+    
+    // Workers pull chunks from a shared counter so uneven chunks balance out
+    std::atomic<size_t> nextChunk(0);
+    auto worker = [&]() {
+        for (size_t i = nextChunk++; i < chunks.size(); i = nextChunk++) {
+            const char* begin = data + chunks[i].first;
+            const char* end = data + chunks[i].second;
+            if (format == ImportFormat::Ofx) {
+                parseOfxChunk(begin, end, resolver, chunkResults[i]);
+            } else {
+                parseCsvChunk(begin, end, columns, resolver, chunkResults[i]);
+            }
+        }
+    };
+    
+    // On the ledger's pool when it has one, so imports into several ledgers
+    // do not each start threads of their own
+    ThreadPool* pool = m_manager->threadPool();
+    unsigned int threadCount = m_threadCount;
+    if (threadCount == 0) {
+        threadCount = pool ? pool->threadCount() : std::max(1u, std::thread::hardware_concurrency());
+    }
+    threadCount = static_cast<unsigned int>(std::min<size_t>(threadCount, chunks.size()));
+    if (pool) {
+        pool->run(threadCount, [&worker](unsigned int) { worker(); });
+    } else {
+        std::vector<std::thread> threads;
+        for (unsigned int i = 1; i < threadCount; ++i) {
+            threads.emplace_back(worker);
+        }
+        worker();
+        for (auto& thread : threads) {
+            thread.join();
+        }
+    }
+    
+    // The sign convention needs every row, so it is applied once the chunks are done
+    AmountSign sign = format == ImportFormat::Ofx ? AmountSign::Negative : m_amountSign;
+    if (sign == AmountSign::Auto) {
+        size_t rows = 0;
+        size_t negativeRows = 0;
+        for (const auto& chunk : chunkResults) {
+            rows += chunk.rows.size();
+            negativeRows += chunk.negativeRows;
+        }
+        sign = negativeRows * 2 > rows ? AmountSign::Negative : AmountSign::Positive;
+    }
+    
+    // Stitch chunk-relative line numbers back into file line numbers
+    std::vector<Expense> expenses;
+    size_t lineOffset = headerLines;
+    for (const auto& chunk : chunkResults) {
+        result.rowsRead += chunk.rowsRead;
+        for (const auto& row : chunk.rows) {
+            Expense expense = row.expense;
+            if (sign == AmountSign::Negative) {
+                expense.amount = -expense.amount;
+            }
+            if (expense.amount < 0.0) {
+                result.errors.push_back(ImportError(lineOffset + row.line,
+                                                    sign == AmountSign::Negative
+                                                        ? "credit, not an expense; expenses here are negative"
+                                                        : "negative amount; expenses here are positive"));
+                continue;
+            }
+            expenses.push_back(expense);
+        }
+        for (const auto& error : chunk.errors) {
+            result.errors.push_back(ImportError(lineOffset + error.line, error.message));
+        }
+        lineOffset += chunk.newlines;
+    }
+    std::stable_sort(result.errors.begin(), result.errors.end(),
+                     [](const ImportError& a, const ImportError& b) { return a.line < b.line; });
+    result.parseSeconds = secondsSince(start);
+    PFM_COUNTER_ADD("import.bytes_read", size);
+    PFM_COUNTER_ADD("import.rows_read", result.rowsRead);
+    
+    auto commitStart = std::chrono::steady_clock::now();
+    // Rows already in the ledger, say from an overlapping statement, are
+    // flagged or skipped by the manager's duplicate policy
+    std::vector<DuplicateMatch> duplicates;
+    bool rejectDuplicates = m_manager->getDuplicatePolicy() == DuplicatePolicy::Reject;
+    result.success = m_manager->addExpenses(expenses, &duplicates);
+    result.duplicateRows = duplicates.size();
+    result.rowsImported = result.success ? expenses.size() - (rejectDuplicates ? duplicates.size() : 0) : 0;
+    result.commitSeconds = secondsSince(commitStart);
+    
+    return result;
+}
@@ -1,13 +1,315 @@
 #include "../../include/core/ExpenseManager.h"
+#include "../../include/core/DateUtils.h"
+#include "../../include/core/Crc32c.h"
+#include "../../include/core/FileUtils.h"
+#include "../../include/core/Metrics.h"
 #include <fstream>
 #include <iostream>
 #include <algorithm>
 #include <chrono>
-#include <iomanip>
+#include <iterator>
+#include <limits>
+#include <mutex>
+#include <shared_mutex>
 #include <sstream>
+#include <thread>
+#include <unordered_set>
+
+namespace {
+
+// Rough in-memory cost of one expense: the struct, its strings, the id map
+// entry, its search postings and its fingerprint. Only used to enforce the
+// memory budget.
+const size_t kApproxExpenseBytes = 296;
+const size_t kDefaultMemoryBudget = 256 * 1024 * 1024;
+const int kFirstYear = std::numeric_limits<int>::min() / 100;
+const int kLastYear = std::numeric_limits<int>::max() / 100 - 1;
+const long kProjectionHorizonDays = 366;  // How far open-ended ranges project recurring rules
+const int kMaxDuplicateWindow = 31;
+const size_t kDefaultUndoDepth = 100;
+const size_t kMaxUndoBytes = 32 * 1024 * 1024;  // Of rows held by the undo and redo logs
+
+bool lessById(const Expense& expense, int id)
+{
+    return expense.id < id;
+}
+
+int yearOfKey(int monthKey)
+{
+    return monthKey / 100;
+}
+
+int firstKeyOfYear(int year)
+{
+    return year * 100;
+}
+
+int lastKeyOfYear(int year)
+{
+    return year * 100 + 99;
+}
+
+int yearOfDate(const std::string& date, int fallback)
+{
+    int year, month, day;
+    return DateUtils::parseDate(date, year, month, day) ? year : fallback;
+}
+
+json expenseToJson(const Expense& expense)
+{
+    return {
+        {"id", expense.id},
+        {"amount", expense.amount},
+        {"description", expense.description},
+        {"category", expense.category},
+        {"date", expense.date}
+    };
+}
+
+Expense expenseFromJson(const json& expenseJson)
+{
+    Expense expense;
+    expense.id = expenseJson["id"].get<int>();
+    expense.amount = expenseJson["amount"].get<double>();
+    expense.description = expenseJson["description"].get<std::string>();
+    expense.category = expenseJson["category"].get<std::string>();
+    expense.date = expenseJson["date"].get<std::string>();
+    return expense;
+}
+
+json budgetToJson(const Budget& budget)
+{
+    return {
+        {"category", budget.category},
+        {"period", budget.period == BudgetPeriod::Yearly ? "yearly" : "monthly"},
+        {"limit", budget.limit},
+        {"thresholds", budget.thresholds}
+    };
+}
+
+Budget budgetFromJson(const json& budgetJson)
+{
+    Budget budget;
+    budget.category = budgetJson["category"].get<std::string>();
+    budget.period = budgetJson["period"].get<std::string>() == "yearly" ? BudgetPeriod::Yearly
+                                                                         : BudgetPeriod::Monthly;
+    budget.limit = budgetJson["limit"].get<double>();
+    budget.thresholds = budgetJson["thresholds"].get<std::vector<double>>();
+    return budget;
+}
+
+const char* partitionExtension(StorageFormat format)
+{
+    return format == StorageFormat::Compact ? ".pfmc" : ".json";
+}
+
+const char* duplicatePolicyName(DuplicatePolicy policy)
+{
+    return policy == DuplicatePolicy::Allow ? "allow" : policy == DuplicatePolicy::Reject ? "reject" : "flag";
+}
+
+// Runs work(0) .. work(count - 1) on their own threads, the last on the caller's
+template <typename Work>
+void runOnThreads(unsigned int count, Work work)
+{
+    std::vector<std::thread> threads;
+    for (unsigned int i = 0; i + 1 < count; ++i) {
+        threads.emplace_back(work, i);
+    }
+    work(count - 1);
+    for (auto& thread : threads) {
+        thread.join();
+    }
+}
+
+json recurringRuleToJson(const RecurringRule& rule)
+{
+    const char* frequency = rule.frequency == RecurrenceFrequency::Weekly ? "weekly"
+                          : rule.frequency == RecurrenceFrequency::Custom ? "custom" : "monthly";
+    return {
+        {"id", rule.id},
+        {"amount", rule.amount},
+        {"description", rule.description},
+        {"category", rule.category},
+        {"frequency", frequency},
+        {"interval", rule.interval},
+        {"startDate", rule.startDate},
+        {"endDate", rule.endDate},
+        {"materializedThrough", rule.materializedThrough}
+    };
+}
+
+RecurringRule recurringRuleFromJson(const json& ruleJson)
+{
+    RecurringRule rule;
+    rule.id = ruleJson["id"].get<int>();
+    rule.amount = ruleJson["amount"].get<double>();
+    rule.description = ruleJson["description"].get<std::string>();
+    rule.category = ruleJson["category"].get<std::string>();
+    std::string frequency = ruleJson["frequency"].get<std::string>();
+    rule.frequency = frequency == "weekly" ? RecurrenceFrequency::Weekly
+                   : frequency == "custom" ? RecurrenceFrequency::Custom : RecurrenceFrequency::Monthly;
+    rule.interval = ruleJson["interval"].get<int>();
+    rule.startDate = ruleJson["startDate"].get<std::string>();
+    rule.endDate = ruleJson["endDate"].get<std::string>();
+    rule.materializedThrough = ruleJson["materializedThrough"].get<std::string>();
+    return rule;
+}
+
+bool readFile(const std::string& path, std::string& bytes)
+{
+    std::ifstream file(path, std::ios::binary);
+    if (!file.is_open()) {
+        return false;
+    }
+    bytes.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    return !file.bad();
+}
+
+// Every row that can still be read. Compact files keep their intact blocks;
+// JSON files that no longer parse as a whole are scanned for expense objects,
+// which are flat, so each innermost {...} is tried on its own.
+std::vector<Expense> salvageRows(const std::string& bytes, bool compact)
+{
+    std::vector<Expense> expenses;
+    if (compact) {
+        return PartitionCodec::salvage(bytes);
+    }
+    
+    try {
+        json j = json::parse(bytes);
+        for (const auto& expenseJson : j.at("expenses")) {
+            expenses.push_back(expenseFromJson(expenseJson));
+        }
+        return expenses;
+    } catch (const std::exception&) {
+        expenses.clear();
+    }
+    
+    size_t start = std::string::npos;
+    bool inString = false;
+    bool escaped = false;
+    for (size_t i = 0; i < bytes.size(); ++i) {
+        char c = bytes[i];
+        if (c == '\n') {
+            inString = false;  // JSON strings cannot span lines; resync after damage
+        } else if (inString) {
+            if (escaped) {
+                escaped = false;
+            } else if (c == '\\') {
+                escaped = true;
+            } else if (c == '"') {
+                inString = false;
+            }
+        } else if (c == '"') {
+            inString = true;
+        } else if (c == '{') {
+            start = i;
+        } else if (c == '}' && start != std::string::npos) {
+            try {
+                expenses.push_back(expenseFromJson(json::parse(bytes.begin() + start, bytes.begin() + i + 1)));
+            } catch (const std::exception&) {
+                // Damaged row; skip it
+            }
+            start = std::string::npos;
+        }
+    }
+    return expenses;
+}
+
+struct PartitionFile {
+    int year;
+    uint64_t generation;  // 0 for files named before generations
+    std::string name;
+};
+
+bool isNumber(const std::string& text, bool allowSign, size_t maxDigits)
+{
+    size_t start = allowSign && text.compare(0, 1, "-") == 0 ? 1 : 0;
+    return text.size() > start && text.size() - start <= maxDigits &&
+           text.find_first_not_of("0123456789", start) == std::string::npos;
+}
+
+// Every partition file next to the manifest: STEM.YEAR[.GENERATION].EXT
+std::vector<PartitionFile> listPartitionFiles(const std::string& dataFilePath)
+{
+    std::vector<PartitionFile> files;
+    fs::path directory = fs::path(dataFilePath).parent_path();
+    std::string prefix = fs::path(dataFilePath).stem().string() + ".";
+    std::error_code error;
+    fs::directory_iterator it(directory.empty() ? fs::path(".") : directory, error);
+    for (; !error && it != fs::directory_iterator(); it.increment(error)) {
+        fs::path path = it->path();
+        std::string extension = path.extension().string();
+        std::string stem = path.stem().string();
+        if ((extension != ".json" && extension != ".pfmc") || stem.compare(0, prefix.size(), prefix) != 0) {
+            continue;
+        }
+        std::string yearText = stem.substr(prefix.size());
+        std::string generationText;
+        size_t dot = yearText.find('.');
+        if (dot != std::string::npos) {
+            generationText = yearText.substr(dot + 1);
+            yearText.resize(dot);
+            if (!isNumber(generationText, false, 18)) {
+                continue;
+            }
+        }
+        if (!isNumber(yearText, true, 8)) {
+            continue;
+        }
+        files.push_back({std::stoi(yearText), generationText.empty() ? 0 : std::stoull(generationText),
+                         path.filename().string()});
+    }
+    return files;
+}
+
+// Partition files by year, for when the manifest that lists them is unreadable.
+// Where a year has several, the latest generation wins, then the newer file.
+std::map<int, std::string> findPartitionFiles(const std::string& dataFilePath)
+{
+    std::map<int, PartitionFile> newest;
+    fs::path directory = fs::path(dataFilePath).parent_path();
+    for (const auto& file : listPartitionFiles(dataFilePath)) {
+        auto existing = newest.find(file.year);
+        if (existing != newest.end()) {
+            std::error_code timeError;
+            bool older = file.generation != existing->second.generation
+                             ? file.generation < existing->second.generation
+                             : fs::last_write_time(directory / existing->second.name, timeError) >=
+                                   fs::last_write_time(directory / file.name, timeError);
+            if (older) {
+                continue;
+            }
+        }
+        newest[file.year] = file;
+    }
+    
+    std::map<int, std::string> files;
+    for (const auto& entry : newest) {
+        files[entry.first] = entry.second.name;
+    }
+    return files;
+}
+
+// Keeps a copy of a damaged file before anything overwrites it
+bool backupFile(const std::string& path, std::string& backupPath)
+{
+    backupPath = path + ".damaged";
+    std::error_code error;
+    fs::copy_file(path, backupPath, fs::copy_options::overwrite_existing, error);
+    return !error;
+}
+
+} // namespace
 
 ExpenseManager::ExpenseManager(const std::string& dataFilePath)
-    : m_dataFilePath(dataFilePath), m_nextExpenseId(1)
+    : m_dataFilePath(dataFilePath), m_snapshotGeneration(0), m_ownedGeneration(0), m_ownsCategories(true),
+      m_categories(std::make_shared<std::vector<Category>>()),
+      m_duplicatePolicy(DuplicatePolicy::Flag), m_duplicateWindow(0), m_storageFormat(StorageFormat::Json),
+      m_readOnly(false), m_nextExpenseId(1), m_nextRuleId(1), m_memoryBudget(kDefaultMemoryBudget), m_reportedBytes(0),
+      m_saveGeneration(0), m_threadPool(nullptr), m_accessClock(0),
+      m_undoDepth(kDefaultUndoDepth)
 {
     // Create directories if they don't exist
     fs::path filePath(dataFilePath);
@@ -15,168 +317,1913 @@ ExpenseManager::ExpenseManager(const std::string& dataFilePath)
         fs::create_directories(filePath.parent_path());
     }
     
-    if (fs::exists(filePath)) {
-        loadData();
+    if (fs::exists(filePath)) {
+        loadDataLocked();
+        
+        // Catch up on recurring expenses that fell due while the app was closed;
+        // no alert callback can be registered yet
+        std::vector<BudgetAlert> alerts;
+        size_t added;
+        if (materializeRecurringLocked(DateUtils::today(), added, alerts)) {
+            saveDataLocked();
+        }
+    } else {
+        initializeDefaultCategories();
+        saveDataLocked();
+    }
+}
+
+ExpenseManager::~ExpenseManager()
+{
+    saveData();
+    if (m_sharedBudget) {
+        m_sharedBudget->update(m_reportedBytes, 0);
+    }
+}
+
+void ExpenseManager::initializeDefaultCategories()
+{
+    std::vector<Category>& categories = mutableCategories();
+    categories.push_back(Category("Food", "Groceries, restaurants, etc."));
+    categories.push_back(Category("Housing", "Rent, mortgage, repairs"));
+    categories.push_back(Category("Transportation", "Public transit, car expenses"));
+    categories.push_back(Category("Utilities", "Electricity, water, internet"));
+    categories.push_back(Category("Entertainment", "Movies, games, hobbies"));
+    categories.push_back(Category("Health", "Medical expenses, insurance"));
+    categories.push_back(Category("Personal", "Clothing, grooming"));
+    categories.push_back(Category("Education", "Books, courses, tuition"));
+    categories.push_back(Category("Miscellaneous", "Other expenses"));
+}
+
+int ExpenseManager::getNextExpenseId()
+{
+    return m_nextExpenseId++;
+}
+
+template <typename Work>
+void ExpenseManager::runParallel(unsigned int count, Work work) const
+{
+    ThreadPool* pool = m_threadPool;
+    if (pool) {
+        pool->run(count, work);
+    } else {
+        runOnThreads(count, work);
+    }
+}
+
+unsigned int ExpenseManager::parallelism() const
+{
+    ThreadPool* pool = m_threadPool;
+    return pool ? pool->threadCount() : std::max(1u, std::thread::hardware_concurrency());
+}
+
+void ExpenseManager::claimOwnershipLocked()
+{
+    uint64_t generation = m_snapshotGeneration;
+    if (generation != m_ownedGeneration) {
+        m_ownedChunks.clear();
+        m_ownsCategories = false;
+        m_ownedGeneration = generation;
+    }
+}
+
+ExpenseChunk& ExpenseManager::mutableChunk(int monthKey)
+{
+    claimOwnershipLocked();
+    std::shared_ptr<ExpenseChunk>& chunk = m_chunks[monthKey];
+    if (!chunk) {
+        chunk = std::make_shared<ExpenseChunk>();
+    } else if (m_ownedChunks.count(monthKey) == 0) {
+        // A snapshot may still reference this month; give the live ledger its own copy
+        chunk = std::make_shared<ExpenseChunk>(*chunk);
+    }
+    m_ownedChunks.insert(monthKey);
+    return *chunk;
+}
+
+std::vector<Category>& ExpenseManager::mutableCategories()
+{
+    claimOwnershipLocked();
+    if (!m_ownsCategories) {
+        m_categories = std::make_shared<std::vector<Category>>(*m_categories);
+        m_ownsCategories = true;
+    }
+    return *m_categories;
+}
+
+void ExpenseManager::adjustTotalsLocked(int monthKey, const Expense& expense, int direction)
+{
+    std::map<std::string, CategoryTotal>& totals = m_monthTotals[monthKey];
+    CategoryTotal& total = totals[expense.category];
+    total.amount += direction * expense.amount;
+    total.count += direction;
+    
+    // Drop emptied entries so rounding residue never shows up as spending
+    if (total.count <= 0) {
+        totals.erase(expense.category);
+        if (totals.empty()) {
+            m_monthTotals.erase(monthKey);
+        }
+    }
+}
+
+void ExpenseManager::indexExpenseLocked(const Expense& expense)
+{
+    int monthKey = DateUtils::monthKey(expense.date);
+    ExpenseChunk& chunk = mutableChunk(monthKey);
+    
+    // New ids are the largest, so this is an append except when restoring or moving
+    if (chunk.empty() || chunk.back().id < expense.id) {
+        chunk.push_back(expense);
+    } else {
+        chunk.insert(std::lower_bound(chunk.begin(), chunk.end(), expense.id, lessById), expense);
+    }
+    m_expenseMonths[expense.id] = monthKey;
+    m_searchIndex.add(expense.id, expense.description);
+    m_duplicateIndex.add(expense);
+    adjustTotalsLocked(monthKey, expense, 1);
+}
+
+void ExpenseManager::bulkIndexLocked(const std::vector<Expense>& expenses)
+{
+    std::vector<int> touchedKeys;
+    m_duplicateIndex.reserve(m_expenseMonths.size() + expenses.size());
+    for (const auto& expense : expenses) {
+        int monthKey = DateUtils::monthKey(expense.date);
+        ExpenseChunk& chunk = mutableChunk(monthKey);
+        if (chunk.empty()) {
+            touchedKeys.push_back(monthKey);
+        }
+        chunk.push_back(expense);
+        m_expenseMonths[expense.id] = monthKey;
+        m_duplicateIndex.add(expense);
+        adjustTotalsLocked(monthKey, expense, 1);
+    }
+    
+    // Sort once per chunk and feed the search index one posting list at a time
+    std::vector<std::pair<int, const std::string*>> documents;
+    documents.reserve(expenses.size());
+    for (int monthKey : touchedKeys) {
+        ExpenseChunk& chunk = *m_chunks[monthKey];
+        std::sort(chunk.begin(), chunk.end(), [](const Expense& a, const Expense& b) { return a.id < b.id; });
+        for (const auto& expense : chunk) {
+            documents.push_back(std::make_pair(expense.id, &expense.description));
+        }
+    }
+    m_searchIndex.addAll(documents);
+}
+
+void ExpenseManager::insertExpenseLocked(const Expense& expense)
+{
+    YearPartition& partition = partitionLocked(yearOfKey(DateUtils::monthKey(expense.date)));
+    indexExpenseLocked(expense);
+    partition.noteId(expense.id);
+    ++partition.expenseCount;
+    partition.dirty = true;
+}
+
+bool ExpenseManager::removeExpenseLocked(int id, Expense* removed)
+{
+    auto month = m_expenseMonths.find(id);
+    if (month == m_expenseMonths.end()) {
+        return false;
+    }
+    
+    int monthKey = month->second;
+    ExpenseChunk& chunk = mutableChunk(monthKey);
+    auto it = std::lower_bound(chunk.begin(), chunk.end(), id, lessById);
+    if (removed) {
+        *removed = *it;
+    }
+    m_searchIndex.remove(id, it->description);
+    m_duplicateIndex.remove(*it);
+    adjustTotalsLocked(monthKey, *it, -1);
+    chunk.erase(it);
+    
+    if (chunk.empty()) {
+        m_chunks.erase(monthKey);
+    }
+    m_expenseMonths.erase(month);
+    
+    YearPartition& partition = partitionLocked(yearOfKey(monthKey));
+    --partition.expenseCount;
+    partition.dirty = true;
+    return true;
+}
+
+const Expense* ExpenseManager::findExpenseLocked(int id) const
+{
+    auto month = m_expenseMonths.find(id);
+    if (month == m_expenseMonths.end()) {
+        return nullptr;
+    }
+    
+    const ExpenseChunk& chunk = *m_chunks.at(month->second);
+    auto it = std::lower_bound(chunk.begin(), chunk.end(), id, lessById);
+    return &*it;
+}
+
+template <typename Reader>
+auto ExpenseManager::readYears(int fromYear, int toYear, Reader reader) const -> decltype(reader())
+{
+    {
+        std::shared_lock<SharedMutex> lock(m_mutex);
+        if (yearsLoadedLocked(fromYear, toYear)) {
+            return reader();
+        }
+    }
+    
+    // Loading a cold partition changes what is cached, not the ledger's contents
+    std::unique_lock<SharedMutex> lock(m_mutex);
+    PFM_COUNTER_ADD("storage.cold_reads", 1);
+    ExpenseManager* self = const_cast<ExpenseManager*>(this);
+    self->loadYearsLocked(fromYear, toYear);
+    auto result = reader();
+    self->evictColdPartitionsLocked();
+    return result;
+}
+
+bool ExpenseManager::yearsLoadedLocked(int fromYear, int toYear) const
+{
+    bool loaded = true;
+    uint64_t now = ++m_accessClock;
+    
+    for (auto it = m_partitions.lower_bound(fromYear); it != m_partitions.end() && it->first <= toYear; ++it) {
+        it->second.lastUsed = now;
+        if (!it->second.loaded && !it->second.failed) {
+            loaded = false;
+        }
+    }
+    
+    return loaded;
+}
+
+bool ExpenseManager::loadYearsLocked(int fromYear, int toYear)
+{
+    bool success = true;
+    for (auto it = m_partitions.lower_bound(fromYear); it != m_partitions.end() && it->first <= toYear; ++it) {
+        success = loadYearLocked(it->first) && success;
+    }
+    return success;
+}
+
+bool ExpenseManager::loadYearLocked(int year)
+{
+    auto it = m_partitions.find(year);
+    if (it == m_partitions.end()) {
+        return true;  // Nothing recorded for this year yet
+    }
+    
+    YearPartition& partition = it->second;
+    partition.lastUsed = ++m_accessClock;
+    if (partition.loaded) {
+        return true;
+    }
+    if (partition.failed) {
+        return false;
+    }
+    
+    try {
+        PFM_SCOPED_TIMER("ExpenseManager::loadPartition");
+        std::string bytes;
+        if (!readFile(partitionPath(partition.fileName), bytes)) {
+            throw std::runtime_error("cannot open " + partition.fileName);
+        }
+        
+        // The file says which format it is in, whatever the current setting
+        std::vector<Expense> expenses;
+        if (PartitionCodec::isCompact(bytes)) {
+            expenses = PartitionCodec::decode(bytes);
+        } else {
+            if (partition.hasChecksum && Crc32c::compute(bytes.data(), bytes.size()) != partition.checksum) {
+                throw std::runtime_error("checksum mismatch");
+            }
+            json j = json::parse(bytes);
+            expenses.reserve(j["expenses"].size());
+            for (const auto& expenseJson : j["expenses"]) {
+                expenses.push_back(expenseFromJson(expenseJson));
+            }
+        }
+        PFM_COUNTER_ADD("storage.bytes_read", bytes.size());
+        
+        // Recount the year from its rows; the manifest totals may be stale
+        m_monthTotals.erase(m_monthTotals.lower_bound(firstKeyOfYear(year)),
+                            m_monthTotals.upper_bound(lastKeyOfYear(year)));
+        bulkIndexLocked(expenses);
+        PFM_COUNTER_ADD("storage.rows_loaded", expenses.size());
+        
+        // The rows give the exact id range; the manifest's may be wider after deletes
+        partition.minId = std::numeric_limits<int>::max();
+        partition.maxId = std::numeric_limits<int>::min();
+        for (const auto& expense : expenses) {
+            partition.noteId(expense.id);
+        }
+        partition.expenseCount = expenses.size();
+        partition.loaded = true;
+        return true;
+    } catch (const std::exception& e) {
+        std::cerr << "Error loading partition " << partition.fileName << ": " << e.what() << std::endl;
+        partition.failed = true;
+        return false;
+    }
+}
+
+bool ExpenseManager::loadYearsHoldingLocked(int id)
+{
+    bool success = true;
+    for (const auto& entry : m_partitions) {
+        if (m_expenseMonths.count(id) > 0) {
+            break;
+        }
+        if (!entry.second.loaded && entry.second.mayHoldId(id)) {
+            success = loadYearLocked(entry.first) && success;
+        }
+    }
+    return success;
+}
+
+void ExpenseManager::evictYearLocked(int year)
+{
+    auto begin = m_chunks.lower_bound(firstKeyOfYear(year));
+    auto end = m_chunks.upper_bound(lastKeyOfYear(year));
+    
+    std::vector<std::pair<int, const std::string*>> documents;
+    for (auto chunk = begin; chunk != end; ++chunk) {
+        for (const auto& expense : *chunk->second) {
+            m_expenseMonths.erase(expense.id);
+            m_duplicateIndex.remove(expense);
+            documents.push_back(std::make_pair(expense.id, &expense.description));
+        }
+    }
+    m_searchIndex.removeAll(documents);
+    m_chunks.erase(begin, end);
+    
+    // Month totals stay behind so reports keep working without the rows
+    m_partitions[year].loaded = false;
+    PFM_COUNTER_ADD("storage.partitions_evicted", 1);
+}
+
+void ExpenseManager::evictColdPartitionsLocked()
+{
+    size_t loadedBytes = 0;
+    std::vector<std::pair<uint64_t, int>> candidates;
+    int currentYear = DateUtils::currentYear();
+    
+    for (const auto& entry : m_partitions) {
+        const YearPartition& partition = entry.second;
+        if (!partition.loaded) {
+            continue;
+        }
+        loadedBytes += partition.expenseCount * kApproxExpenseBytes;
+        if (!partition.dirty && entry.first != currentYear) {
+            candidates.push_back(std::make_pair(partition.lastUsed.load(), entry.first));
+        }
+    }
+    
+    // Under a shared budget this ledger may use whatever the others leave
+    size_t budget = m_sharedBudget ? m_sharedBudget->available(m_reportedBytes) : m_memoryBudget;
+    std::sort(candidates.begin(), candidates.end());
+    for (const auto& candidate : candidates) {
+        if (loadedBytes <= budget) {
+            break;
+        }
+        loadedBytes -= m_partitions[candidate.second].expenseCount * kApproxExpenseBytes;
+        evictYearLocked(candidate.second);
+    }
+    
+    if (m_sharedBudget) {
+        m_sharedBudget->update(m_reportedBytes, loadedBytes);
+    }
+    m_reportedBytes = loadedBytes;
+}
+
+ExpenseManager::YearPartition& ExpenseManager::partitionLocked(int year)
+{
+    auto it = m_partitions.find(year);
+    if (it != m_partitions.end()) {
+        return it->second;
+    }
+    
+    // A year seen for the first time starts out as an empty, loaded partition
+    YearPartition& partition = m_partitions[year];
+    partition.fileName = partitionFileName(year);
+    partition.loaded = true;
+    return partition;
+}
+
+std::string ExpenseManager::partitionPath(const std::string& fileName) const
+{
+    return (fs::path(m_dataFilePath).parent_path() / fileName).string();
+}
+
+std::string ExpenseManager::partitionFileName(int year) const
+{
+    char yearText[16];
+    std::snprintf(yearText, sizeof(yearText), "%04d", year);
+    return fs::path(m_dataFilePath).stem().string() + "." + yearText + "." + std::to_string(m_saveGeneration + 1) +
+           partitionExtension(m_storageFormat);
+}
+
+// Files from a save that crashed before its manifest was written, and files a
+// committed save replaced but did not get to remove. Names without a
+// generation are left alone; another ledger's manifest can look like one.
+void ExpenseManager::removeUnlistedPartitionFilesLocked()
+{
+    std::unordered_set<std::string> listed;
+    for (const auto& entry : m_partitions) {
+        listed.insert(entry.second.fileName);
+    }
+    for (const auto& file : listPartitionFiles(m_dataFilePath)) {
+        if (file.generation > 0 && listed.count(file.name) == 0) {
+            std::error_code error;
+            fs::remove(partitionPath(file.name), error);
+        }
+    }
+}
+
+bool ExpenseManager::addExpense(const Expense& expense, std::vector<DuplicateMatch>* duplicates)
+{
+    PFM_SCOPED_TIMER("ExpenseManager::addExpense");
+    size_t added;
+    return addAndSave({expense}, duplicates, added) && added > 0;
+}
+
+bool ExpenseManager::addExpenses(const std::vector<Expense>& expenses, std::vector<DuplicateMatch>* duplicates)
+{
+    if (expenses.empty()) {
+        return true;
+    }
+    
+    PFM_SCOPED_TIMER("ExpenseManager::addExpenses");
+    size_t added;
+    return addAndSave(expenses, duplicates, added);
+}
+
+bool ExpenseManager::addAndSave(const std::vector<Expense>& expenses, std::vector<DuplicateMatch>* duplicates,
+                                size_t& added)
+{
+    std::vector<BudgetAlert> alerts;
+    bool saved;
+    added = 0;
+    {
+        std::unique_lock<SharedMutex> lock(m_mutex);
+        if (refuseEditLocked()) {
+            return false;
+        }
+        LedgerEdit edit;
+        if (!addExpensesLocked(expenses, alerts, duplicates, &edit.inserted)) {
+            return false;
+        }
+        
+        // Rows that are not on disk are taken out again, so the caller never
+        // sees rows that would vanish on restart
+        saved = edit.inserted.empty() || saveDataLocked();
+        if (!saved) {
+            for (const auto& expense : edit.inserted) {
+                removeExpenseLocked(expense.id);
+            }
+            alerts.clear();
+        } else if (!edit.inserted.empty()) {
+            added = edit.inserted.size();
+            edit.description = added == 1 ? "Add expense" : "Add expenses";
+            recordEditLocked(std::move(edit));
+        }
+        evictColdPartitionsLocked();
+    }
+    
+    dispatchBudgetAlerts(alerts);
+    return saved;
+}
+
+bool ExpenseManager::addExpensesLocked(const std::vector<Expense>& expenses, std::vector<BudgetAlert>& alerts,
+                                       std::vector<DuplicateMatch>* duplicates, std::vector<Expense>* inserted,
+                                       bool checkDuplicates)
+{
+    // Every year is loaded before the first insert, so a batch goes in whole or not at all
+    std::vector<int> monthKeys;
+    for (const auto& expense : expenses) {
+        if (!loadYearLocked(yearOfDate(expense.date, 0))) {
+            return false;
+        }
+        monthKeys.push_back(DateUtils::monthKey(expense.date));
+    }
+    std::sort(monthKeys.begin(), monthKeys.end());
+    monthKeys.erase(std::unique(monthKeys.begin(), monthKeys.end()), monthKeys.end());
+    std::vector<BudgetStatus> budgets = affectedBudgetsLocked(monthKeys);
+    std::vector<const Expense*> accepted;
+    if (checkDuplicates) {
+        accepted = filterDuplicatesLocked(expenses, duplicates);
+    } else {
+        for (const auto& expense : expenses) {
+            accepted.push_back(&expense);
+        }
+    }
+    
+    m_expenseMonths.reserve(m_expenseMonths.size() + accepted.size());
+    if (inserted) {
+        inserted->reserve(inserted->size() + accepted.size());
+    }
+    for (const Expense* expense : accepted) {
+        Expense newExpense = *expense;
+        newExpense.id = getNextExpenseId();
+        insertExpenseLocked(newExpense);
+        if (inserted) {
+            inserted->push_back(newExpense);
+        }
+    }
+    
+    collectBudgetAlertsLocked(budgets, alerts);
+    return true;
+}
+
+std::vector<const Expense*> ExpenseManager::filterDuplicatesLocked(const std::vector<Expense>& expenses,
+                                                                   std::vector<DuplicateMatch>* duplicates)
+{
+    std::vector<const Expense*> accepted;
+    accepted.reserve(expenses.size());
+    if (m_duplicatePolicy == DuplicatePolicy::Allow) {
+        for (const auto& expense : expenses) {
+            accepted.push_back(&expense);
+        }
+        return accepted;
+    }
+    
+    // The date window can reach into a neighbouring year
+    if (m_duplicateWindow > 0) {
+        for (const auto& expense : expenses) {
+            loadYearLocked(yearOfDate(DateUtils::addDays(expense.date, -m_duplicateWindow), 0));
+            loadYearLocked(yearOfDate(DateUtils::addDays(expense.date, m_duplicateWindow), 0));
+        }
+    }
+    
+    // New rows are compared with the ledger as it was before the batch, so
+    // identical rows within one statement stay apart, and each stored expense
+    // can be matched by one new row only
+    std::unordered_set<int> matched;
+    for (const auto& expense : expenses) {
+        const Expense* existing = nullptr;
+        for (int id : m_duplicateIndex.candidates(expense, m_duplicateWindow)) {
+            const Expense* candidate = findExpenseLocked(id);
+            if (candidate && matched.count(id) == 0 && DuplicateIndex::equivalent(expense, *candidate)) {
+                existing = candidate;
+                break;
+            }
+        }
+        
+        if (existing) {
+            matched.insert(existing->id);
+            if (duplicates) {
+                duplicates->push_back({expense, *existing});
+            }
+            if (m_duplicatePolicy == DuplicatePolicy::Reject) {
+                continue;
+            }
+        }
+        accepted.push_back(&expense);
+    }
+    
+    return accepted;
+}
+
+bool ExpenseManager::updateExpense(int id, const Expense& expense)
+{
+    PFM_SCOPED_TIMER("ExpenseManager::updateExpense");
+    std::vector<BudgetAlert> alerts;
+    bool saved;
+    {
+        std::unique_lock<SharedMutex> lock(m_mutex);
+        if (refuseEditLocked()) {
+            return false;
+        }
+        loadYearsHoldingLocked(id);  // The expense may be in a cold partition
+        if (m_expenseMonths.find(id) == m_expenseMonths.end() ||
+            !loadYearLocked(yearOfDate(expense.date, 0))) {
+            return false;
+        }
+        
+        std::vector<BudgetStatus> budgets = affectedBudgetsLocked({m_expenseMonths[id],
+                                                                   DateUtils::monthKey(expense.date)});
+        LedgerEdit edit;
+        edit.description = "Edit expense";
+        edit.removed.resize(1);
+        removeExpenseLocked(id, &edit.removed[0]);
+        Expense updatedExpense = expense;
+        updatedExpense.id = id;  // Preserve the original ID
+        insertExpenseLocked(updatedExpense);
+        edit.inserted.push_back(updatedExpense);
+        recordEditLocked(std::move(edit));
+        
+        saved = saveDataLocked();
+        evictColdPartitionsLocked();
+        collectBudgetAlertsLocked(budgets, alerts);
+    }
+    
+    dispatchBudgetAlerts(alerts);
+    return saved;
+}
+
+bool ExpenseManager::deleteExpense(int id)
+{
+    PFM_SCOPED_TIMER("ExpenseManager::deleteExpense");
+    std::unique_lock<SharedMutex> lock(m_mutex);
+    if (refuseEditLocked()) {
+        return false;
+    }
+    loadYearsHoldingLocked(id);  // The expense may be in a cold partition
+    
+    // Deleting only lowers spending, so it can never cross a budget threshold
+    LedgerEdit edit;
+    edit.description = "Delete expense";
+    edit.removed.resize(1);
+    if (removeExpenseLocked(id, &edit.removed[0])) {
+        recordEditLocked(std::move(edit));
+        bool saved = saveDataLocked();
+        evictColdPartitionsLocked();
+        return saved;
+    }
+    
+    return false;
+}
+
+bool ExpenseManager::deleteExpenses(const std::vector<int>& ids)
+{
+    PFM_SCOPED_TIMER("ExpenseManager::deleteExpenses");
+    std::unique_lock<SharedMutex> lock(m_mutex);
+    if (refuseEditLocked()) {
+        return false;
+    }
+    for (int id : ids) {
+        loadYearsHoldingLocked(id);  // Some may be in cold partitions
+    }
+    
+    LedgerEdit edit;
+    edit.description = "Delete expenses";
+    edit.removed.reserve(ids.size());
+    bool found = true;
+    for (int id : ids) {
+        Expense removed;
+        if (removeExpenseLocked(id, &removed)) {
+            edit.removed.push_back(removed);
+        } else {
+            found = false;
+        }
+    }
+    if (!edit.removed.empty()) {
+        recordEditLocked(std::move(edit));
+    }
+    
+    bool saved = saveDataLocked();
+    evictColdPartitionsLocked();
+    return found && saved;
+}
+
+bool ExpenseManager::getExpense(int id, Expense& expense) const
+{
+    {
+        std::shared_lock<SharedMutex> lock(m_mutex);
+        if (const Expense* found = findExpenseLocked(id)) {
+            expense = *found;
+            return true;
+        }
+    }
+    
+    // Only the partitions whose id range holds it are loaded
+    std::unique_lock<SharedMutex> lock(m_mutex);
+    PFM_COUNTER_ADD("storage.cold_reads", 1);
+    ExpenseManager* self = const_cast<ExpenseManager*>(this);
+    self->loadYearsHoldingLocked(id);
+    const Expense* found = findExpenseLocked(id);
+    if (found) {
+        expense = *found;
+    }
+    self->evictColdPartitionsLocked();
+    return found != nullptr;
+}
+
+std::vector<Expense> ExpenseManager::getAllExpenses() const
+{
+    PFM_SCOPED_TIMER("ExpenseManager::getAllExpenses");
+    return readYears(kFirstYear, kLastYear, [this]() {
+        std::vector<Expense> result;
+        result.reserve(m_expenseMonths.size());
+        
+        for (const auto& entry : m_chunks) {
+            result.insert(result.end(), entry.second->begin(), entry.second->end());
+        }
+        
+        PFM_COUNTER_ADD("query.rows_scanned", result.size());
+        return result;
+    });
+}
+
+std::vector<Expense> ExpenseManager::getExpensesByMonth(int year, int month, bool includeProjected) const
+{
+    PFM_SCOPED_TIMER("ExpenseManager::getExpensesByMonth");
+    return readYears(year, year, [this, year, month, includeProjected]() {
+        std::vector<Expense> result;
+        auto it = m_chunks.find(DateUtils::monthKey(year, month));
+        if (it != m_chunks.end()) {
+            PFM_COUNTER_ADD("query.rows_scanned", it->second->size());
+            result = *it->second;
+        }
+        
+        // Stored rows first, then the projected ones
+        if (includeProjected) {
+            std::vector<Expense> projected = projectMonthLocked(year, month);
+            result.insert(result.end(), projected.begin(), projected.end());
+        }
+        return result;
+    });
+}
+
+std::vector<Expense> ExpenseManager::getExpensesByCategory(const std::string& category) const
+{
+    PFM_SCOPED_TIMER("ExpenseManager::getExpensesByCategory");
+    return readYears(kFirstYear, kLastYear, [this, &category]() {
+        std::vector<Expense> result;
+        
+        for (const auto& entry : m_chunks) {
+            for (const auto& expense : *entry.second) {
+                if (expense.category == category) {
+                    result.push_back(expense);
+                }
+            }
+        }
+        
+        PFM_COUNTER_ADD("query.rows_scanned", m_expenseMonths.size());
+        return result;
+    });
+}
+
+std::vector<Expense> ExpenseManager::searchExpenses(const std::string& query,
+                                                    const SearchFilters& filters) const
+{
+    PFM_SCOPED_TIMER("ExpenseManager::searchExpenses");
+    int fromYear = yearOfDate(filters.fromDate, kFirstYear);
+    int toYear = yearOfDate(filters.toDate, kLastYear);
+    
+    return readYears(fromYear, toYear, [&]() {
+        std::vector<Expense> result;
+        size_t scanned = 0;
+        
+        auto accept = [&filters, &scanned](const Expense& expense) {
+            ++scanned;
+            if ((!filters.fromDate.empty() && expense.date < filters.fromDate) ||
+                (!filters.toDate.empty() && expense.date > filters.toDate)) {
+                return false;
+            }
+            return filters.categories.empty() ||
+                   std::find(filters.categories.begin(), filters.categories.end(),
+                             expense.category) != filters.categories.end();
+        };
+        auto full = [&filters, &result]() {
+            return filters.limit > 0 && result.size() >= filters.limit;
+        };
+        
+        if (!SearchIndex::tokenize(query).empty()) {
+            // Ids follow insertion order, not dates, so every match is a candidate
+            for (int id : m_searchIndex.search(query)) {
+                const Expense* expense = findExpenseLocked(id);
+                if (expense && accept(*expense)) {
+                    result.push_back(*expense);
+                }
+            }
+        } else {
+            // No text to match: only visit the months inside the date range,
+            // newest first. Rows within a month are in id order, so a month is
+            // taken whole and the limit applied after sorting.
+            auto begin = filters.fromDate.empty() ? m_chunks.begin()
+                                                  : m_chunks.lower_bound(DateUtils::monthKey(filters.fromDate));
+            auto end = filters.toDate.empty() ? m_chunks.end()
+                                              : m_chunks.upper_bound(DateUtils::monthKey(filters.toDate));
+            for (auto chunk = std::make_reverse_iterator(end);
+                 chunk != std::make_reverse_iterator(begin) && !full(); ++chunk) {
+                for (const auto& expense : *chunk->second) {
+                    if (accept(expense)) {
+                        result.push_back(expense);
+                    }
+                }
+            }
+        }
+        
+        auto newestFirst = [](const Expense& a, const Expense& b) {
+            return a.date != b.date ? a.date > b.date : a.id > b.id;
+        };
+        if (filters.limit > 0 && result.size() > filters.limit) {
+            std::partial_sort(result.begin(), result.begin() + filters.limit, result.end(), newestFirst);
+            result.resize(filters.limit);
+        } else {
+            std::sort(result.begin(), result.end(), newestFirst);
+        }
+        PFM_COUNTER_ADD("query.rows_scanned", scanned);
+        return result;
+    });
+}
+
+ExpenseManager::QueryPlan ExpenseManager::planQueryLocked(const ExpenseQuery& query) const
+{
+    QueryPlan plan;
+    plan.totalsExact = SearchIndex::tokenize(query.text).empty() &&
+                       query.minAmount == -std::numeric_limits<double>::infinity() &&
+                       query.maxAmount == std::numeric_limits<double>::infinity() &&
+                       !(query.includeProjected && !projectRecurringLocked(query.fromDate, query.toDate).empty());
+    
+    int fromKey = query.fromDate.empty() ? firstKeyOfYear(kFirstYear) : DateUtils::monthKey(query.fromDate);
+    int toKey = query.toDate.empty() ? lastKeyOfYear(kLastYear) : DateUtils::monthKey(query.toDate);
+    
+    // Date pushdown: only months inside the range. Category pushdown: only
+    // months whose running totals include one of the requested categories.
+    for (auto month = m_monthTotals.lower_bound(fromKey);
+         month != m_monthTotals.end() && month->first <= toKey; ++month) {
+        QueryMonth candidate;
+        candidate.key = month->first;
+        candidate.count = 0;
+        candidate.amount = 0.0;
+        for (const auto& total : month->second) {
+            if (query.categories.empty() ||
+                std::find(query.categories.begin(), query.categories.end(), total.first) != query.categories.end()) {
+                candidate.count += total.second.count;
+                candidate.amount += total.second.amount;
+            }
+        }
+        if (candidate.count == 0) {
+            continue;
+        }
+        
+        int year = yearOfKey(candidate.key);
+        int monthOfYear = candidate.key % 100;
+        candidate.whole = (query.fromDate.empty() || query.fromDate <= DateUtils::formatDate(year, monthOfYear, 1)) &&
+                          (query.toDate.empty() ||
+                           query.toDate >= DateUtils::formatDate(year, monthOfYear, DateUtils::daysInMonth(year, monthOfYear)));
+        plan.totalsExact = plan.totalsExact && candidate.whole;
+        plan.months.push_back(candidate);
+    }
+    
+    plan.firstRead = 0;
+    plan.lastRead = plan.months.size();
+    plan.skippedRows = 0;
+    
+    // With exact per-month counts a date-ordered page lies in a known run of
+    // months, so the months before and after it are never read
+    if (plan.totalsExact && query.sortBy == QuerySort::Date) {
+        size_t count = plan.months.size();
+        size_t skipped = 0;
+        size_t first = 0;
+        while (first < count) {
+            const QueryMonth& month = plan.months[query.descending ? count - 1 - first : first];
+            if (skipped + month.count > query.offset) {
+                break;
+            }
+            skipped += month.count;
+            ++first;
+        }
+        
+        size_t last = first;
+        size_t covered = skipped;
+        while (last < count && (query.limit == 0 || covered < query.offset + query.limit)) {
+            covered += plan.months[query.descending ? count - 1 - last : last].count;
+            ++last;
+        }
+        
+        plan.skippedRows = skipped;
+        plan.firstRead = query.descending ? count - last : first;
+        plan.lastRead = query.descending ? count - first : last;
+    }
+    
+    plan.fromYear = kLastYear;
+    plan.toYear = kFirstYear;
+    if (plan.firstRead < plan.lastRead) {
+        plan.fromYear = yearOfKey(plan.months[plan.firstRead].key);
+        plan.toYear = yearOfKey(plan.months[plan.lastRead - 1].key);
+    }
+    return plan;
+}
+
+QueryResult ExpenseManager::query(const ExpenseQuery& query) const
+{
+    PFM_SCOPED_TIMER("ExpenseManager::query");
+    if ((!query.fromDate.empty() && !DateUtils::isValidDate(query.fromDate)) ||
+        (!query.toDate.empty() && !DateUtils::isValidDate(query.toDate))) {
+        std::cerr << "Invalid query date range: " << query.fromDate << " to " << query.toDate << std::endl;
+        QueryResult result;
+        result.plan = "invalid date range";
+        return result;
+    }
+    
+    // Runs under the lock the plan was made under, with its partitions loaded
+    auto run = [&](const QueryPlan& plan) {
+        QueryResult result;
+        std::vector<std::string> tokens = SearchIndex::tokenize(query.text);
+        
+        // Predicates that the month plan does not already guarantee
+        auto accept = [&](const Expense& expense) {
+            return (query.fromDate.empty() || expense.date >= query.fromDate) &&
+                   (query.toDate.empty() || expense.date <= query.toDate) &&
+                   expense.amount >= query.minAmount && expense.amount <= query.maxAmount &&
+                   (query.categories.empty() ||
+                    std::find(query.categories.begin(), query.categories.end(),
+                              expense.category) != query.categories.end());
+        };
+        
+        // Only a partition that failed to load leaves a planned month without rows
+        size_t candidateRows = 0;
+        size_t unreadableMonths = 0;
+        for (size_t i = plan.firstRead; i < plan.lastRead; ++i) {
+            candidateRows += plan.months[i].count;
+            unreadableMonths += m_chunks.count(plan.months[i].key) == 0 ? 1 : 0;
+        }
+        
+        std::vector<const Expense*> matches;
+        size_t scanned = 0;
+        std::vector<int> ids;
+        if (!tokens.empty()) {
+            ids = m_searchIndex.search(query.text);
+        }
+        
+        // Id lookups are much cheaper than tokenizing every description, so the
+        // text index wins unless the other predicates are far more selective
+        if (!tokens.empty() && ids.size() <= candidateRows * 4) {
+            result.plan = "text index: " + std::to_string(ids.size()) + " candidates";
+            scanned = ids.size();
+            for (int id : ids) {
+                const Expense* expense = findExpenseLocked(id);
+                if (expense && accept(*expense)) {
+                    matches.push_back(expense);
+                }
+            }
+        } else {
+            result.plan = "month scan: " + std::to_string(plan.lastRead - plan.firstRead) + " of " +
+                          std::to_string(plan.months.size()) + " months, " +
+                          std::to_string(candidateRows) + " candidates";
+            scanned = candidateRows;
+            for (size_t i = plan.firstRead; i < plan.lastRead; ++i) {
+                auto chunk = m_chunks.find(plan.months[i].key);
+                if (chunk == m_chunks.end()) {
+                    continue;  // Counted in unreadableMonths
+                }
+                
+                bool whole = plan.months[i].whole;
+                for (const auto& expense : *chunk->second) {
+                    if ((whole && query.categories.empty() && plan.totalsExact) ||
+                        (accept(expense) && (tokens.empty() || SearchIndex::matches(tokens, expense.description)))) {
+                        matches.push_back(&expense);
+                    }
+                }
+            }
+        }
+        
+        if (unreadableMonths > 0) {
+            result.plan += ", " + std::to_string(unreadableMonths) + " months unreadable";
+            std::cerr << "Query skipped " << unreadableMonths << " months of damaged partitions in "
+                      << m_dataFilePath << "; run recovery" << std::endl;
+        }
+        
+        // Projected occurrences exist only for this result; the plan never
+        // trusts the totals when there are any
+        std::vector<Expense> projected;
+        if (query.includeProjected) {
+            projected = projectRecurringLocked(query.fromDate, query.toDate);
+            scanned += projected.size();
+        }
+        for (const auto& expense : projected) {
+            if (accept(expense) && (tokens.empty() || SearchIndex::matches(tokens, expense.description))) {
+                matches.push_back(&expense);
+            }
+        }
+        PFM_COUNTER_ADD("query.rows_scanned", scanned);
+        
+        // Totals and groups cover every match, including pages not returned
+        std::map<std::string, QueryGroup> groups;
+        auto addToGroup = [&](const std::string& key, double amount, size_t count) {
+            QueryGroup& group = groups[key];
+            group.key = key;
+            group.total += amount;
+            group.count += count;
+        };
+        
+        if (plan.totalsExact) {
+            result.plan += ", totals from month index";
+            for (const auto& month : plan.months) {
+                result.totalMatches += month.count;
+                result.totalAmount += month.amount;
+                
+                if (query.groupBy == QueryGroupBy::Category) {
+                    for (const auto& total : m_monthTotals.at(month.key)) {
+                        if (query.categories.empty() ||
+                            std::find(query.categories.begin(), query.categories.end(),
+                                      total.first) != query.categories.end()) {
+                            addToGroup(total.first, total.second.amount, total.second.count);
+                        }
+                    }
+                } else if (query.groupBy == QueryGroupBy::Month) {
+                    addToGroup(DateUtils::formatDate(yearOfKey(month.key), month.key % 100, 1).substr(0, 7),
+                               month.amount, month.count);
+                } else if (query.groupBy == QueryGroupBy::Year) {
+                    addToGroup(std::to_string(yearOfKey(month.key)), month.amount, month.count);
+                }
+            }
+        } else {
+            result.totalMatches = matches.size();
+            for (const Expense* expense : matches) {
+                result.totalAmount += expense->amount;
+                
+                if (query.groupBy == QueryGroupBy::Category) {
+                    addToGroup(expense->category, expense->amount, 1);
+                } else if (query.groupBy == QueryGroupBy::Month) {
+                    addToGroup(expense->date.substr(0, 7), expense->amount, 1);
+                } else if (query.groupBy == QueryGroupBy::Year) {
+                    addToGroup(expense->date.substr(0, 4), expense->amount, 1);
+                }
+            }
+        }
+        for (const auto& group : groups) {
+            result.groups.push_back(group.second);
+        }
+        
+        // Top-K: only the rows up to the end of the page are ordered
+        auto before = [&query](const Expense* a, const Expense* b) {
+            if (query.descending) {
+                std::swap(a, b);
+            }
+            switch (query.sortBy) {
+            case QuerySort::Amount:
+                if (a->amount != b->amount) {
+                    return a->amount < b->amount;
+                }
+                break;
+            case QuerySort::Category:
+                if (a->category != b->category) {
+                    return a->category < b->category;
+                }
+                break;
+            case QuerySort::Description:
+                if (a->description != b->description) {
+                    return a->description < b->description;
+                }
+                break;
+            case QuerySort::Date:
+                break;
+            }
+            return a->date != b->date ? a->date < b->date : a->id < b->id;
+        };
+        
+        size_t offset = query.offset - std::min(query.offset, plan.skippedRows);
+        size_t end = query.limit == 0 ? matches.size() : std::min(matches.size(), offset + query.limit);
+        if (offset < end) {
+            std::partial_sort(matches.begin(), matches.begin() + end, matches.end(), before);
+            result.rows.reserve(end - offset);
+            for (size_t i = offset; i < end; ++i) {
+                result.rows.push_back(*matches[i]);
+            }
+        }
+        
+        return result;
+    };
+    
+    // The plan is made under the same lock that reads, so a write cannot
+    // change it in between. If it needs a cold year, the plan is made again
+    // under the exclusive lock, and every year it names is loaded first.
+    {
+        std::shared_lock<SharedMutex> lock(m_mutex);
+        QueryPlan plan = planQueryLocked(query);
+        if (yearsLoadedLocked(plan.fromYear, plan.toYear)) {
+            return run(plan);
+        }
+    }
+    
+    std::unique_lock<SharedMutex> lock(m_mutex);
+    PFM_COUNTER_ADD("storage.cold_reads", 1);
+    ExpenseManager* self = const_cast<ExpenseManager*>(this);
+    QueryPlan plan = planQueryLocked(query);
+    self->loadYearsLocked(plan.fromYear, plan.toYear);
+    QueryResult result = run(plan);
+    self->evictColdPartitionsLocked();
+    return result;
+}
+
+bool ExpenseManager::addCategory(const Category& category)
+{
+    std::unique_lock<SharedMutex> lock(m_mutex);
+    if (refuseEditLocked()) {
+        return false;
+    }
+    auto it = std::find_if(m_categories->begin(), m_categories->end(),
+                          [&category](const Category& c) { return c.name == category.name; });
+    
+    if (it == m_categories->end()) {
+        LedgerEdit edit;
+        edit.description = "Add category";
+        edit.hasCategory = true;
+        edit.newCategory = category;
+        edit.categoryIndex = m_categories->size();
+        recordEditLocked(std::move(edit));
+        
+        mutableCategories().push_back(category);
+        return saveDataLocked();
+    }
+    
+    return false;
+}
+
+bool ExpenseManager::updateCategory(const std::string& name, const Category& category)
+{
+    std::unique_lock<SharedMutex> lock(m_mutex);
+    if (refuseEditLocked()) {
+        return false;
+    }
+    std::vector<Category>& categories = mutableCategories();
+    auto it = std::find_if(categories.begin(), categories.end(),
+                          [&name](const Category& c) { return c.name == name; });
+    
+    if (it != categories.end()) {
+        LedgerEdit edit;
+        edit.description = "Edit category";
+        edit.hadCategory = edit.hasCategory = true;
+        edit.oldCategory = *it;
+        edit.newCategory = category;
+        edit.categoryIndex = it - categories.begin();
+        recordEditLocked(std::move(edit));
+        
+        *it = category;
+        renameCategoryLocked(name, category.name);
+        return saveDataLocked();
+    }
+    
+    return false;
+}
+
+bool ExpenseManager::deleteCategory(const std::string& name)
+{
+    std::unique_lock<SharedMutex> lock(m_mutex);
+    if (refuseEditLocked()) {
+        return false;
+    }
+    auto it = std::find_if(m_categories->begin(), m_categories->end(),
+                          [&name](const Category& c) { return c.name == name; });
+    
+    if (it != m_categories->end()) {
+        if (!categoryInUseLocked(name)) {
+            LedgerEdit edit;
+            edit.description = "Delete category";
+            edit.hadCategory = true;
+            edit.oldCategory = *it;
+            edit.categoryIndex = it - m_categories->begin();
+            
+            std::vector<Category>& categories = mutableCategories();
+            categories.erase(categories.begin() + edit.categoryIndex);
+            auto budgets = std::stable_partition(m_budgets.begin(), m_budgets.end(),
+                                                 [&name](const Budget& budget) { return budget.category != name; });
+            edit.budgets.assign(budgets, m_budgets.end());
+            m_budgets.erase(budgets, m_budgets.end());
+            recordEditLocked(std::move(edit));
+            return saveDataLocked();
+        }
+    }
+    
+    return false;
+}
+
+std::vector<Category> ExpenseManager::getAllCategories() const
+{
+    std::shared_lock<SharedMutex> lock(m_mutex);
+    return *m_categories;
+}
+
+bool ExpenseManager::categoryInUseLocked(const std::string& name) const
+{
+    // Check if any expenses use this category; the totals cover cold years too
+    return std::any_of(m_monthTotals.begin(), m_monthTotals.end(),
+                       [&name](const auto& month) { return month.second.count(name) > 0; }) ||
+           std::any_of(m_recurringRules.begin(), m_recurringRules.end(),
+                       [&name](const RecurringRule& rule) { return rule.category == name; });
+}
+
+void ExpenseManager::renameCategoryLocked(const std::string& oldName, const std::string& newName)
+{
+    for (auto& budget : m_budgets) {
+        if (budget.category == oldName) {
+            budget.category = newName;
+        }
+    }
+    for (auto& rule : m_recurringRules) {
+        if (rule.category == oldName) {
+            rule.category = newName;
+        }
+    }
+}
+
+bool ExpenseManager::setBudget(const Budget& budget)
+{
+    std::unique_lock<SharedMutex> lock(m_mutex);
+    if (refuseEditLocked()) {
+        return false;
+    }
+    bool validThresholds = std::all_of(budget.thresholds.begin(), budget.thresholds.end(),
+                                       [](double threshold) { return threshold > 0.0; });
+    bool knownCategory = budget.isOverall() ||
+                         std::any_of(m_categories->begin(), m_categories->end(),
+                                     [&budget](const Category& c) { return c.name == budget.category; });
+    if (!(budget.limit > 0.0) || !validThresholds || !knownCategory) {
+        return false;
+    }
+    
+    Budget newBudget = budget;
+    std::sort(newBudget.thresholds.begin(), newBudget.thresholds.end());
+    
+    auto it = std::find_if(m_budgets.begin(), m_budgets.end(), [&budget](const Budget& b) {
+        return b.category == budget.category && b.period == budget.period;
+    });
+    if (it != m_budgets.end()) {
+        *it = newBudget;
+    } else {
+        m_budgets.push_back(newBudget);
+    }
+    
+    return saveDataLocked();
+}
+
+bool ExpenseManager::removeBudget(const std::string& category, BudgetPeriod period)
+{
+    std::unique_lock<SharedMutex> lock(m_mutex);
+    if (refuseEditLocked()) {
+        return false;
+    }
+    auto it = std::find_if(m_budgets.begin(), m_budgets.end(), [&](const Budget& budget) {
+        return budget.category == category && budget.period == period;
+    });
+    
+    if (it != m_budgets.end()) {
+        m_budgets.erase(it);
+        return saveDataLocked();
+    }
+    
+    return false;
+}
+
+std::vector<Budget> ExpenseManager::getBudgets() const
+{
+    std::shared_lock<SharedMutex> lock(m_mutex);
+    return m_budgets;
+}
+
+std::vector<BudgetStatus> ExpenseManager::getBudgetStatus(int year, int month) const
+{
+    std::shared_lock<SharedMutex> lock(m_mutex);
+    std::vector<BudgetStatus> statuses;
+    
+    for (const auto& budget : m_budgets) {
+        statuses.push_back(budgetStatusLocked(budget, year, month));
+    }
+    
+    return statuses;
+}
+
+void ExpenseManager::setBudgetAlertCallback(std::function<void(const BudgetAlert&)> callback)
+{
+    std::unique_lock<SharedMutex> lock(m_mutex);
+    m_budgetAlertCallback = callback;
+}
+
+BudgetStatus ExpenseManager::budgetStatusLocked(const Budget& budget, int year, int month) const
+{
+    BudgetStatus status;
+    status.budget = budget;
+    status.year = year;
+    status.month = budget.period == BudgetPeriod::Monthly ? month : 0;
+    
+    // At most twelve months of per-category totals
+    int fromKey = status.month ? DateUtils::monthKey(year, month) : firstKeyOfYear(year);
+    int toKey = status.month ? fromKey : lastKeyOfYear(year);
+    for (auto totals = m_monthTotals.lower_bound(fromKey);
+         totals != m_monthTotals.end() && totals->first <= toKey; ++totals) {
+        if (budget.isOverall()) {
+            for (const auto& total : totals->second) {
+                status.spent += total.second.amount;
+            }
+        } else {
+            auto total = totals->second.find(budget.category);
+            if (total != totals->second.end()) {
+                status.spent += total->second.amount;
+            }
+        }
+    }
+    
+    return status;
+}
+
+std::vector<BudgetStatus> ExpenseManager::affectedBudgetsLocked(const std::vector<int>& monthKeys) const
+{
+    std::vector<BudgetStatus> statuses;
+    for (const auto& budget : m_budgets) {
+        std::vector<int> periods;
+        for (int monthKey : monthKeys) {
+            int period = budget.period == BudgetPeriod::Monthly ? monthKey : yearOfKey(monthKey);
+            if (std::find(periods.begin(), periods.end(), period) == periods.end()) {
+                periods.push_back(period);
+                statuses.push_back(budgetStatusLocked(budget, yearOfKey(monthKey), monthKey % 100));
+            }
+        }
+    }
+    return statuses;
+}
+
+void ExpenseManager::collectBudgetAlertsLocked(const std::vector<BudgetStatus>& before,
+                                               std::vector<BudgetAlert>& alerts) const
+{
+    for (const auto& previous : before) {
+        BudgetStatus current = budgetStatusLocked(previous.budget, previous.year, previous.month);
+        
+        // Only upward crossings alert; the highest one crossed stands for the rest
+        BudgetAlert alert;
+        for (double threshold : previous.budget.thresholds) {
+            double amount = threshold * previous.budget.limit;
+            if (previous.spent < amount && current.spent >= amount) {
+                alert.threshold = threshold;
+            }
+        }
+        
+        if (alert.threshold > 0.0) {
+            alert.status = current;
+            alerts.push_back(alert);
+        }
+    }
+}
+
+void ExpenseManager::dispatchBudgetAlerts(const std::vector<BudgetAlert>& alerts) const
+{
+    if (alerts.empty()) {
+        return;
+    }
+    
+    std::function<void(const BudgetAlert&)> callback;
+    {
+        std::shared_lock<SharedMutex> lock(m_mutex);
+        callback = m_budgetAlertCallback;
+    }
+    
+    if (callback) {
+        for (const auto& alert : alerts) {
+            callback(alert);
+        }
+    }
+}
+
+bool ExpenseManager::setDuplicatePolicy(DuplicatePolicy policy, int windowDays)
+{
+    if (windowDays < 0 || windowDays > kMaxDuplicateWindow) {
+        return false;
+    }
+    
+    std::unique_lock<SharedMutex> lock(m_mutex);
+    if (refuseEditLocked()) {
+        return false;
+    }
+    m_duplicatePolicy = policy;
+    m_duplicateWindow = windowDays;
+    return saveDataLocked();
+}
+
+DuplicatePolicy ExpenseManager::getDuplicatePolicy() const
+{
+    std::shared_lock<SharedMutex> lock(m_mutex);
+    return m_duplicatePolicy;
+}
+
+int ExpenseManager::getDuplicateWindow() const
+{
+    std::shared_lock<SharedMutex> lock(m_mutex);
+    return m_duplicateWindow;
+}
+
+std::vector<Expense> ExpenseManager::findDuplicates(const Expense& expense) const
+{
+    int window = getDuplicateWindow();
+    int fromYear = yearOfDate(DateUtils::addDays(expense.date, -window), yearOfDate(expense.date, 0));
+    int toYear = yearOfDate(DateUtils::addDays(expense.date, window), yearOfDate(expense.date, 0));
+    
+    return readYears(fromYear, toYear, [&]() {
+        std::vector<Expense> result;
+        for (int id : m_duplicateIndex.candidates(expense, window, expense.id)) {
+            const Expense* candidate = findExpenseLocked(id);
+            if (candidate && DuplicateIndex::equivalent(expense, *candidate)) {
+                result.push_back(*candidate);
+            }
+        }
+        return result;
+    });
+}
+
+std::vector<DuplicateGroup> ExpenseManager::findDuplicateGroups(unsigned int threadCount) const
+{
+    PFM_SCOPED_TIMER("ExpenseManager::findDuplicateGroups");
+    std::shared_ptr<const LedgerSnapshot> ledger = snapshot();
+    long window = getDuplicateWindow();
+    
+    std::vector<const Expense*> rows;
+    rows.reserve(ledger->expenseCount());
+    ledger->forEachExpense([&rows](const Expense& expense) { rows.push_back(&expense); });
+    
+    unsigned int threads = threadCount ? threadCount : parallelism();
+    threads = static_cast<unsigned int>(std::max<size_t>(1, std::min<size_t>(threads, rows.size())));
+    
+    struct Row {
+        uint64_t fingerprint;
+        long day;
+        const Expense* expense;
+    };
+    
+    // Fingerprint in parallel; each thread sorts its rows into one shard per
+    // thread by hash, so every fingerprint ends up in exactly one shard
+    std::vector<std::vector<std::vector<Row>>> buckets(threads, std::vector<std::vector<Row>>(threads));
+    runParallel(threads, [&](unsigned int thread) {
+        size_t begin = rows.size() * thread / threads;
+        size_t end = rows.size() * (thread + 1) / threads;
+        for (size_t i = begin; i < end; ++i) {
+            Row row = {DuplicateIndex::fingerprint(*rows[i]), DuplicateIndex::dayNumber(rows[i]->date), rows[i]};
+            buckets[thread][row.fingerprint % threads].push_back(row);
+        }
+    });
+    PFM_COUNTER_ADD("query.rows_scanned", rows.size());
+    
+    // Group each shard without locks: within a fingerprint, ordered by date,
+    // every row within the window of an earlier keeper joins its group
+    std::vector<std::vector<DuplicateGroup>> shardGroups(threads);
+    runParallel(threads, [&](unsigned int shardIndex) {
+        std::vector<Row> shard;
+        for (const auto& bucket : buckets) {
+            shard.insert(shard.end(), bucket[shardIndex].begin(), bucket[shardIndex].end());
+        }
+        std::sort(shard.begin(), shard.end(), [](const Row& a, const Row& b) {
+            if (a.fingerprint != b.fingerprint) {
+                return a.fingerprint < b.fingerprint;
+            }
+            return a.day != b.day ? a.day < b.day : a.expense->id < b.expense->id;
+        });
+        
+        std::vector<char> grouped(shard.size(), 0);
+        for (size_t i = 0; i < shard.size(); ++i) {
+            if (grouped[i]) {
+                continue;
+            }
+            
+            DuplicateGroup group;
+            for (size_t j = i + 1; j < shard.size() && shard[j].fingerprint == shard[i].fingerprint &&
+                                   shard[j].day - shard[i].day <= window; ++j) {
+                if (!grouped[j] && DuplicateIndex::equivalent(*shard[i].expense, *shard[j].expense)) {
+                    grouped[j] = 1;
+                    group.duplicates.push_back(*shard[j].expense);
+                }
+            }
+            if (!group.duplicates.empty()) {
+                group.keeper = *shard[i].expense;
+                shardGroups[shardIndex].push_back(std::move(group));
+            }
+        }
+    });
+    
+    std::vector<DuplicateGroup> groups;
+    for (auto& shard : shardGroups) {
+        std::move(shard.begin(), shard.end(), std::back_inserter(groups));
+    }
+    std::sort(groups.begin(), groups.end(), [](const DuplicateGroup& a, const DuplicateGroup& b) {
+        return a.keeper.date != b.keeper.date ? a.keeper.date < b.keeper.date : a.keeper.id < b.keeper.id;
+    });
+    return groups;
+}
+
+bool ExpenseManager::undo()
+{
+    PFM_SCOPED_TIMER("ExpenseManager::undo");
+    return replayEdit(m_undoLog, m_redoLog, true);
+}
+
+bool ExpenseManager::redo()
+{
+    PFM_SCOPED_TIMER("ExpenseManager::redo");
+    return replayEdit(m_redoLog, m_undoLog, false);
+}
+
+bool ExpenseManager::canUndo() const
+{
+    std::shared_lock<SharedMutex> lock(m_mutex);
+    return !m_undoLog.empty();
+}
+
+bool ExpenseManager::canRedo() const
+{
+    std::shared_lock<SharedMutex> lock(m_mutex);
+    return !m_redoLog.empty();
+}
+
+std::string ExpenseManager::undoDescription() const
+{
+    std::shared_lock<SharedMutex> lock(m_mutex);
+    return m_undoLog.empty() ? std::string() : m_undoLog.back().description;
+}
+
+std::string ExpenseManager::redoDescription() const
+{
+    std::shared_lock<SharedMutex> lock(m_mutex);
+    return m_redoLog.empty() ? std::string() : m_redoLog.back().description;
+}
+
+void ExpenseManager::setUndoDepth(size_t depth)
+{
+    std::unique_lock<SharedMutex> lock(m_mutex);
+    m_undoDepth = depth;
+    trimEditLogsLocked();
+}
+
+size_t ExpenseManager::getUndoDepth() const
+{
+    std::shared_lock<SharedMutex> lock(m_mutex);
+    return m_undoDepth;
+}
+
+void ExpenseManager::recordEditLocked(LedgerEdit edit)
+{
+    m_redoLog.clear();
+    if (m_undoDepth == 0) {
+        return;
+    }
+    
+    for (const auto& expense : edit.inserted) {
+        edit.insertedIds.push_back(expense.id);
+    }
+    edit.inserted = std::vector<Expense>();
+    m_undoLog.push_back(std::move(edit));
+    trimEditLogsLocked();
+}
+
+// Drops the oldest edits, redo first, until the two logs together are within
+// the depth and the rows they hold within kMaxUndoBytes
+void ExpenseManager::trimEditLogsLocked()
+{
+    auto bytesOf = [](const LedgerEdit& edit) {
+        return (edit.removed.size() + edit.inserted.size()) * kApproxExpenseBytes +
+               edit.insertedIds.size() * sizeof(int);
+    };
+    size_t bytes = 0;
+    for (const auto& edit : m_undoLog) {
+        bytes += bytesOf(edit);
+    }
+    for (const auto& edit : m_redoLog) {
+        bytes += bytesOf(edit);
+    }
+    
+    while (m_undoLog.size() + m_redoLog.size() > m_undoDepth || bytes > kMaxUndoBytes) {
+        std::deque<LedgerEdit>& log = m_redoLog.empty() ? m_undoLog : m_redoLog;
+        bytes -= bytesOf(log.front());
+        log.pop_front();
+    }
+}
+
+bool ExpenseManager::replayEdit(std::deque<LedgerEdit>& from, std::deque<LedgerEdit>& to, bool reverse)
+{
+    std::vector<BudgetAlert> alerts;
+    bool saved;
+    {
+        std::unique_lock<SharedMutex> lock(m_mutex);
+        if (refuseEditLocked()) {
+            return false;
+        }
+        if (from.empty() || !applyEditLocked(from.back(), reverse, alerts)) {
+            return false;
+        }
+        
+        to.push_back(std::move(from.back()));
+        from.pop_back();
+        trimEditLogsLocked();
+        saved = saveDataLocked();
+        evictColdPartitionsLocked();
+    }
+    
+    dispatchBudgetAlerts(alerts);
+    return saved;
+}
+
+bool ExpenseManager::applyEditLocked(LedgerEdit& edit, bool reverse, std::vector<BudgetAlert>& alerts)
+{
+    // Undo copies the rows the edit put in out of the ledger, for redo
+    std::vector<Expense> undone;
+    if (reverse) {
+        undone.reserve(edit.insertedIds.size());
+        for (int id : edit.insertedIds) {
+            loadYearsHoldingLocked(id);
+            const Expense* expense = findExpenseLocked(id);
+            if (!expense) {
+                return false;
+            }
+            undone.push_back(*expense);
+        }
+    }
+    
+    const std::vector<Expense>& takeOut = reverse ? undone : edit.removed;
+    const std::vector<Expense>& putBack = reverse ? edit.removed : edit.inserted;
+    bool hadCategory = reverse ? edit.hasCategory : edit.hadCategory;
+    bool hasCategory = reverse ? edit.hadCategory : edit.hasCategory;
+    const Category& fromCategory = reverse ? edit.newCategory : edit.oldCategory;
+    const Category& toCategory = reverse ? edit.oldCategory : edit.newCategory;
+    
+    // Everything is checked before anything changes, so a replay that cannot
+    // apply leaves the ledger as it was. The rows carry their dates, so only
+    // their own partitions are loaded.
+    std::vector<int> monthKeys;
+    std::unordered_set<int> takenOut;
+    for (const auto& expense : takeOut) {
+        if (!loadYearLocked(yearOfDate(expense.date, 0)) || !findExpenseLocked(expense.id)) {
+            return false;
+        }
+        monthKeys.push_back(DateUtils::monthKey(expense.date));
+        takenOut.insert(expense.id);
+    }
+    for (const auto& expense : putBack) {
+        if (!loadYearLocked(yearOfDate(expense.date, 0)) ||
+            (findExpenseLocked(expense.id) && takenOut.count(expense.id) == 0)) {
+            return false;
+        }
+        monthKeys.push_back(DateUtils::monthKey(expense.date));
+    }
+    
+    auto categoryNamed = [this](const std::string& name) {
+        return std::find_if(m_categories->begin(), m_categories->end(),
+                            [&name](const Category& c) { return c.name == name; });
+    };
+    bool renamed = hadCategory && hasCategory && fromCategory.name != toCategory.name;
+    if ((hadCategory && categoryNamed(fromCategory.name) == m_categories->end()) ||
+        (hadCategory && !hasCategory && categoryInUseLocked(fromCategory.name)) ||
+        ((renamed || !hadCategory) && hasCategory && categoryNamed(toCategory.name) != m_categories->end())) {
+        return false;
+    }
+    
+    std::sort(monthKeys.begin(), monthKeys.end());
+    monthKeys.erase(std::unique(monthKeys.begin(), monthKeys.end()), monthKeys.end());
+    std::vector<BudgetStatus> budgets = affectedBudgetsLocked(monthKeys);
+    
+    for (const auto& expense : takeOut) {
+        removeExpenseLocked(expense.id);
+    }
+    m_expenseMonths.reserve(m_expenseMonths.size() + putBack.size());
+    for (const auto& expense : putBack) {
+        insertExpenseLocked(expense);
+    }
+    
+    if (hadCategory) {
+        size_t index = categoryNamed(fromCategory.name) - m_categories->begin();
+        std::vector<Category>& categories = mutableCategories();
+        if (hasCategory) {
+            categories[index] = toCategory;
+            renameCategoryLocked(fromCategory.name, toCategory.name);
+        } else {
+            categories.erase(categories.begin() + index);
+            const std::string& name = fromCategory.name;
+            auto dropped = std::stable_partition(m_budgets.begin(), m_budgets.end(),
+                                                 [&name](const Budget& budget) { return budget.category != name; });
+            edit.budgets.assign(dropped, m_budgets.end());
+            m_budgets.erase(dropped, m_budgets.end());
+        }
+    } else if (hasCategory) {
+        std::vector<Category>& categories = mutableCategories();
+        categories.insert(categories.begin() + std::min(edit.categoryIndex, categories.size()), toCategory);
+        m_budgets.insert(m_budgets.end(), edit.budgets.begin(), edit.budgets.end());
+        edit.budgets.clear();
+    }
+    
+    if (reverse) {
+        edit.inserted = std::move(undone);
+        edit.insertedIds.clear();
     } else {
-        initializeDefaultCategories();
-        saveData();
+        edit.insertedIds.clear();
+        for (const auto& expense : edit.inserted) {
+            edit.insertedIds.push_back(expense.id);
+        }
+        edit.inserted = std::vector<Expense>();
     }
+    collectBudgetAlertsLocked(budgets, alerts);
+    return true;
 }
 
-ExpenseManager::~ExpenseManager()
-{
-    saveData();
-}
-
-void ExpenseManager::initializeDefaultCategories()
-{
-    m_categories.push_back(Category("Food", "Groceries, restaurants, etc."));
-    m_categories.push_back(Category("Housing", "Rent, mortgage, repairs"));
-    m_categories.push_back(Category("Transportation", "Public transit, car expenses"));
-    m_categories.push_back(Category("Utilities", "Electricity, water, internet"));
-    m_categories.push_back(Category("Entertainment", "Movies, games, hobbies"));
-    m_categories.push_back(Category("Health", "Medical expenses, insurance"));
-    m_categories.push_back(Category("Personal", "Clothing, grooming"));
-    m_categories.push_back(Category("Education", "Books, courses, tuition"));
-    m_categories.push_back(Category("Miscellaneous", "Other expenses"));
-}
-
-int ExpenseManager::getNextExpenseId()
-{
-    return m_nextExpenseId++;
-}
-
-bool ExpenseManager::addExpense(const Expense& expense)
+bool ExpenseManager::addRecurringRule(const RecurringRule& rule)
 {
-    Expense newExpense = expense;
-    newExpense.id = getNextExpenseId();
-    m_expenses.push_back(newExpense);
-    return saveData();
+    PFM_SCOPED_TIMER("ExpenseManager::addRecurringRule");
+    std::vector<BudgetAlert> alerts;
+    bool saved;
+    {
+        std::unique_lock<SharedMutex> lock(m_mutex);
+        if (refuseEditLocked()) {
+            return false;
+        }
+        bool knownCategory = std::any_of(m_categories->begin(), m_categories->end(),
+                                         [&rule](const Category& c) { return c.name == rule.category; });
+        if (!rule.isValid() || !knownCategory) {
+            return false;
+        }
+        
+        RecurringRule newRule = rule;
+        newRule.id = m_nextRuleId++;
+        newRule.materializedThrough.clear();
+        m_recurringRules.push_back(newRule);
+        
+        // Occurrences that are already due are stored right away
+        size_t added;
+        materializeRecurringLocked(DateUtils::today(), added, alerts);
+        saved = saveDataLocked();
+        evictColdPartitionsLocked();
+    }
+    
+    dispatchBudgetAlerts(alerts);
+    return saved;
 }
 
-bool ExpenseManager::updateExpense(int id, const Expense& expense)
+bool ExpenseManager::updateRecurringRule(int id, const RecurringRule& rule)
 {
-    auto it = std::find_if(m_expenses.begin(), m_expenses.end(), 
-                          [id](const Expense& e) { return e.id == id; });
-    
-    if (it != m_expenses.end()) {
-        *it = expense;
-        it->id = id;  // Preserve the original ID
-        return saveData();
+    PFM_SCOPED_TIMER("ExpenseManager::updateRecurringRule");
+    std::vector<BudgetAlert> alerts;
+    bool saved;
+    {
+        std::unique_lock<SharedMutex> lock(m_mutex);
+        if (refuseEditLocked()) {
+            return false;
+        }
+        auto it = std::find_if(m_recurringRules.begin(), m_recurringRules.end(),
+                               [id](const RecurringRule& r) { return r.id == id; });
+        bool knownCategory = std::any_of(m_categories->begin(), m_categories->end(),
+                                         [&rule](const Category& c) { return c.name == rule.category; });
+        if (it == m_recurringRules.end() || !rule.isValid() || !knownCategory) {
+            return false;
+        }
+        
+        // Keep the catch-up position: a new schedule only applies from there on
+        std::string materializedThrough = it->materializedThrough;
+        *it = rule;
+        it->id = id;
+        it->materializedThrough = materializedThrough;
+        
+        size_t added;
+        materializeRecurringLocked(DateUtils::today(), added, alerts);
+        saved = saveDataLocked();
+        evictColdPartitionsLocked();
     }
     
-    return false;
+    dispatchBudgetAlerts(alerts);
+    return saved;
 }
 
-bool ExpenseManager::deleteExpense(int id)
+bool ExpenseManager::deleteRecurringRule(int id)
 {
-    auto it = std::find_if(m_expenses.begin(), m_expenses.end(), 
-                          [id](const Expense& e) { return e.id == id; });
+    std::unique_lock<SharedMutex> lock(m_mutex);
+    if (refuseEditLocked()) {
+        return false;
+    }
+    auto it = std::find_if(m_recurringRules.begin(), m_recurringRules.end(),
+                           [id](const RecurringRule& rule) { return rule.id == id; });
     
-    if (it != m_expenses.end()) {
-        m_expenses.erase(it);
-        return saveData();
+    if (it != m_recurringRules.end()) {
+        m_recurringRules.erase(it);
+        return saveDataLocked();
     }
     
     return false;
 }
 
-std::vector<Expense> ExpenseManager::getAllExpenses() const
+std::vector<RecurringRule> ExpenseManager::getRecurringRules() const
 {
-    return m_expenses;
+    std::shared_lock<SharedMutex> lock(m_mutex);
+    return m_recurringRules;
 }
 
-std::vector<Expense> ExpenseManager::getExpensesByMonth(int year, int month) const
+size_t ExpenseManager::materializeRecurring(const std::string& throughDate)
 {
-    std::vector<Expense> result;
+    PFM_SCOPED_TIMER("ExpenseManager::materializeRecurring");
+    {
+        // Usually every rule is caught up already; check without blocking readers
+        std::shared_lock<SharedMutex> lock(m_mutex);
+        bool due = std::any_of(m_recurringRules.begin(), m_recurringRules.end(),
+                               [&throughDate](const RecurringRule& rule) {
+                                   return rule.materializedThrough < throughDate;
+                               });
+        if (!due) {
+            return 0;
+        }
+    }
     
-    for (const auto& expense : m_expenses) {
-        std::tm tm = {};
-        std::istringstream ss(expense.date);
-        ss >> std::get_time(&tm, "%Y-%m-%d");
-        
-        if (tm.tm_year + 1900 == year && tm.tm_mon + 1 == month) {
-            result.push_back(expense);
+    std::vector<BudgetAlert> alerts;
+    size_t added = 0;
+    {
+        std::unique_lock<SharedMutex> lock(m_mutex);
+        if (m_readOnly) {
+            return 0;  // Caught up once recovery has run
+        }
+        if (materializeRecurringLocked(throughDate, added, alerts)) {
+            saveDataLocked();
+            evictColdPartitionsLocked();
         }
     }
     
-    return result;
+    dispatchBudgetAlerts(alerts);
+    return added;
 }
 
-std::vector<Expense> ExpenseManager::getExpensesByCategory(const std::string& category) const
+bool ExpenseManager::materializeRecurringLocked(const std::string& throughDate, size_t& added,
+                                                std::vector<BudgetAlert>& alerts)
 {
-    std::vector<Expense> result;
+    added = 0;
+    if (!DateUtils::isValidDate(throughDate)) {
+        return false;
+    }
     
-    for (const auto& expense : m_expenses) {
-        if (expense.category == category) {
-            result.push_back(expense);
+    // Everything due since each rule's last catch-up, however long the gap,
+    // goes in as one batch with a single save
+    std::vector<Expense> due;
+    bool advanced = false;
+    for (const auto& rule : m_recurringRules) {
+        if (rule.materializedThrough >= throughDate) {
+            continue;
+        }
+        
+        std::string from = rule.materializedThrough.empty() ? rule.startDate
+                                                            : DateUtils::addDays(rule.materializedThrough, 1);
+        for (const auto& date : rule.occurrences(from, throughDate)) {
+            due.push_back(rule.occurrence(date, false));
         }
+        advanced = true;
     }
     
-    return result;
-}
-
-bool ExpenseManager::addCategory(const Category& category)
-{
-    auto it = std::find_if(m_categories.begin(), m_categories.end(), 
-                          [&category](const Category& c) { return c.name == category.name; });
-    
-    if (it == m_categories.end()) {
-        m_categories.push_back(category);
-        return saveData();
+    if (!advanced) {
+        return false;
     }
     
-    return false;
-}
-
-bool ExpenseManager::updateCategory(const std::string& name, const Category& category)
-{
-    auto it = std::find_if(m_categories.begin(), m_categories.end(), 
-                          [&name](const Category& c) { return c.name == name; });
+    // Oldest first so ids follow the dates. Occurrences of a rule repeat by
+    // design, so they bypass duplicate detection: a weekly rule under a 7-day
+    // window would otherwise match itself, and the catch-up never retries.
+    std::stable_sort(due.begin(), due.end(), [](const Expense& a, const Expense& b) { return a.date < b.date; });
+    std::vector<Expense> inserted;
+    if (!due.empty() && !addExpensesLocked(due, alerts, nullptr, &inserted, false)) {
+        return false;  // A partition is unreadable; the next catch-up retries
+    }
     
-    if (it != m_categories.end()) {
-        *it = category;
-        return saveData();
+    for (auto& rule : m_recurringRules) {
+        rule.materializedThrough = std::max(rule.materializedThrough, throughDate);
     }
     
-    return false;
+    added = inserted.size();
+    return true;
 }
 
-bool ExpenseManager::deleteCategory(const std::string& name)
+std::vector<Expense> ExpenseManager::projectRecurringLocked(const std::string& fromDate,
+                                                            const std::string& toDate) const
 {
-    auto it = std::find_if(m_categories.begin(), m_categories.end(), 
-                          [&name](const Category& c) { return c.name == name; });
+    std::vector<Expense> projected;
+    if (m_recurringRules.empty()) {
+        return projected;
+    }
     
-    if (it != m_categories.end()) {
-        // Check if any expenses use this category
-        bool categoryInUse = std::any_of(m_expenses.begin(), m_expenses.end(),
-                                        [&name](const Expense& e) { return e.category == name; });
+    std::string to = toDate.empty() ? DateUtils::addDays(DateUtils::today(), kProjectionHorizonDays) : toDate;
+    for (const auto& rule : m_recurringRules) {
+        // Only what the catch-up has not stored yet
+        std::string from = fromDate;
+        if (!rule.materializedThrough.empty()) {
+            from = std::max(from, DateUtils::addDays(rule.materializedThrough, 1));
+        }
         
-        if (!categoryInUse) {
-            m_categories.erase(it);
-            return saveData();
+        for (const auto& date : rule.occurrences(from, to)) {
+            projected.push_back(rule.occurrence(date, true));
         }
     }
     
-    return false;
+    return projected;
 }
 
-std::vector<Category> ExpenseManager::getAllCategories() const
+std::vector<Expense> ExpenseManager::projectMonthLocked(int year, int month) const
 {
-    return m_categories;
+    if (month < 1 || month > 12 || m_recurringRules.empty()) {
+        return std::vector<Expense>();
+    }
+    
+    return projectRecurringLocked(DateUtils::formatDate(year, month, 1),
+                                  DateUtils::formatDate(year, month, DateUtils::daysInMonth(year, month)));
 }
 
 std::map<std::string, double> ExpenseManager::generateCategorySummary(int year, int month) const
 {
+    PFM_SCOPED_TIMER("ExpenseManager::generateCategorySummary");
+    std::shared_lock<SharedMutex> lock(m_mutex);
     std::map<std::string, double> summary;
     
     // Initialize with all categories at 0
-    for (const auto& category : m_categories) {
+    for (const auto& category : *m_categories) {
         summary[category.name] = 0.0;
     }
     
-    // Sum up expenses for each category
-    for (const auto& expense : getExpensesByMonth(year, month)) {
+    // Add the running totals for the month
+    auto totals = m_monthTotals.find(DateUtils::monthKey(year, month));
+    if (totals != m_monthTotals.end()) {
+        for (const auto& entry : totals->second) {
+            summary[entry.first] += entry.second.amount;
+        }
+    }
+    
+    for (const auto& expense : projectMonthLocked(year, month)) {
         summary[expense.category] += expense.amount;
     }
     
@@ -185,51 +2232,253 @@ std::map<std::string, double> ExpenseManager::generateCategorySummary(int year,
 
 double ExpenseManager::getTotalExpenses(int year, int month) const
 {
+    PFM_SCOPED_TIMER("ExpenseManager::getTotalExpenses");
+    std::shared_lock<SharedMutex> lock(m_mutex);
     double total = 0.0;
     
-    for (const auto& expense : getExpensesByMonth(year, month)) {
+    auto totals = m_monthTotals.find(DateUtils::monthKey(year, month));
+    if (totals != m_monthTotals.end()) {
+        for (const auto& entry : totals->second) {
+            total += entry.second.amount;
+        }
+    }
+    
+    for (const auto& expense : projectMonthLocked(year, month)) {
         total += expense.amount;
     }
     
     return total;
 }
 
+std::shared_ptr<const LedgerSnapshot> ExpenseManager::snapshot() const
+{
+    PFM_SCOPED_TIMER("ExpenseManager::snapshot");
+    return readYears(kFirstYear, kLastYear, [this]() {
+        // Copies one pointer per month; the chunks themselves are shared
+        LedgerSnapshot::ChunkMap chunks;
+        for (const auto& entry : m_chunks) {
+            chunks.emplace_hint(chunks.end(), entry.first, entry.second);
+        }
+        
+        ++m_snapshotGeneration;
+        return std::make_shared<const LedgerSnapshot>(std::move(chunks), m_categories);
+    });
+}
+
+void ExpenseManager::setMemoryBudget(size_t bytes)
+{
+    std::unique_lock<SharedMutex> lock(m_mutex);
+    m_memoryBudget = bytes;
+    evictColdPartitionsLocked();
+}
+
+size_t ExpenseManager::getMemoryBudget() const
+{
+    std::shared_lock<SharedMutex> lock(m_mutex);
+    return m_memoryBudget;
+}
+
+void ExpenseManager::setSharedMemoryBudget(std::shared_ptr<MemoryBudget> budget)
+{
+    std::unique_lock<SharedMutex> lock(m_mutex);
+    if (m_sharedBudget) {
+        m_sharedBudget->update(m_reportedBytes, 0);
+    }
+    m_sharedBudget = budget;
+    m_reportedBytes = 0;
+    evictColdPartitionsLocked();
+}
+
+void ExpenseManager::setThreadPool(ThreadPool* pool)
+{
+    m_threadPool = pool;
+}
+
+ThreadPool* ExpenseManager::threadPool() const
+{
+    return m_threadPool;
+}
+
+size_t ExpenseManager::getCachedBytes() const
+{
+    std::shared_lock<SharedMutex> lock(m_mutex);
+    size_t bytes = 0;
+    for (const auto& entry : m_partitions) {
+        if (entry.second.loaded) {
+            bytes += entry.second.expenseCount * kApproxExpenseBytes;
+        }
+    }
+    return bytes;
+}
+
+std::vector<int> ExpenseManager::getLoadedYears() const
+{
+    std::shared_lock<SharedMutex> lock(m_mutex);
+    std::vector<int> years;
+    
+    for (const auto& entry : m_partitions) {
+        if (entry.second.loaded) {
+            years.push_back(entry.first);
+        }
+    }
+    
+    return years;
+}
+
 bool ExpenseManager::saveData()
 {
+    std::unique_lock<SharedMutex> lock(m_mutex);
+    return saveDataLocked();
+}
+
+bool ExpenseManager::writePartitionLocked(int year)
+{
+    PFM_SCOPED_TIMER("ExpenseManager::writePartition");
+    YearPartition& partition = m_partitions[year];
+    auto first = m_chunks.lower_bound(firstKeyOfYear(year));
+    auto last = m_chunks.upper_bound(lastKeyOfYear(year));
+    
+    // Never over a file the manifest on disk lists; that one goes once a new manifest is written
+    std::string fileName = partitionFileName(year);
+    
+    std::string bytes;
+    if (m_storageFormat == StorageFormat::Compact) {
+        std::vector<const ExpenseChunk*> chunks;
+        for (auto chunk = first; chunk != last; ++chunk) {
+            chunks.push_back(chunk->second.get());
+        }
+        bytes = PartitionCodec::encode(chunks);
+    } else {
+        json j;
+        j["year"] = year;
+        j["expenses"] = json::array();
+        for (auto chunk = first; chunk != last; ++chunk) {
+            for (const auto& expense : *chunk->second) {
+                j["expenses"].push_back(expenseToJson(expense));
+            }
+        }
+        bytes = j.dump(4) + "\n";
+    }
+    if (!FileUtils::writeAtomically(partitionPath(fileName), bytes)) {
+        return false;
+    }
+    
+    // Compact files checksum their own blocks; JSON ones are checked against the manifest
+    partition.hasChecksum = m_storageFormat == StorageFormat::Json;
+    partition.checksum = partition.hasChecksum ? Crc32c::compute(bytes.data(), bytes.size()) : 0;
+    
+    if (fileName != partition.fileName) {
+        m_obsoleteFiles.push_back(partition.fileName);
+        partition.fileName = fileName;
+    }
+    partition.dirty = false;
+    return true;
+}
+
+bool ExpenseManager::saveDataLocked()
+{
+    PFM_SCOPED_TIMER("ExpenseManager::saveData");
+    if (m_readOnly) {
+        std::cerr << "Not saving " << m_dataFilePath << ": it could not be read; run recovery first" << std::endl;
+        return false;
+    }
+    
     try {
+        // Only partitions changed since the last save are rewritten. If one
+        // fails, the manifest is not written either, so the one on disk still
+        // matches the files it lists.
+        for (auto it = m_partitions.begin(); it != m_partitions.end();) {
+            YearPartition& partition = it->second;
+            if (partition.loaded && partition.dirty && partition.expenseCount == 0) {
+                m_obsoleteFiles.push_back(partition.fileName);
+                it = m_partitions.erase(it);
+                continue;
+            }
+            if (partition.loaded && partition.dirty && !writePartitionLocked(it->first)) {
+                std::cerr << "Error saving partition " << it->first << " of " << m_dataFilePath << std::endl;
+                return false;
+            }
+            ++it;
+        }
+        
         json j;
+        j["format"] = 2;
+        j["generation"] = m_saveGeneration + 1;
         
-        // Save expenses
-        j["expenses"] = json::array();
-        for (const auto& expense : m_expenses) {
-            j["expenses"].push_back({
-                {"id", expense.id},
-                {"amount", expense.amount},
-                {"description", expense.description},
-                {"category", expense.category},
-                {"date", expense.date}
-            });
+        // Save partitions with their month totals
+        j["partitions"] = json::array();
+        for (const auto& entry : m_partitions) {
+            json months = json::object();
+            for (auto month = m_monthTotals.lower_bound(firstKeyOfYear(entry.first));
+                 month != m_monthTotals.end() && month->first <= lastKeyOfYear(entry.first); ++month) {
+                json totals = json::object();
+                for (const auto& total : month->second) {
+                    totals[total.first] = {total.second.amount, total.second.count};
+                }
+                months[std::to_string(month->first)] = totals;
+            }
+            
+            json partitionJson = {
+                {"year", entry.first},
+                {"file", entry.second.fileName},
+                {"count", entry.second.expenseCount},
+                {"months", months}
+            };
+            if (entry.second.hasChecksum) {
+                partitionJson["crc"] = entry.second.checksum;
+            }
+            if (entry.second.minId <= entry.second.maxId) {
+                partitionJson["ids"] = {entry.second.minId, entry.second.maxId};
+            }
+            j["partitions"].push_back(partitionJson);
         }
         
         // Save categories
         j["categories"] = json::array();
-        for (const auto& category : m_categories) {
+        for (const auto& category : *m_categories) {
             j["categories"].push_back({
                 {"name", category.name},
                 {"description", category.description}
             });
         }
         
-        // Save next expense ID
+        // Save budgets
+        j["budgets"] = json::array();
+        for (const auto& budget : m_budgets) {
+            j["budgets"].push_back(budgetToJson(budget));
+        }
+        
+        // Save recurring rules
+        j["recurring"] = json::array();
+        for (const auto& rule : m_recurringRules) {
+            j["recurring"].push_back(recurringRuleToJson(rule));
+        }
+        
+        // Save duplicate detection settings
+        j["duplicates"] = {
+            {"policy", duplicatePolicyName(m_duplicatePolicy)},
+            {"windowDays", m_duplicateWindow}
+        };
+        
+        // Save next expense and rule IDs
         j["nextExpenseId"] = m_nextExpenseId;
+        j["nextRuleId"] = m_nextRuleId;
+        j["storage"] = m_storageFormat == StorageFormat::Compact ? "compact" : "json";
         
-        // Write to file
-        std::ofstream file(m_dataFilePath);
-        if (!file.is_open()) {
+        // Write to file; the manifest stays JSON, minified in compact mode
+        std::string bytes = (m_storageFormat == StorageFormat::Compact ? j.dump() : j.dump(4)) + "\n";
+        if (!FileUtils::writeAtomically(m_dataFilePath, bytes)) {
+            std::cerr << "Error saving " << m_dataFilePath << "; the previous save is kept" << std::endl;
             return false;
         }
         
-        file << std::setw(4) << j << std::endl;
+        // Committed; the files it replaced can go
+        ++m_saveGeneration;
+        for (const auto& fileName : m_obsoleteFiles) {
+            std::error_code error;
+            fs::remove(partitionPath(fileName), error);
+        }
+        m_obsoleteFiles.clear();
         return true;
     } catch (const std::exception& e) {
         std::cerr << "Error saving data: " << e.what() << std::endl;
@@ -238,6 +2487,269 @@ bool ExpenseManager::saveData()
 }
 
 bool ExpenseManager::loadData()
+{
+    PFM_SCOPED_TIMER("ExpenseManager::loadData");
+    std::unique_lock<SharedMutex> lock(m_mutex);
+    return loadDataLocked();
+}
+
+bool ExpenseManager::setStorageFormat(StorageFormat format)
+{
+    PFM_SCOPED_TIMER("ExpenseManager::setStorageFormat");
+    std::unique_lock<SharedMutex> lock(m_mutex);
+    if (refuseEditLocked()) {
+        return false;
+    }
+    if (format == m_storageFormat) {
+        return true;
+    }
+    
+    // Converted one year at a time, so the rewrite stays within the memory
+    // budget. A partition that fails keeps its old file and is still readable.
+    m_storageFormat = format;
+    bool success = true;
+    for (auto& entry : m_partitions) {
+        if (entry.second.expenseCount == 0) {
+            continue;  // Removed by the save below if it was emptied
+        }
+        if (!loadYearLocked(entry.first) || !writePartitionLocked(entry.first)) {
+            success = false;
+        }
+        evictColdPartitionsLocked();
+    }
+    
+    return saveDataLocked() && success;
+}
+
+StorageFormat ExpenseManager::getStorageFormat() const
+{
+    std::shared_lock<SharedMutex> lock(m_mutex);
+    return m_storageFormat;
+}
+
+StorageReport ExpenseManager::verifyStorage() const
+{
+    PFM_SCOPED_TIMER("ExpenseManager::verifyStorage");
+    std::shared_lock<SharedMutex> lock(m_mutex);
+    StorageReport report;
+    report.manifestReadable = !m_readOnly;
+    
+    // Without a manifest, check whatever partition files are there
+    std::map<int, YearPartition> found;
+    std::vector<std::pair<int, const YearPartition*>> partitions;
+    if (m_readOnly) {
+        for (const auto& file : findPartitionFiles(m_dataFilePath)) {
+            found[file.first].fileName = file.second;
+        }
+        for (const auto& entry : found) {
+            partitions.push_back(std::make_pair(entry.first, &entry.second));
+        }
+    } else {
+        for (const auto& entry : m_partitions) {
+            partitions.push_back(std::make_pair(entry.first, &entry.second));
+        }
+    }
+    
+    // Every file is read once, so spread them over threads
+    report.partitions.resize(partitions.size());
+    unsigned int threads = parallelism();
+    threads = static_cast<unsigned int>(std::max<size_t>(1, std::min<size_t>(threads, partitions.size())));
+    runParallel(threads, [&](unsigned int thread) {
+        for (size_t i = thread; i < partitions.size(); i += threads) {
+            report.partitions[i] = checkPartitionLocked(partitions[i].first, *partitions[i].second);
+        }
+    });
+    return report;
+}
+
+PartitionHealth ExpenseManager::checkPartitionLocked(int year, const YearPartition& partition) const
+{
+    PartitionHealth health;
+    health.year = year;
+    health.fileName = partition.fileName;
+    health.expectedRows = partition.expenseCount;
+    
+    std::string bytes;
+    if (!readFile(partitionPath(partition.fileName), bytes)) {
+        // A year added since the last failed save has no file yet, but its rows are in memory
+        health.status = partition.loaded && partition.dirty ? PartitionStatus::Ok : PartitionStatus::Missing;
+        return health;
+    }
+    PFM_COUNTER_ADD("storage.bytes_read", bytes.size());
+    
+    bool compact = PartitionCodec::isCompact(bytes) || fs::path(partition.fileName).extension() == ".pfmc";
+    if (compact) {
+        health.status = PartitionCodec::check(bytes).intact() ? PartitionStatus::Ok : PartitionStatus::Damaged;
+    } else if (partition.hasChecksum) {
+        health.status = Crc32c::compute(bytes.data(), bytes.size()) == partition.checksum ? PartitionStatus::Ok
+                                                                                        : PartitionStatus::Damaged;
+    } else {
+        // Written before checksums; all that can be checked is that it parses
+        health.status = json::accept(bytes) ? PartitionStatus::Unverified : PartitionStatus::Damaged;
+    }
+    if (health.status != PartitionStatus::Damaged) {
+        return health;
+    }
+    
+    // Months that read back fewer rows than the manifest counted
+    std::map<int, int> readable;
+    for (const auto& expense : salvageRows(bytes, compact)) {
+        ++readable[DateUtils::monthKey(expense.date)];
+    }
+    for (auto month = m_monthTotals.lower_bound(firstKeyOfYear(year));
+         month != m_monthTotals.end() && month->first <= lastKeyOfYear(year); ++month) {
+        int expected = 0;
+        for (const auto& total : month->second) {
+            expected += total.second.count;
+        }
+        if (readable[month->first] < expected) {
+            health.damagedMonths.push_back(month->first);
+        }
+    }
+    return health;
+}
+
+RecoveryReport ExpenseManager::recoverData()
+{
+    PFM_SCOPED_TIMER("ExpenseManager::recoverData");
+    std::unique_lock<SharedMutex> lock(m_mutex);
+    RecoveryReport report;
+    
+    std::string backupPath;
+    int lastId = 0;
+    auto noteIds = [this, &lastId](int year) {
+        for (auto chunk = m_chunks.lower_bound(firstKeyOfYear(year));
+             chunk != m_chunks.end() && chunk->first <= lastKeyOfYear(year); ++chunk) {
+            if (!chunk->second->empty()) {
+                lastId = std::max(lastId, chunk->second->back().id);
+            }
+        }
+    };
+    
+    if (m_readOnly) {
+        if (backupFile(m_dataFilePath, backupPath)) {
+            report.backups.push_back(backupPath);
+        }
+        rebuildPartitionListLocked();
+        report.manifestRebuilt = true;
+        m_readOnly = false;
+    }
+    
+    for (auto it = m_partitions.begin(); it != m_partitions.end();) {
+        int year = it->first;
+        YearPartition& partition = it->second;
+        ++it;
+        if (partition.loaded) {
+            continue;
+        }
+        
+        // A rebuilt manifest has no month totals yet, so every year is loaded
+        // once to count it; otherwise only damaged files are touched
+        PartitionStatus status = report.manifestRebuilt ? PartitionStatus::Damaged
+                                                        : checkPartitionLocked(year, partition).status;
+        if (status == PartitionStatus::Ok || status == PartitionStatus::Unverified) {
+            continue;
+        }
+        partition.failed = false;
+        if (report.manifestRebuilt && loadYearLocked(year)) {
+            noteIds(year);
+            evictColdPartitionsLocked();
+            continue;
+        }
+        
+        std::string path = partitionPath(partition.fileName);
+        std::string bytes;
+        std::vector<Expense> expenses;
+        if (readFile(path, bytes)) {
+            expenses = salvageRows(bytes, PartitionCodec::isCompact(bytes) ||
+                                              fs::path(partition.fileName).extension() == ".pfmc");
+            if (backupFile(path, backupPath)) {
+                report.backups.push_back(backupPath);
+            }
+        }
+        
+        // Whatever was read becomes the partition, written out again on save
+        m_monthTotals.erase(m_monthTotals.lower_bound(firstKeyOfYear(year)),
+                            m_monthTotals.upper_bound(lastKeyOfYear(year)));
+        bulkIndexLocked(expenses);
+        noteIds(year);
+        if (!report.manifestRebuilt && partition.expenseCount > expenses.size()) {
+            report.rowsLost += partition.expenseCount - expenses.size();
+        }
+        report.rowsRecovered += expenses.size();
+        partition.minId = std::numeric_limits<int>::max();
+        partition.maxId = std::numeric_limits<int>::min();
+        for (const auto& expense : expenses) {
+            partition.noteId(expense.id);
+        }
+        partition.expenseCount = expenses.size();
+        partition.loaded = true;
+        partition.dirty = true;
+        partition.failed = false;
+    }
+    
+    // Ids carry on after the highest one found, and every category in use is kept
+    m_nextExpenseId = std::max(m_nextExpenseId, lastId + 1);
+    if (report.manifestRebuilt) {
+        std::vector<Category>& categories = mutableCategories();
+        for (const auto& month : m_monthTotals) {
+            for (const auto& total : month.second) {
+                bool known = std::any_of(categories.begin(), categories.end(),
+                                         [&total](const Category& category) { return category.name == total.first; });
+                if (!known) {
+                    categories.push_back(Category(total.first, ""));
+                }
+            }
+        }
+    }
+    m_undoLog.clear();
+    m_redoLog.clear();
+    
+    if (!saveDataLocked()) {
+        std::cerr << "Error saving recovered data to " << m_dataFilePath << std::endl;
+    }
+    return report;
+}
+
+void ExpenseManager::rebuildPartitionListLocked()
+{
+    clearLedgerLocked();
+    initializeDefaultCategories();
+    
+    bool compact = false;
+    for (const auto& file : findPartitionFiles(m_dataFilePath)) {
+        m_partitions[file.first].fileName = file.second;
+        compact = compact || fs::path(file.second).extension() == ".pfmc";
+    }
+    m_storageFormat = compact ? StorageFormat::Compact : StorageFormat::Json;
+    
+    // Later saves must not reuse a name on disk, and the files passed over go
+    // once the rebuilt manifest is written
+    for (const auto& file : listPartitionFiles(m_dataFilePath)) {
+        m_saveGeneration = std::max(m_saveGeneration, file.generation);
+        if (m_partitions[file.year].fileName != file.name) {
+            m_obsoleteFiles.push_back(file.name);
+        }
+    }
+}
+
+// Edits are refused up front rather than at save time, so a read-only session
+// never shows changes that would vanish on restart
+bool ExpenseManager::refuseEditLocked() const
+{
+    if (m_readOnly) {
+        std::cerr << "Not editing " << m_dataFilePath << ": it could not be read; run recovery first" << std::endl;
+    }
+    return m_readOnly;
+}
+
+bool ExpenseManager::isReadOnly() const
+{
+    std::shared_lock<SharedMutex> lock(m_mutex);
+    return m_readOnly;
+}
+
+bool ExpenseManager::loadDataLocked()
 {
     try {
         std::ifstream file(m_dataFilePath);
@@ -248,36 +2760,137 @@ bool ExpenseManager::loadData()
         json j;
         file >> j;
         
-        // Load expenses
-        m_expenses.clear();
-        for (const auto& expenseJson : j["expenses"]) {
-            Expense expense;
-            expense.id = expenseJson["id"].get<int>();
-            expense.amount = expenseJson["amount"].get<double>();
-            expense.description = expenseJson["description"].get<std::string>();
-            expense.category = expenseJson["category"].get<std::string>();
-            expense.date = expenseJson["date"].get<std::string>();
-            m_expenses.push_back(expense);
-        }
+        clearLedgerLocked();
+        m_readOnly = false;
         
         // Load categories
-        m_categories.clear();
         for (const auto& categoryJson : j["categories"]) {
             Category category;
             category.name = categoryJson["name"].get<std::string>();
             category.description = categoryJson["description"].get<std::string>();
-            m_categories.push_back(category);
+            m_categories->push_back(category);
         }
         
+        // Load budgets; older files have none
+        if (j.contains("budgets")) {
+            for (const auto& budgetJson : j["budgets"]) {
+                m_budgets.push_back(budgetFromJson(budgetJson));
+            }
+        }
+        
+        // Load recurring rules; older files have none
+        if (j.contains("recurring")) {
+            for (const auto& ruleJson : j["recurring"]) {
+                m_recurringRules.push_back(recurringRuleFromJson(ruleJson));
+            }
+            m_nextRuleId = j["nextRuleId"].get<int>();
+        }
+        
+        // Load duplicate detection settings; older files use the defaults
+        m_duplicatePolicy = DuplicatePolicy::Flag;
+        m_duplicateWindow = 0;
+        if (j.contains("duplicates")) {
+            std::string policy = j["duplicates"]["policy"].get<std::string>();
+            m_duplicatePolicy = policy == "allow" ? DuplicatePolicy::Allow
+                              : policy == "reject" ? DuplicatePolicy::Reject : DuplicatePolicy::Flag;
+            m_duplicateWindow = j["duplicates"]["windowDays"].get<int>();
+        }
+        
+        // Storage format for later writes; older files are JSON
+        m_storageFormat = j.contains("storage") && j["storage"].get<std::string>() == "compact"
+                              ? StorageFormat::Compact : StorageFormat::Json;
+        
         // Load next expense ID
         m_nextExpenseId = j["nextExpenseId"].get<int>();
         
-        return true;
+        if (j.contains("expenses")) {
+            return loadLegacyLocked(j);
+        }
+        
+        // Load the partition list and month totals; rows stay on disk for now
+        m_saveGeneration = j.contains("generation") ? j["generation"].get<uint64_t>() : 0;
+        for (const auto& partitionJson : j["partitions"]) {
+            int year = partitionJson["year"].get<int>();
+            YearPartition& partition = m_partitions[year];
+            partition.fileName = partitionJson["file"].get<std::string>();
+            partition.expenseCount = partitionJson["count"].get<size_t>();
+            if (partitionJson.contains("crc")) {
+                partition.hasChecksum = true;
+                partition.checksum = partitionJson["crc"].get<uint32_t>();
+            }
+            
+            // Older manifests have no id range; any id may be in the partition
+            if (partitionJson.contains("ids")) {
+                partition.minId = partitionJson["ids"][0].get<int>();
+                partition.maxId = partitionJson["ids"][1].get<int>();
+            } else {
+                partition.minId = std::numeric_limits<int>::min();
+                partition.maxId = std::numeric_limits<int>::max();
+            }
+            
+            for (const auto& month : partitionJson["months"].items()) {
+                std::map<std::string, CategoryTotal>& totals = m_monthTotals[std::stoi(month.key())];
+                for (const auto& total : month.value().items()) {
+                    totals[total.key()].amount = total.value()[0].get<double>();
+                    totals[total.key()].count = total.value()[1].get<int>();
+                }
+            }
+        }
+        
+        removeUnlistedPartitionFilesLocked();
+        return loadYearLocked(DateUtils::currentYear());
     } catch (const std::exception& e) {
         std::cerr << "Error loading data: " << e.what() << std::endl;
         
-        // Initialize with default categories if loading fails
+        // Work from the default categories in memory, but leave the files alone
+        // so recoverData() still has everything that was readable
+        clearLedgerLocked();
         initializeDefaultCategories();
+        m_readOnly = true;
         return false;
     }
-}
\ No newline at end of file
+}
+
+void ExpenseManager::clearLedgerLocked()
+{
+    // Drop everything cached; snapshots keep the previous chunks alive on their own
+    m_chunks.clear();
+    m_expenseMonths.clear();
+    m_searchIndex.clear();
+    m_duplicateIndex.clear();
+    m_partitions.clear();
+    m_monthTotals.clear();
+    m_obsoleteFiles.clear();  // Names from a save that was never committed may be listed again
+    m_undoLog.clear();  // Logged rows may no longer match what is on disk
+    m_redoLog.clear();
+    
+    m_categories = std::make_shared<std::vector<Category>>();
+    m_ownsCategories = true;
+    m_budgets.clear();
+    m_recurringRules.clear();
+    m_duplicatePolicy = DuplicatePolicy::Flag;
+    m_duplicateWindow = 0;
+    m_nextExpenseId = 1;
+    m_nextRuleId = 1;
+}
+
+bool ExpenseManager::loadLegacyLocked(const json& j)
+{
+    // Single-file ledger from before partitioning: load it all and mark every
+    // year dirty so the next save writes the partitioned layout
+    std::vector<Expense> expenses;
+    expenses.reserve(j["expenses"].size());
+    for (const auto& expenseJson : j["expenses"]) {
+        expenses.push_back(expenseFromJson(expenseJson));
+    }
+    
+    bulkIndexLocked(expenses);
+    for (const auto& expense : expenses) {
+        YearPartition& partition = partitionLocked(yearOfKey(DateUtils::monthKey(expense.date)));
+        partition.noteId(expense.id);
+        ++partition.expenseCount;
+        partition.dirty = true;
+    }
+    
+    return true;
+}
@@ -0,0 +1,31 @@
+#include "../../include/core/FileUtils.h"
+#include "../../include/core/Metrics.h"
+#include <filesystem>
+#include <fstream>
+
+namespace FileUtils {
+
+bool writeAtomically(const std::string& path, const std::string& bytes)
+{
+    std::string tempPath = path + ".tmp";
+    std::ofstream file(tempPath, std::ios::binary);
+    if (!file.is_open()) {
+        return false;
+    }
+    file.write(bytes.data(), bytes.size());
+    file.close();
+    if (!file) {
+        return false;
+    }
+    
+    std::error_code error;
+    std::filesystem::rename(tempPath, path, error);
+    if (error) {
+        std::filesystem::remove(tempPath, error);
+        return false;
+    }
+    PFM_COUNTER_ADD("storage.bytes_written", bytes.size());
+    return true;
+}
+
+} // namespace FileUtils
@@ -0,0 +1,77 @@
+#include "../../include/core/LedgerSnapshot.h"
+#include "../../include/core/DateUtils.h"
+
+LedgerSnapshot::LedgerSnapshot(ChunkMap chunks, std::shared_ptr<const std::vector<Category>> categories)
+    : m_chunks(std::move(chunks)), m_categories(std::move(categories)), m_expenseCount(0)
+{
+    for (const auto& entry : m_chunks) {
+        m_expenseCount += entry.second->size();
+    }
+}
+
+size_t LedgerSnapshot::expenseCount() const
+{
+    return m_expenseCount;
+}
+
+std::vector<Expense> LedgerSnapshot::getAllExpenses() const
+{
+    std::vector<Expense> result;
+    result.reserve(m_expenseCount);
+    forEachExpense([&result](const Expense& expense) { result.push_back(expense); });
+    return result;
+}
+
+std::vector<Expense> LedgerSnapshot::getExpensesByMonth(int year, int month) const
+{
+    auto it = m_chunks.find(DateUtils::monthKey(year, month));
+    return it != m_chunks.end() ? *it->second : std::vector<Expense>();
+}
+
+std::vector<Expense> LedgerSnapshot::getExpensesByCategory(const std::string& category) const
+{
+    std::vector<Expense> result;
+    forEachExpense([&](const Expense& expense) {
+        if (expense.category == category) {
+            result.push_back(expense);
+        }
+    });
+    return result;
+}
+
+const std::vector<Category>& LedgerSnapshot::getAllCategories() const
+{
+    return *m_categories;
+}
+
+std::map<std::string, double> LedgerSnapshot::generateCategorySummary(int year, int month) const
+{
+    std::map<std::string, double> summary;
+    
+    for (const auto& category : *m_categories) {
+        summary[category.name] = 0.0;
+    }
+    
+    auto it = m_chunks.find(DateUtils::monthKey(year, month));
+    if (it != m_chunks.end()) {
+        for (const auto& expense : *it->second) {
+            summary[expense.category] += expense.amount;
+        }
+    }
+    
+    return summary;
+}
+
+double LedgerSnapshot::getTotalExpenses(int year, int month) const
+{
+    double total = 0.0;
+    
+    auto it = m_chunks.find(DateUtils::monthKey(year, month));
+    if (it != m_chunks.end()) {
+        for (const auto& expense : *it->second) {
+            total += expense.amount;
+        }
+    }
+    
+    return total;
+}
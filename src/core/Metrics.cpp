@@ -0,0 +1,233 @@
+#include "../../include/core/Metrics.h"
+#include <nlohmann/json.hpp>
+#include <algorithm>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <thread>
+
+namespace {
+
+const size_t kMaxTraceEvents = 1000000;
+
+int bucketOf(uint64_t nanoseconds)
+{
+    int bucket = 0;
+    while (nanoseconds > 1 && bucket < LatencyHistogram::kBucketCount - 1) {
+        nanoseconds >>= 1;
+        ++bucket;
+    }
+    return bucket;
+}
+
+double toMilliseconds(uint64_t nanoseconds)
+{
+    return nanoseconds / 1e6;
+}
+}
+
+LatencyHistogram::LatencyHistogram()
+{
+    reset();
+}
+
+void LatencyHistogram::record(uint64_t nanoseconds)
+{
+    m_buckets[bucketOf(nanoseconds)].fetch_add(1, std::memory_order_relaxed);
+    m_totalNanoseconds.fetch_add(nanoseconds, std::memory_order_relaxed);
+    
+    uint64_t max = m_maxNanoseconds.load(std::memory_order_relaxed);
+    while (nanoseconds > max &&
+           !m_maxNanoseconds.compare_exchange_weak(max, nanoseconds, std::memory_order_relaxed)) {
+    }
+}
+
+LatencyStats LatencyHistogram::stats(const std::string& name) const
+{
+    LatencyStats stats;
+    stats.name = name;
+    
+    uint64_t buckets[kBucketCount];
+    uint64_t count = 0;
+    for (int i = 0; i < kBucketCount; ++i) {
+        buckets[i] = m_buckets[i].load(std::memory_order_relaxed);
+        count += buckets[i];
+    }
+    if (count == 0) {
+        return stats;
+    }
+    
+    uint64_t max = m_maxNanoseconds.load(std::memory_order_relaxed);
+    auto percentile = [&](double fraction) {
+        uint64_t rank = static_cast<uint64_t>(fraction * (count - 1)) + 1;
+        uint64_t seen = 0;
+        for (int i = 0; i < kBucketCount; ++i) {
+            seen += buckets[i];
+            if (seen >= rank) {
+                uint64_t upper = i < kBucketCount - 1 ? (uint64_t(2) << i) - 1 : max;
+                return toMilliseconds(std::min(upper, max));
+            }
+        }
+        return toMilliseconds(max);
+    };
+    
+    stats.count = count;
+    stats.totalMs = toMilliseconds(m_totalNanoseconds.load(std::memory_order_relaxed));
+    stats.meanMs = stats.totalMs / count;
+    stats.p50Ms = percentile(0.50);
+    stats.p90Ms = percentile(0.90);
+    stats.p99Ms = percentile(0.99);
+    stats.maxMs = toMilliseconds(max);
+    return stats;
+}
+
+void LatencyHistogram::reset()
+{
+    for (auto& bucket : m_buckets) {
+        bucket.store(0, std::memory_order_relaxed);
+    }
+    m_totalNanoseconds.store(0, std::memory_order_relaxed);
+    m_maxNanoseconds.store(0, std::memory_order_relaxed);
+}
+
+Metrics::Metrics()
+    : m_tracing(false), m_droppedTraceEvents(0), m_epoch(std::chrono::steady_clock::now())
+{
+}
+
+Metrics& Metrics::instance()
+{
+    static Metrics metrics;
+    return metrics;
+}
+
+bool Metrics::isCompiledIn()
+{
+#ifdef PFM_ENABLE_METRICS
+    return true;
+#else
+    return false;
+#endif
+}
+
+LatencyHistogram* Metrics::timer(const char* name)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    std::unique_ptr<LatencyHistogram>& histogram = m_timers[name];
+    if (!histogram) {
+        histogram.reset(new LatencyHistogram());
+    }
+    return histogram.get();
+}
+
+std::atomic<uint64_t>* Metrics::counter(const char* name)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    std::unique_ptr<std::atomic<uint64_t>>& counter = m_counters[name];
+    if (!counter) {
+        counter.reset(new std::atomic<uint64_t>(0));
+    }
+    return counter.get();
+}
+
+MetricsReport Metrics::report() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    MetricsReport report;
+    
+    for (const auto& entry : m_timers) {
+        report.timers.push_back(entry.second->stats(entry.first));
+    }
+    for (const auto& entry : m_counters) {
+        report.counters[entry.first] = entry.second->load(std::memory_order_relaxed);
+    }
+    
+    return report;
+}
+
+void Metrics::reset()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        for (auto& entry : m_timers) {
+            entry.second->reset();
+        }
+        for (auto& entry : m_counters) {
+            entry.second->store(0, std::memory_order_relaxed);
+        }
+    }
+    
+    std::lock_guard<std::mutex> lock(m_traceMutex);
+    m_traceEvents.clear();
+    m_droppedTraceEvents = 0;
+}
+
+void Metrics::setTracing(bool enabled)
+{
+    m_tracing.store(enabled, std::memory_order_relaxed);
+}
+
+bool Metrics::isTracing() const
+{
+    return m_tracing.load(std::memory_order_relaxed);
+}
+
+void Metrics::recordTraceEvent(const char* name, std::chrono::steady_clock::time_point start,
+                               uint64_t durationNanoseconds)
+{
+    TraceEvent event;
+    event.name = name;
+    event.threadId = std::hash<std::thread::id>()(std::this_thread::get_id());
+    event.startNanoseconds = std::chrono::duration_cast<std::chrono::nanoseconds>(start - m_epoch).count();
+    event.durationNanoseconds = durationNanoseconds;
+    
+    std::lock_guard<std::mutex> lock(m_traceMutex);
+    if (m_traceEvents.size() < kMaxTraceEvents) {
+        m_traceEvents.push_back(event);
+    } else {
+        ++m_droppedTraceEvents;
+    }
+}
+
+size_t Metrics::traceEventCount() const
+{
+    std::lock_guard<std::mutex> lock(m_traceMutex);
+    return m_traceEvents.size();
+}
+
+bool Metrics::writeChromeTrace(const std::string& filePath) const
+{
+    std::vector<TraceEvent> events;
+    uint64_t dropped;
+    {
+        std::lock_guard<std::mutex> lock(m_traceMutex);
+        events = m_traceEvents;
+        dropped = m_droppedTraceEvents;
+    }
+    
+    std::ofstream file(filePath);
+    if (!file.is_open()) {
+        std::cerr << "Error writing trace: cannot open " << filePath << std::endl;
+        return false;
+    }
+    
+    // Chrome trace event format: complete ("X") events with microsecond times.
+    // Thread ids are hashed, so map them to small numbers for readability.
+    std::map<uint64_t, int> threads;
+    file << std::fixed << std::setprecision(3);
+    file << "{\"traceEvents\":[";
+    for (size_t i = 0; i < events.size(); ++i) {
+        const TraceEvent& event = events[i];
+        int thread = threads.emplace(event.threadId, static_cast<int>(threads.size()) + 1).first->second;
+        
+        file << (i > 0 ? ",\n" : "\n")
+             << "{\"name\":" << nlohmann::json(event.name).dump()
+             << ",\"cat\":\"pfm\",\"ph\":\"X\",\"pid\":1,\"tid\":" << thread
+             << ",\"ts\":" << event.startNanoseconds / 1000.0
+             << ",\"dur\":" << event.durationNanoseconds / 1000.0 << "}";
+    }
+    file << "\n],\"displayTimeUnit\":\"ms\",\"otherData\":{\"droppedEvents\":" << dropped << "}}" << std::endl;
+    
+    return file.good();
+}
@@ -0,0 +1,458 @@
+#include "../../include/core/PartitionCodec.h"
+#include "../../include/core/DateUtils.h"
+#include "../../include/core/Crc32c.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <iterator>
+#include <stdexcept>
+#include <string_view>
+#include <unordered_map>
+
+namespace {
+
+const char kMagic[4] = {'P', 'F', 'M', 'C'};
+const char kBlockMarker[4] = {'P', 'F', 'M', 'B'};
+const unsigned char kVersion = 2;          // Framed blocks, each with a CRC32C
+const unsigned char kUnframedVersion = 1;  // Length-prefixed blocks, no checksums
+const size_t kHeaderSize = sizeof(kMagic) + 1;
+const size_t kBlockHeaderSize = 16;        // Marker, checksum, month key, payload length
+
+// Date column encodings
+const unsigned char kDatesAsDays = 0;     // Delta-encoded day numbers
+const unsigned char kDatesAsStrings = 1;  // Kept verbatim; some date did not round-trip
+
+uint64_t zigzag(int64_t value)
+{
+    return (static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63);
+}
+
+int64_t unzigzag(uint64_t value)
+{
+    return static_cast<int64_t>(value >> 1) ^ -static_cast<int64_t>(value & 1);
+}
+
+void putVarint(std::string& out, uint64_t value)
+{
+    while (value >= 0x80) {
+        out.push_back(static_cast<char>(value | 0x80));
+        value >>= 7;
+    }
+    out.push_back(static_cast<char>(value));
+}
+
+void putString(std::string& out, std::string_view text)
+{
+    putVarint(out, text.size());
+    out.append(text.data(), text.size());
+}
+
+void putFixed32(std::string& out, uint32_t value)
+{
+    for (int i = 0; i < 4; ++i) {
+        out.push_back(static_cast<char>(value >> (i * 8)));
+    }
+}
+
+uint32_t getFixed32(const char* data)
+{
+    uint32_t value = 0;
+    for (int i = 0; i < 4; ++i) {
+        value |= static_cast<uint32_t>(static_cast<unsigned char>(data[i])) << (i * 8);
+    }
+    return value;
+}
+
+void putDouble(std::string& out, double value)
+{
+    uint64_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    for (int i = 0; i < 8; ++i) {
+        out.push_back(static_cast<char>(bits >> (i * 8)));
+    }
+}
+
+// Bounds-checked cursor over an encoded partition
+class Reader {
+public:
+    Reader(const char* data, size_t size) : m_data(data), m_size(size), m_offset(0) {}
+    
+    bool atEnd() const { return m_offset == m_size; }
+    size_t remaining() const { return m_size - m_offset; }
+    
+    unsigned char byte()
+    {
+        require(1);
+        return static_cast<unsigned char>(m_data[m_offset++]);
+    }
+    
+    uint64_t varint()
+    {
+        uint64_t value = 0;
+        for (int shift = 0; shift < 64; shift += 7) {
+            unsigned char next = byte();
+            value |= static_cast<uint64_t>(next & 0x7f) << shift;
+            if ((next & 0x80) == 0) {
+                return value;
+            }
+        }
+        throw std::runtime_error("malformed varint");
+    }
+    
+    std::string string()
+    {
+        uint64_t length = varint();
+        require(length);
+        std::string text(m_data + m_offset, length);
+        m_offset += length;
+        return text;
+    }
+    
+    double rawDouble()
+    {
+        require(8);
+        uint64_t bits = 0;
+        for (int i = 0; i < 8; ++i) {
+            bits |= static_cast<uint64_t>(static_cast<unsigned char>(m_data[m_offset++])) << (i * 8);
+        }
+        double value;
+        std::memcpy(&value, &bits, sizeof(value));
+        return value;
+    }
+    
+    Reader block(uint64_t length)
+    {
+        require(length);
+        Reader reader(m_data + m_offset, length);
+        m_offset += length;
+        return reader;
+    }
+    
+private:
+    const char* m_data;
+    size_t m_size;
+    size_t m_offset;
+    
+    void require(uint64_t count) const
+    {
+        if (count > m_size - m_offset) {
+            throw std::runtime_error("truncated partition");
+        }
+    }
+};
+
+// Distinct values in first-seen order, then each row's index into them
+void putDictionary(std::string& out, const ExpenseChunk& rows, std::string Expense::*column)
+{
+    std::unordered_map<std::string_view, uint64_t> indexes;
+    std::vector<std::string_view> values;
+    std::vector<uint64_t> rowIndexes;
+    rowIndexes.reserve(rows.size());
+    
+    for (const auto& expense : rows) {
+        std::string_view value = expense.*column;
+        auto inserted = indexes.emplace(value, values.size());
+        if (inserted.second) {
+            values.push_back(value);
+        }
+        rowIndexes.push_back(inserted.first->second);
+    }
+    
+    putVarint(out, values.size());
+    for (std::string_view value : values) {
+        putString(out, value);
+    }
+    for (uint64_t index : rowIndexes) {
+        putVarint(out, index);
+    }
+}
+
+void readDictionary(Reader& reader, std::vector<Expense>& rows, std::string Expense::*column)
+{
+    uint64_t count = reader.varint();
+    if (count > reader.remaining()) {
+        throw std::runtime_error("dictionary larger than its block");
+    }
+    
+    std::vector<std::string> values;
+    values.reserve(count);
+    for (uint64_t i = 0; i < count; ++i) {
+        values.push_back(reader.string());
+    }
+    for (auto& expense : rows) {
+        uint64_t index = reader.varint();
+        if (index >= values.size()) {
+            throw std::runtime_error("dictionary index out of range");
+        }
+        expense.*column = values[index];
+    }
+}
+
+bool roundTripsAsDay(const std::string& date, long& days)
+{
+    int year, month, day;
+    if (!DateUtils::parseDate(date, year, month, day) || DateUtils::formatDate(year, month, day) != date) {
+        return false;
+    }
+    days = DateUtils::daysFromCivil(year, month, day);
+    return true;
+}
+
+void encodeBlock(std::string& out, const ExpenseChunk& rows)
+{
+    putVarint(out, rows.size());
+    
+    // Ids ascend within a chunk, so the deltas are mostly one byte
+    int64_t previous = 0;
+    for (const auto& expense : rows) {
+        putVarint(out, zigzag(static_cast<int64_t>(expense.id) - previous));
+        previous = expense.id;
+    }
+    
+    std::vector<long> days(rows.size());
+    bool asDays = true;
+    for (size_t i = 0; i < rows.size() && asDays; ++i) {
+        asDays = roundTripsAsDay(rows[i].date, days[i]);
+    }
+    out.push_back(static_cast<char>(asDays ? kDatesAsDays : kDatesAsStrings));
+    previous = 0;
+    for (size_t i = 0; i < rows.size(); ++i) {
+        if (asDays) {
+            putVarint(out, zigzag(days[i] - previous));
+            previous = days[i];
+        } else {
+            putString(out, rows[i].date);
+        }
+    }
+    
+    // Whole cents shifted left one bit; a set low bit means a raw double follows
+    for (const auto& expense : rows) {
+        double cents = std::round(expense.amount * 100.0);
+        if (std::fabs(cents) < 1e15 && cents / 100.0 == expense.amount) {
+            putVarint(out, zigzag(static_cast<int64_t>(cents)) << 1);
+        } else {
+            putVarint(out, 1);
+            putDouble(out, expense.amount);
+        }
+    }
+    
+    putDictionary(out, rows, &Expense::category);
+    putDictionary(out, rows, &Expense::description);
+}
+
+void decodeBlock(Reader& reader, std::vector<Expense>& expenses)
+{
+    uint64_t count = reader.varint();
+    if (count > reader.remaining()) {
+        throw std::runtime_error("row count larger than its block");
+    }
+    
+    std::vector<Expense> rows(count);
+    int64_t previous = 0;
+    for (auto& expense : rows) {
+        previous += unzigzag(reader.varint());
+        expense.id = static_cast<int>(previous);
+    }
+    
+    unsigned char dateEncoding = reader.byte();
+    if (dateEncoding != kDatesAsDays && dateEncoding != kDatesAsStrings) {
+        throw std::runtime_error("unknown date encoding");
+    }
+    previous = 0;
+    for (auto& expense : rows) {
+        if (dateEncoding == kDatesAsDays) {
+            previous += unzigzag(reader.varint());
+            int year, month, day;
+            DateUtils::civilFromDays(static_cast<long>(previous), year, month, day);
+            expense.date = DateUtils::formatDate(year, month, day);
+        } else {
+            expense.date = reader.string();
+        }
+    }
+    
+    for (auto& expense : rows) {
+        uint64_t value = reader.varint();
+        expense.amount = (value & 1) ? reader.rawDouble() : unzigzag(value >> 1) / 100.0;
+    }
+    
+    readDictionary(reader, rows, &Expense::category);
+    readDictionary(reader, rows, &Expense::description);
+    
+    expenses.insert(expenses.end(), std::make_move_iterator(rows.begin()), std::make_move_iterator(rows.end()));
+}
+
+bool hasUnframedHeader(const std::string& bytes)
+{
+    return bytes.size() >= kHeaderSize && std::memcmp(bytes.data(), kMagic, sizeof(kMagic)) == 0 &&
+           static_cast<unsigned char>(bytes[sizeof(kMagic)]) == kUnframedVersion;
+}
+
+std::vector<Expense> decodeUnframed(const std::string& bytes)
+{
+    Reader reader(bytes.data() + kHeaderSize, bytes.size() - kHeaderSize);
+    std::vector<Expense> expenses;
+    uint64_t blocks = reader.varint();
+    for (uint64_t i = 0; i < blocks; ++i) {
+        Reader block = reader.block(reader.varint());
+        decodeBlock(block, expenses);
+        if (!block.atEnd()) {
+            throw std::runtime_error("trailing bytes in block");
+        }
+    }
+    if (!reader.atEnd()) {
+        throw std::runtime_error("trailing bytes after the last block");
+    }
+    return expenses;
+}
+
+// Whether a block with a matching checksum starts at offset
+bool intactBlockAt(const std::string& bytes, size_t offset, int& monthKey, size_t& length)
+{
+    const char* block = bytes.data() + offset;
+    if (bytes.size() - offset < kBlockHeaderSize || std::memcmp(block, kBlockMarker, sizeof(kBlockMarker)) != 0) {
+        return false;
+    }
+    
+    monthKey = static_cast<int>(getFixed32(block + 8));
+    length = getFixed32(block + 12);
+    return length <= bytes.size() - offset - kBlockHeaderSize &&
+           Crc32c::compute(block + 8, 8 + length) == getFixed32(block + 4);
+}
+
+// Calls visit(monthKey, payload) for every block whose checksum matches and
+// returns the number of damaged regions. After damage, scanning resumes at
+// the next block marker, so one bad byte costs one month, not the year.
+template <typename Visit>
+size_t scanBlocks(const std::string& bytes, Visit visit)
+{
+    // Without a readable header, look for blocks from the very start
+    bool header = bytes.size() >= kHeaderSize && std::memcmp(bytes.data(), kMagic, sizeof(kMagic)) == 0 &&
+                  static_cast<unsigned char>(bytes[sizeof(kMagic)]) == kVersion;
+    size_t offset = header ? kHeaderSize : 0;
+    size_t damaged = header ? 0 : 1;
+    bool inDamage = !header;
+    const std::string marker(kBlockMarker, sizeof(kBlockMarker));
+    
+    while (offset < bytes.size()) {
+        int monthKey;
+        size_t length;
+        if (intactBlockAt(bytes, offset, monthKey, length)) {
+            Reader payload(bytes.data() + offset + kBlockHeaderSize, length);
+            visit(monthKey, payload);
+            offset += kBlockHeaderSize + length;
+            inDamage = false;
+            continue;
+        }
+        
+        if (!inDamage) {
+            ++damaged;
+            inDamage = true;
+        }
+        offset = std::min(bytes.find(marker, offset + 1), bytes.size());
+    }
+    
+    return damaged;
+}
+
+} // namespace
+
+bool PartitionCodec::isCompact(const std::string& bytes)
+{
+    return bytes.size() >= sizeof(kMagic) && std::memcmp(bytes.data(), kMagic, sizeof(kMagic)) == 0;
+}
+
+std::string PartitionCodec::encode(const std::vector<const ExpenseChunk*>& chunks)
+{
+    std::string out(kMagic, sizeof(kMagic));
+    out.push_back(static_cast<char>(kVersion));
+    
+    std::string payload;
+    for (const ExpenseChunk* chunk : chunks) {
+        payload.clear();
+        encodeBlock(payload, *chunk);
+        
+        // The checksum covers the month key and length as well as the payload
+        size_t start = out.size();
+        out.append(kBlockMarker, sizeof(kBlockMarker));
+        putFixed32(out, 0);
+        putFixed32(out, chunk->empty() ? 0 : static_cast<uint32_t>(DateUtils::monthKey(chunk->front().date)));
+        putFixed32(out, static_cast<uint32_t>(payload.size()));
+        out += payload;
+        uint32_t checksum = Crc32c::compute(out.data() + start + 8, out.size() - start - 8);
+        for (int i = 0; i < 4; ++i) {
+            out[start + 4 + i] = static_cast<char>(checksum >> (i * 8));
+        }
+    }
+    
+    return out;
+}
+
+std::vector<Expense> PartitionCodec::decode(const std::string& bytes)
+{
+    if (!isCompact(bytes) || bytes.size() < kHeaderSize) {
+        throw std::runtime_error("not a compact partition");
+    }
+    
+    unsigned char version = static_cast<unsigned char>(bytes[sizeof(kMagic)]);
+    if (version == kUnframedVersion) {
+        return decodeUnframed(bytes);
+    }
+    if (version != kVersion) {
+        throw std::runtime_error("unsupported compact partition version");
+    }
+    
+    PartitionCheck result;
+    std::vector<Expense> expenses = salvage(bytes, &result);
+    if (!result.intact()) {
+        throw std::runtime_error(std::to_string(result.damagedRegions) + " damaged region(s)");
+    }
+    return expenses;
+}
+
+PartitionCheck PartitionCodec::check(const std::string& bytes)
+{
+    PartitionCheck result;
+    if (hasUnframedHeader(bytes)) {
+        salvage(bytes, &result);  // No checksums, so decoding is the only check
+        return result;
+    }
+    
+    result.damagedRegions = scanBlocks(bytes, [&result](int, Reader&) { ++result.intactBlocks; });
+    return result;
+}
+
+std::vector<Expense> PartitionCodec::salvage(const std::string& bytes, PartitionCheck* check)
+{
+    std::vector<Expense> expenses;
+    PartitionCheck result;
+    if (hasUnframedHeader(bytes)) {
+        try {
+            expenses = decodeUnframed(bytes);
+            result.intactBlocks = 1;
+        } catch (const std::exception&) {
+            result.damagedRegions = 1;
+        }
+    } else {
+        result.damagedRegions = scanBlocks(bytes, [&](int, Reader& payload) {
+            // A block whose checksum matches but whose contents do not decode was
+            // written that way; it counts as damage all the same
+            size_t rows = expenses.size();
+            try {
+                decodeBlock(payload, expenses);
+                if (!payload.atEnd()) {
+                    throw std::runtime_error("trailing bytes in block");
+                }
+                ++result.intactBlocks;
+            } catch (const std::exception&) {
+                expenses.resize(rows);
+                ++result.damagedRegions;
+            }
+        });
+    }
+    
+    if (check) {
+        *check = result;
+    }
+    return expenses;
+}
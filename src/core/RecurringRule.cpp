@@ -0,0 +1,70 @@
+#include "../../include/core/RecurringRule.h"
+#include "../../include/core/DateUtils.h"
+#include <algorithm>
+
+bool RecurringRule::isValid() const
+{
+    return amount > 0.0 && interval >= 1 && !category.empty() && DateUtils::isValidDate(startDate) &&
+           (endDate.empty() || (DateUtils::isValidDate(endDate) && endDate >= startDate));
+}
+
+std::vector<std::string> RecurringRule::occurrences(const std::string& fromDate, const std::string& toDate) const
+{
+    std::vector<std::string> dates;
+    std::string from = std::max(fromDate, startDate);
+    std::string to = endDate.empty() ? toDate : std::min(toDate, endDate);
+    
+    int startYear, startMonth, startDay, year, month, day;
+    if (!isValid() || !DateUtils::parseDate(startDate, startYear, startMonth, startDay) ||
+        !DateUtils::parseDate(from, year, month, day) || !DateUtils::isValidDate(to) || from > to) {
+        return dates;
+    }
+    
+    if (frequency == RecurrenceFrequency::Monthly) {
+        // Jump straight to the first period at or after from
+        long startIndex = startYear * 12L + (startMonth - 1);
+        long elapsed = year * 12L + (month - 1) - startIndex;
+        long period = (elapsed + interval - 1) / interval;
+        
+        for (;; ++period) {
+            long index = startIndex + period * interval;
+            int occurrenceYear = static_cast<int>(index / 12);
+            int occurrenceMonth = static_cast<int>(index % 12) + 1;
+            if (occurrenceYear > 9999) {
+                break;  // Past any four-digit end date
+            }
+            int occurrenceDay = std::min(startDay, DateUtils::daysInMonth(occurrenceYear, occurrenceMonth));
+            std::string date = DateUtils::formatDate(occurrenceYear, occurrenceMonth, occurrenceDay);
+            if (date > to) {
+                break;
+            }
+            if (date >= from) {
+                dates.push_back(date);
+            }
+        }
+    } else {
+        long step = frequency == RecurrenceFrequency::Weekly ? 7L * interval : interval;
+        long start = DateUtils::daysFromCivil(startYear, startMonth, startDay);
+        long first = DateUtils::daysFromCivil(year, month, day);
+        long days = start + (first - start + step - 1) / step * step;
+        
+        for (;; days += step) {
+            DateUtils::civilFromDays(days, year, month, day);
+            if (year > 9999) {
+                break;
+            }
+            std::string date = DateUtils::formatDate(year, month, day);
+            if (date > to) {
+                break;
+            }
+            dates.push_back(date);
+        }
+    }
+    
+    return dates;
+}
+
+Expense RecurringRule::occurrence(const std::string& date, bool projected) const
+{
+    return Expense(projected ? -id : 0, amount, description, category, date);
+}
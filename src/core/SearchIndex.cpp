@@ -0,0 +1,179 @@
+#include "../../include/core/SearchIndex.h"
+#include <algorithm>
+#include <iterator>
+
+std::vector<std::string> SearchIndex::tokenize(const std::string& text)
+{
+    std::vector<std::string> tokens;
+    std::string token;
+    
+    for (char c : text) {
+        unsigned char byte = static_cast<unsigned char>(c);
+        if ((byte >= 'a' && byte <= 'z') || (byte >= '0' && byte <= '9') || byte >= 0x80) {
+            token.push_back(c);
+        } else if (byte >= 'A' && byte <= 'Z') {
+            token.push_back(static_cast<char>(byte - 'A' + 'a'));
+        } else if (!token.empty()) {
+            tokens.push_back(token);
+            token.clear();
+        }
+    }
+    if (!token.empty()) {
+        tokens.push_back(token);
+    }
+    
+    std::sort(tokens.begin(), tokens.end());
+    tokens.erase(std::unique(tokens.begin(), tokens.end()), tokens.end());
+    return tokens;
+}
+
+bool SearchIndex::matches(const std::vector<std::string>& queryTokens, const std::string& text)
+{
+    std::vector<std::string> tokens = tokenize(text);
+    for (const auto& queryToken : queryTokens) {
+        // Tokens are sorted, so the first one not below the prefix is the only candidate
+        auto it = std::lower_bound(tokens.begin(), tokens.end(), queryToken);
+        if (it == tokens.end() || it->compare(0, queryToken.size(), queryToken) != 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void SearchIndex::add(int id, const std::string& text)
+{
+    for (const auto& token : tokenize(text)) {
+        std::vector<int>& ids = m_postings[token];
+        if (ids.empty() || ids.back() < id) {
+            ids.push_back(id);
+        } else {
+            auto it = std::lower_bound(ids.begin(), ids.end(), id);
+            if (it == ids.end() || *it != id) {
+                ids.insert(it, id);
+            }
+        }
+    }
+}
+
+void SearchIndex::remove(int id, const std::string& text)
+{
+    for (const auto& token : tokenize(text)) {
+        auto posting = m_postings.find(token);
+        if (posting == m_postings.end()) {
+            continue;
+        }
+        
+        std::vector<int>& ids = posting->second;
+        auto it = std::lower_bound(ids.begin(), ids.end(), id);
+        if (it != ids.end() && *it == id) {
+            ids.erase(it);
+        }
+        if (ids.empty()) {
+            m_postings.erase(posting);
+        }
+    }
+}
+
+void SearchIndex::clear()
+{
+    m_postings.clear();
+}
+
+std::map<std::string, std::vector<int>> SearchIndex::invert(
+    const std::vector<std::pair<int, const std::string*>>& documents)
+{
+    std::map<std::string, std::vector<int>> postings;
+    for (const auto& document : documents) {
+        for (const auto& token : tokenize(*document.second)) {
+            postings[token].push_back(document.first);
+        }
+    }
+    
+    for (auto& posting : postings) {
+        std::sort(posting.second.begin(), posting.second.end());
+    }
+    return postings;
+}
+
+void SearchIndex::addAll(const std::vector<std::pair<int, const std::string*>>& documents)
+{
+    for (auto& posting : invert(documents)) {
+        std::vector<int>& ids = m_postings[posting.first];
+        if (ids.empty()) {
+            ids.swap(posting.second);
+            continue;
+        }
+        
+        size_t middle = ids.size();
+        ids.insert(ids.end(), posting.second.begin(), posting.second.end());
+        std::inplace_merge(ids.begin(), ids.begin() + middle, ids.end());
+        ids.erase(std::unique(ids.begin(), ids.end()), ids.end());
+    }
+}
+
+void SearchIndex::removeAll(const std::vector<std::pair<int, const std::string*>>& documents)
+{
+    for (const auto& posting : invert(documents)) {
+        auto existing = m_postings.find(posting.first);
+        if (existing == m_postings.end()) {
+            continue;
+        }
+        
+        const std::vector<int>& removed = posting.second;
+        std::vector<int>& ids = existing->second;
+        ids.erase(std::remove_if(ids.begin(), ids.end(), [&removed](int id) {
+                      return std::binary_search(removed.begin(), removed.end(), id);
+                  }),
+                  ids.end());
+        if (ids.empty()) {
+            m_postings.erase(existing);
+        }
+    }
+}
+
+std::vector<int> SearchIndex::prefixMatches(const std::string& prefix) const
+{
+    auto begin = m_postings.lower_bound(prefix);
+    auto end = begin;
+    while (end != m_postings.end() && end->first.compare(0, prefix.size(), prefix) == 0) {
+        ++end;
+    }
+    
+    if (begin == end) {
+        return std::vector<int>();
+    }
+    if (std::next(begin) == end) {
+        return begin->second;
+    }
+    
+    std::vector<int> ids;
+    for (auto it = begin; it != end; ++it) {
+        ids.insert(ids.end(), it->second.begin(), it->second.end());
+    }
+    std::sort(ids.begin(), ids.end());
+    ids.erase(std::unique(ids.begin(), ids.end()), ids.end());
+    return ids;
+}
+
+std::vector<int> SearchIndex::search(const std::string& query) const
+{
+    std::vector<std::string> tokens = tokenize(query);
+    if (tokens.empty()) {
+        return std::vector<int>();
+    }
+    
+    // Longer prefixes are usually more selective, so start with them
+    std::sort(tokens.begin(), tokens.end(),
+              [](const std::string& a, const std::string& b) { return a.size() > b.size(); });
+    
+    std::vector<int> result = prefixMatches(tokens.front());
+    for (size_t i = 1; i < tokens.size() && !result.empty(); ++i) {
+        std::vector<int> matches = prefixMatches(tokens[i]);
+        std::vector<int> intersection;
+        std::set_intersection(result.begin(), result.end(), matches.begin(), matches.end(),
+                              std::back_inserter(intersection));
+        result.swap(intersection);
+    }
+    
+    return result;
+}
@@ -0,0 +1,100 @@
+#include "../../include/core/ThreadPool.h"
+#include <algorithm>
+
+ThreadPool::ThreadPool(unsigned int threadCount)
+    : m_stopping(false)
+{
+    unsigned int threads = threadCount ? threadCount : std::max(1u, std::thread::hardware_concurrency());
+    
+    // The caller of run() is the last thread
+    for (unsigned int i = 0; i + 1 < threads; ++i) {
+        m_workers.emplace_back(&ThreadPool::workerLoop, this);
+    }
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stopping = true;
+    }
+    m_wakeup.notify_all();
+    for (auto& worker : m_workers) {
+        worker.join();
+    }
+}
+
+unsigned int ThreadPool::threadCount() const
+{
+    return static_cast<unsigned int>(m_workers.size()) + 1;
+}
+
+void ThreadPool::run(unsigned int count, const std::function<void(unsigned int)>& work)
+{
+    if (count == 0) {
+        return;
+    }
+    
+    auto job = std::make_shared<Job>();
+    job->work = &work;
+    job->count = count;
+    if (count > 1 && !m_workers.empty()) {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_jobs.push_back(job);
+        }
+        if (count - 1 >= m_workers.size()) {
+            m_wakeup.notify_all();
+        } else {
+            for (unsigned int i = 0; i + 1 < count; ++i) {
+                m_wakeup.notify_one();
+            }
+        }
+    }
+    
+    runTasks(*job);
+    
+    // Workers may still be finishing tasks they claimed
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_finished.wait(lock, [&job]() { return job->finished == job->count; });
+}
+
+void ThreadPool::workerLoop()
+{
+    for (;;) {
+        std::shared_ptr<Job> job;
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_wakeup.wait(lock, [this]() { return m_stopping || !m_jobs.empty(); });
+            if (m_stopping) {
+                return;
+            }
+            job = m_jobs.front();
+        }
+        runTasks(*job);
+    }
+}
+
+void ThreadPool::runTasks(Job& job)
+{
+    unsigned int done = 0;
+    for (unsigned int task = job.next++; task < job.count; task = job.next++) {
+        (*job.work)(task);
+        ++done;
+    }
+    
+    std::lock_guard<std::mutex> lock(m_mutex);
+    
+    // Every task is claimed, so no other thread needs to pick this job up
+    auto it = std::find_if(m_jobs.begin(), m_jobs.end(),
+                           [&job](const std::shared_ptr<Job>& queued) { return queued.get() == &job; });
+    if (it != m_jobs.end()) {
+        m_jobs.erase(it);
+    }
+    if (done > 0) {
+        job.finished += done;
+        if (job.finished == job.count) {
+            m_finished.notify_all();
+        }
+    }
+}
@@ -0,0 +1,255 @@
+#include "../../include/core/Workspace.h"
+#include "../../include/core/FileUtils.h"
+#include "../../include/core/Metrics.h"
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <shared_mutex>
+
+namespace {
+
+const char* const kDefaultLedgerName = "Personal";
+const char* const kDefaultLedgerFile = "expenses.json";
+const size_t kDefaultWorkspaceMemoryBudget = 512 * 1024 * 1024;
+
+} // namespace
+
+Workspace::Workspace(const std::string& workspaceFilePath, unsigned int threadCount)
+    : m_filePath(workspaceFilePath), m_threadPool(threadCount),
+      m_memoryBudget(std::make_shared<MemoryBudget>(kDefaultWorkspaceMemoryBudget))
+{
+    PFM_SCOPED_TIMER("Workspace::open");
+    
+    // Load the ledger list
+    bool exists = fs::exists(workspaceFilePath);
+    if (exists) {
+        try {
+            std::ifstream file(workspaceFilePath);
+            json j;
+            file >> j;
+            for (const auto& ledgerJson : j["ledgers"]) {
+                Ledger ledger;
+                ledger.name = ledgerJson["name"].get<std::string>();
+                ledger.file = ledgerJson["file"].get<std::string>();
+                m_ledgers.push_back(ledger);
+            }
+            if (j.contains("memoryBudget")) {
+                m_memoryBudget->setLimit(j["memoryBudget"].get<size_t>());
+            }
+        } catch (const std::exception& e) {
+            std::cerr << "Error loading workspace " << workspaceFilePath << ": " << e.what() << std::endl;
+            m_ledgers.clear();
+        }
+    }
+    if (m_ledgers.empty()) {
+        Ledger ledger;
+        ledger.name = kDefaultLedgerName;
+        ledger.file = kDefaultLedgerFile;
+        m_ledgers.push_back(ledger);
+    }
+    
+    // Ledgers load their manifests and current year independently, so open them side by side
+    m_threadPool.run(static_cast<unsigned int>(m_ledgers.size()), [this](unsigned int index) {
+        m_ledgers[index].manager = openLedger(m_ledgers[index].file);
+    });
+    
+    // Never overwrite a workspace file that failed to load
+    if (!exists) {
+        saveLocked();
+    }
+}
+
+Workspace::~Workspace()
+{
+    // Ledgers still held elsewhere outlive the pool
+    for (const auto& ledger : m_ledgers) {
+        ledger.manager->setThreadPool(nullptr);
+    }
+}
+
+std::vector<std::string> Workspace::getLedgerNames() const
+{
+    std::shared_lock<SharedMutex> lock(m_mutex);
+    std::vector<std::string> names;
+    for (const auto& ledger : m_ledgers) {
+        names.push_back(ledger.name);
+    }
+    return names;
+}
+
+std::shared_ptr<ExpenseManager> Workspace::ledger(const std::string& name) const
+{
+    std::shared_lock<SharedMutex> lock(m_mutex);
+    for (const auto& ledger : m_ledgers) {
+        if (ledger.name == name) {
+            return ledger.manager;
+        }
+    }
+    return nullptr;
+}
+
+std::shared_ptr<ExpenseManager> Workspace::defaultLedger() const
+{
+    std::shared_lock<SharedMutex> lock(m_mutex);
+    return m_ledgers.empty() ? nullptr : m_ledgers.front().manager;
+}
+
+std::string Workspace::ledgerFile(const std::string& name) const
+{
+    std::shared_lock<SharedMutex> lock(m_mutex);
+    for (const auto& ledger : m_ledgers) {
+        if (ledger.name == name) {
+            return dataPath(ledger.file);
+        }
+    }
+    return "";
+}
+
+bool Workspace::addLedger(const std::string& name, const std::string& dataFilePath)
+{
+    {
+        std::shared_lock<SharedMutex> lock(m_mutex);
+        if (name.empty() || hasLedgerLocked(name, dataFilePath)) {
+            return false;
+        }
+    }
+    
+    // Opening may load a large ledger; do it before taking the lock
+    Ledger ledger;
+    ledger.name = name;
+    ledger.file = dataFilePath;
+    ledger.manager = openLedger(dataFilePath);
+    
+    std::unique_lock<SharedMutex> lock(m_mutex);
+    if (hasLedgerLocked(name, dataFilePath)) {
+        return false;  // Added by another thread meanwhile
+    }
+    m_ledgers.push_back(ledger);
+    return saveLocked();
+}
+
+bool Workspace::removeLedger(const std::string& name)
+{
+    std::unique_lock<SharedMutex> lock(m_mutex);
+    if (m_ledgers.size() == 1) {
+        return false;
+    }
+    for (auto it = m_ledgers.begin(); it != m_ledgers.end(); ++it) {
+        if (it->name == name) {
+            // Whoever still holds it keeps a standalone ledger
+            it->manager->setThreadPool(nullptr);
+            it->manager->setSharedMemoryBudget(nullptr);
+            m_ledgers.erase(it);
+            return saveLocked();
+        }
+    }
+    return false;
+}
+
+void Workspace::setMemoryBudget(size_t bytes)
+{
+    std::unique_lock<SharedMutex> lock(m_mutex);
+    m_memoryBudget->setLimit(bytes);
+    
+    // Re-registering makes each ledger trim its cache against the new limit
+    for (const auto& ledger : m_ledgers) {
+        ledger.manager->setSharedMemoryBudget(m_memoryBudget);
+    }
+    saveLocked();
+}
+
+size_t Workspace::getMemoryBudget() const
+{
+    return m_memoryBudget->limit();
+}
+
+size_t Workspace::getCachedBytes() const
+{
+    return m_memoryBudget->used();
+}
+
+ThreadPool& Workspace::threadPool()
+{
+    return m_threadPool;
+}
+
+ConsolidatedReport Workspace::consolidatedReport(int year, int month) const
+{
+    PFM_SCOPED_TIMER("Workspace::consolidatedReport");
+    std::vector<Ledger> ledgers;
+    {
+        std::shared_lock<SharedMutex> lock(m_mutex);
+        ledgers = m_ledgers;
+    }
+    
+    ConsolidatedReport report;
+    report.year = year;
+    report.month = month;
+    report.ledgers.resize(ledgers.size());
+    m_threadPool.run(static_cast<unsigned int>(ledgers.size()), [&](unsigned int index) {
+        LedgerTotals& totals = report.ledgers[index];
+        totals.ledger = ledgers[index].name;
+        totals.categories = ledgers[index].manager->generateCategorySummary(year, month);
+        
+        // From the same read, so an edit in between cannot make them disagree
+        for (const auto& category : totals.categories) {
+            totals.total += category.second;
+        }
+    });
+    
+    for (const auto& totals : report.ledgers) {
+        for (const auto& category : totals.categories) {
+            report.categories[category.first] += category.second;
+        }
+        report.total += totals.total;
+    }
+    return report;
+}
+
+std::string Workspace::dataPath(const std::string& file) const
+{
+    fs::path path(file);
+    if (path.is_absolute()) {
+        return path.string();
+    }
+    return (fs::path(m_filePath).parent_path() / path).string();
+}
+
+// Two managers on one data file would overwrite each other's saves
+bool Workspace::hasLedgerLocked(const std::string& name, const std::string& file) const
+{
+    fs::path path = fs::absolute(dataPath(file)).lexically_normal();
+    for (const auto& ledger : m_ledgers) {
+        if (ledger.name == name || fs::absolute(dataPath(ledger.file)).lexically_normal() == path) {
+            return true;
+        }
+    }
+    return false;
+}
+
+std::shared_ptr<ExpenseManager> Workspace::openLedger(const std::string& file)
+{
+    auto manager = std::make_shared<ExpenseManager>(dataPath(file));
+    manager->setThreadPool(&m_threadPool);
+    manager->setSharedMemoryBudget(m_memoryBudget);
+    return manager;
+}
+
+bool Workspace::saveLocked() const
+{
+    json j;
+    j["ledgers"] = json::array();
+    for (const auto& ledger : m_ledgers) {
+        j["ledgers"].push_back({
+            {"name", ledger.name},
+            {"file", ledger.file}
+        });
+    }
+    j["memoryBudget"] = m_memoryBudget->limit();
+    
+    if (!FileUtils::writeAtomically(m_filePath, j.dump(4) + "\n")) {
+        std::cerr << "Error saving workspace " << m_filePath << std::endl;
+        return false;
+    }
+    return true;
+}
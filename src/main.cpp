@@ -1,17 +1,17 @@
 #include <QApplication>
 #include <QMainWindow>
 #include "ui/MainWindow.h"
-#include "core/ExpenseManager.h"
+#include "core/Workspace.h"
 
 int main(int argc, char *argv[])
 {
     QApplication app(argc, argv);
     
-    // Initialize the expense manager with the data file path
-    ExpenseManager expenseManager("expenses.json");
+    // Open every ledger of the workspace; without a workspace file this is expenses.json alone
+    Workspace workspace("workspace.json");
     
     // Create and show the main window
-    MainWindow mainWindow(&expenseManager);
+    MainWindow mainWindow(&workspace);
     mainWindow.show();
     
     return app.exec();
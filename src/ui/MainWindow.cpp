@@ -1,4 +1,7 @@
 #include "../../include/ui/MainWindow.h"
+#include "../../include/core/ExpenseImporter.h"
+#include "../../include/core/Metrics.h"
+#include "../../include/core/DateUtils.h"
 #include <QVBoxLayout>
 #include <QHBoxLayout>
 #include <QFormLayout>
@@ -12,10 +15,41 @@
 #include <QDateTime>
 #include <QFileDialog>
 #include <QTextStream>
+#include <QApplication>
+#include <QShortcut>
+#include <QCheckBox>
+#include <QStatusBar>
+#include <algorithm>
 
+namespace {
 
-MainWindow::MainWindow(ExpenseManager* expenseManager, QWidget* parent)
-    : QMainWindow(parent), m_expenseManager(expenseManager)
+// Rows per table page; only this many are copied out of the ledger at a time
+const size_t kPageSize = 200;
+
+QString budgetName(const Budget& budget)
+{
+    QString name = budget.isOverall() ? QString("All spending") : QString::fromStdString(budget.category);
+    return budget.period == BudgetPeriod::Yearly ? name + " (year)" : name;
+}
+
+QString scheduleName(const RecurringRule& rule)
+{
+    switch (rule.frequency) {
+    case RecurrenceFrequency::Weekly:
+        return rule.interval == 1 ? QString("Weekly") : QString("Every %1 weeks").arg(rule.interval);
+    case RecurrenceFrequency::Custom:
+        return rule.interval == 1 ? QString("Daily") : QString("Every %1 days").arg(rule.interval);
+    case RecurrenceFrequency::Monthly:
+        break;
+    }
+    return rule.interval == 1 ? QString("Monthly") : QString("Every %1 months").arg(rule.interval);
+}
+}
+
+
+MainWindow::MainWindow(Workspace* workspace, QWidget* parent)
+    : QMainWindow(parent), m_workspace(workspace), m_ledger(workspace->defaultLedger()),
+      m_expenseManager(m_ledger.get()), m_pageOffset(0)
 {
     setWindowTitle("Personal Finance Manager");
     setMinimumSize(800, 600);
@@ -23,10 +57,23 @@ MainWindow::MainWindow(ExpenseManager* expenseManager, QWidget* parent)
     setupUI();
     updateCategoryComboBox();
     refreshData();
+    watchBudgetAlerts();
+    
+    // Once the window is up, so a damaged ledger is reported over it
+    QTimer::singleShot(0, this, &MainWindow::checkStorage);
 }
 
 MainWindow::~MainWindow()
 {
+    m_expenseManager->setBudgetAlertCallback(nullptr);
+}
+
+void MainWindow::watchBudgetAlerts()
+{
+    // Alerts may come from any thread that edits the ledger; show them on the UI thread
+    m_expenseManager->setBudgetAlertCallback([this](const BudgetAlert& alert) {
+        QMetaObject::invokeMethod(this, [this, alert]() { showBudgetAlert(alert); }, Qt::QueuedConnection);
+    });
 }
 
 void MainWindow::setupUI()
@@ -39,6 +86,12 @@ void MainWindow::setupUI()
     QGroupBox* filterGroupBox = new QGroupBox("Filter Expenses");
     QHBoxLayout* filterLayout = new QHBoxLayout(filterGroupBox);
     
+    // Every ledger of the workspace stays open, so switching is immediate
+    m_ledgerComboBox = new QComboBox();
+    for (const auto& name : m_workspace->getLedgerNames()) {
+        m_ledgerComboBox->addItem(QString::fromStdString(name));
+    }
+    
     m_yearComboBox = new QComboBox();
     QDateTime currentDate = QDateTime::currentDateTime();
     int currentYear = currentDate.date().year();
@@ -56,11 +109,24 @@ void MainWindow::setupUI()
     
     QPushButton* filterButton = new QPushButton("Apply Filter");
     
+    filterLayout->addWidget(new QLabel("Ledger:"));
+    filterLayout->addWidget(m_ledgerComboBox);
     filterLayout->addWidget(new QLabel("Year:"));
     filterLayout->addWidget(m_yearComboBox);
     filterLayout->addWidget(new QLabel("Month:"));
     filterLayout->addWidget(m_monthComboBox);
     filterLayout->addWidget(filterButton);
+    
+    // Search runs as the user types, debounced so fast typing issues one query
+    m_searchEdit = new QLineEdit();
+    m_searchEdit->setPlaceholderText("Search descriptions...");
+    m_searchEdit->setClearButtonEnabled(true);
+    m_searchTimer = new QTimer(this);
+    m_searchTimer->setSingleShot(true);
+    m_searchTimer->setInterval(150);
+    
+    filterLayout->addWidget(new QLabel("Search:"));
+    filterLayout->addWidget(m_searchEdit);
     filterLayout->addStretch();
     
     m_totalExpensesLabel = new QLabel("Total: $0.00");
@@ -103,18 +169,44 @@ void MainWindow::setupUI()
     m_addButton = new QPushButton("Add Expense");
     m_editButton = new QPushButton("Edit Selected");
     m_deleteButton = new QPushButton("Delete Selected");
+    m_importButton = new QPushButton("Import...");
     m_generateReportButton = new QPushButton("Generate Report");
+    m_consolidatedReportButton = new QPushButton("All Ledgers");
+    m_consolidatedReportButton->setVisible(m_ledgerComboBox->count() > 1);
     m_manageCategoriesButton = new QPushButton("Manage Categories");
+    m_manageBudgetsButton = new QPushButton("Budgets");
+    m_manageRecurringButton = new QPushButton("Recurring");
+    m_manageDuplicatesButton = new QPushButton("Duplicates");
     
     buttonLayout->addWidget(m_addButton);
     buttonLayout->addWidget(m_editButton);
     buttonLayout->addWidget(m_deleteButton);
+    buttonLayout->addWidget(m_importButton);
     buttonLayout->addWidget(m_generateReportButton);
+    buttonLayout->addWidget(m_consolidatedReportButton);
     buttonLayout->addWidget(m_manageCategoriesButton);
+    buttonLayout->addWidget(m_manageBudgetsButton);
+    buttonLayout->addWidget(m_manageRecurringButton);
+    buttonLayout->addWidget(m_manageDuplicatesButton);
+    
+    // Create paging controls
+    QHBoxLayout* pageLayout = new QHBoxLayout();
+    m_previousPageButton = new QPushButton("Previous");
+    m_nextPageButton = new QPushButton("Next");
+    m_pageLabel = new QLabel();
+    pageLayout->addStretch();
+    pageLayout->addWidget(m_previousPageButton);
+    pageLayout->addWidget(m_pageLabel);
+    pageLayout->addWidget(m_nextPageButton);
+    
+    // Budget utilization stays visible in the status bar
+    m_budgetLabel = new QLabel();
+    statusBar()->addPermanentWidget(m_budgetLabel);
     
     // Add all widgets to main layout
     mainLayout->addWidget(filterGroupBox);
     mainLayout->addWidget(m_expenseTable);
+    mainLayout->addLayout(pageLayout);
     mainLayout->addWidget(inputGroupBox);
     mainLayout->addLayout(buttonLayout);
     
@@ -124,10 +216,41 @@ void MainWindow::setupUI()
     connect(m_addButton, &QPushButton::clicked, this, &MainWindow::addExpense);
     connect(m_editButton, &QPushButton::clicked, this, &MainWindow::editExpense);
     connect(m_deleteButton, &QPushButton::clicked, this, &MainWindow::deleteExpense);
+    connect(m_importButton, &QPushButton::clicked, this, &MainWindow::importExpenses);
     connect(m_generateReportButton, &QPushButton::clicked, this, &MainWindow::generateReport);
+    connect(m_consolidatedReportButton, &QPushButton::clicked, this, &MainWindow::generateConsolidatedReport);
+    connect(m_ledgerComboBox, static_cast<void (QComboBox::*)(int)>(&QComboBox::currentIndexChanged),
+            this, &MainWindow::switchLedger);
     connect(m_manageCategoriesButton, &QPushButton::clicked, this, &MainWindow::manageCategories);
+    connect(m_manageBudgetsButton, &QPushButton::clicked, this, &MainWindow::manageBudgets);
+    connect(m_manageRecurringButton, &QPushButton::clicked, this, &MainWindow::manageRecurring);
+    connect(m_manageDuplicatesButton, &QPushButton::clicked, this, &MainWindow::manageDuplicates);
+    connect(filterButton, &QPushButton::clicked, m_searchEdit, &QLineEdit::clear);
+    connect(filterButton, &QPushButton::clicked, [this]() { m_pageOffset = 0; });
     connect(filterButton, &QPushButton::clicked, this, &MainWindow::filterByMonth);
+    connect(m_searchEdit, &QLineEdit::textChanged, [this]() { m_pageOffset = 0; });
+    connect(m_previousPageButton, &QPushButton::clicked, this, &MainWindow::previousPage);
+    connect(m_nextPageButton, &QPushButton::clicked, this, &MainWindow::nextPage);
     connect(m_expenseTable, &QTableWidget::cellDoubleClicked, this, &MainWindow::editExpense);
+    connect(m_searchEdit, &QLineEdit::textChanged, m_searchTimer, static_cast<void (QTimer::*)()>(&QTimer::start));
+    connect(m_searchTimer, &QTimer::timeout, this, &MainWindow::searchExpenses);
+    
+    // Window-wide so they work from the table; a focused line edit keeps its own undo
+    QShortcut* undoShortcut = new QShortcut(QKeySequence::Undo, this);
+    QShortcut* redoShortcut = new QShortcut(QKeySequence::Redo, this);
+    connect(undoShortcut, &QShortcut::activated, this, &MainWindow::undo);
+    connect(redoShortcut, &QShortcut::activated, this, &MainWindow::redo);
+    
+    // Ctrl+Y too where the platform's redo is Ctrl+Shift+Z; a second binding
+    // for the same keys would make both ambiguous
+    if (!QKeySequence::keyBindings(QKeySequence::Redo).contains(QKeySequence("Ctrl+Y"))) {
+        QShortcut* redoAltShortcut = new QShortcut(QKeySequence("Ctrl+Y"), this);
+        connect(redoAltShortcut, &QShortcut::activated, this, &MainWindow::redo);
+    }
+    
+    // Hidden debug view of the performance metrics
+    QShortcut* metricsShortcut = new QShortcut(QKeySequence("Ctrl+Shift+M"), this);
+    connect(metricsShortcut, &QShortcut::activated, this, &MainWindow::showMetrics);
 }
 
 void MainWindow::updateCategoryComboBox()
@@ -141,13 +264,17 @@ void MainWindow::updateCategoryComboBox()
 
 void MainWindow::updateExpenseTable(const std::vector<Expense>& expenses)
 {
+    PFM_SCOPED_TIMER("MainWindow::updateExpenseTable");
+    PFM_COUNTER_ADD("ui.rows_rendered", expenses.size());
     m_expenseTable->setRowCount(0);
     
     for (const auto& expense : expenses) {
         int row = m_expenseTable->rowCount();
         m_expenseTable->insertRow(row);
         
-        m_expenseTable->setItem(row, 0, new QTableWidgetItem(QString::number(expense.id)));
+        // Projected recurring rows have no id of their own yet
+        bool projected = isProjectedExpense(expense);
+        m_expenseTable->setItem(row, 0, new QTableWidgetItem(projected ? QString("Scheduled") : QString::number(expense.id)));
         m_expenseTable->setItem(row, 1, new QTableWidgetItem(QString::fromStdString(expense.date)));
         m_expenseTable->setItem(row, 2, new QTableWidgetItem(QString::fromStdString(expense.category)));
         m_expenseTable->setItem(row, 3, new QTableWidgetItem(QString::fromStdString(expense.description)));
@@ -155,13 +282,41 @@ void MainWindow::updateExpenseTable(const std::vector<Expense>& expenses)
         QTableWidgetItem* amountItem = new QTableWidgetItem(QString("$%1").arg(expense.amount, 0, 'f', 2));
         amountItem->setTextAlignment(Qt::AlignRight | Qt::AlignVCenter);
         m_expenseTable->setItem(row, 4, amountItem);
+        
+        if (projected) {
+            for (int column = 0; column < m_expenseTable->columnCount(); ++column) {
+                QTableWidgetItem* item = m_expenseTable->item(row, column);
+                QFont font = item->font();
+                font.setItalic(true);
+                item->setFont(font);
+                item->setForeground(QColor("#757575"));
+            }
+        }
+    }
+}
+
+QueryResult MainWindow::showQueryPage(ExpenseQuery query)
+{
+    query.offset = m_pageOffset;
+    query.limit = kPageSize;
+    QueryResult result = m_expenseManager->query(query);
+    
+    // Deletions may have emptied the page; fall back to the last one
+    if (result.rows.empty() && m_pageOffset > 0) {
+        m_pageOffset = result.totalMatches > 0 ? (result.totalMatches - 1) / kPageSize * kPageSize : 0;
+        query.offset = m_pageOffset;
+        result = m_expenseManager->query(query);
     }
     
-    // Calculate and display total
-    int year = m_yearComboBox->currentData().toInt();
-    int month = m_monthComboBox->currentData().toInt();
-    double total = m_expenseManager->getTotalExpenses(year, month);
-    m_totalExpensesLabel->setText(QString("Total: $%1").arg(total, 0, 'f', 2));
+    updateExpenseTable(result.rows);
+    
+    m_pageLabel->setText(QString("Rows %1-%2 of %3")
+                         .arg(static_cast<qulonglong>(result.rows.empty() ? 0 : m_pageOffset + 1))
+                         .arg(static_cast<qulonglong>(m_pageOffset + result.rows.size()))
+                         .arg(static_cast<qulonglong>(result.totalMatches)));
+    m_previousPageButton->setEnabled(m_pageOffset > 0);
+    m_nextPageButton->setEnabled(m_pageOffset + result.rows.size() < result.totalMatches);
+    return result;
 }
 
 int MainWindow::getSelectedExpenseId() const
@@ -193,6 +348,27 @@ void MainWindow::addExpense()
     expense.category = m_categoryComboBox->currentText().toStdString();
     expense.date = m_dateEdit->date().toString("yyyy-MM-dd").toStdString();
     
+    // Catch double entries up front; the duplicate policy decides whether to ask
+    DuplicatePolicy policy = m_expenseManager->getDuplicatePolicy();
+    std::vector<Expense> duplicates;
+    if (policy != DuplicatePolicy::Allow) {
+        duplicates = m_expenseManager->findDuplicates(expense);
+    }
+    if (!duplicates.empty()) {
+        QString message = QString("This looks like a duplicate of expense %1 (%2, $%3).")
+                              .arg(duplicates.front().id)
+                              .arg(QString::fromStdString(duplicates.front().date))
+                              .arg(duplicates.front().amount, 0, 'f', 2);
+        if (policy == DuplicatePolicy::Reject) {
+            QMessageBox::warning(this, "Duplicate Expense", message + " It was not added.");
+            return;
+        }
+        if (QMessageBox::question(this, "Duplicate Expense", message + " Add it anyway?",
+                                  QMessageBox::Yes | QMessageBox::No) != QMessageBox::Yes) {
+            return;
+        }
+    }
+    
     if (m_expenseManager->addExpense(expense)) {
         refreshData();
         
@@ -211,24 +387,26 @@ void MainWindow::editExpense()
         QMessageBox::warning(this, "Warning", "Please select an expense to edit.");
         return;
     }
+    if (expenseId == 0) {
+        QMessageBox::information(this, "Scheduled Expense",
+                                 "This is an upcoming recurring expense. Change it under Recurring.");
+        return;
+    }
     
-    // Find the expense in the list
-    std::vector<Expense> expenses = m_expenseManager->getAllExpenses();
-    auto it = std::find_if(expenses.begin(), expenses.end(),
-                         [expenseId](const Expense& e) { return e.id == expenseId; });
-    
-    if (it != expenses.end()) {
+    // Look up the expense by id
+    Expense expense;
+    if (m_expenseManager->getExpense(expenseId, expense)) {
         // Populate form with expense data
-        m_amountSpinBox->setValue(it->amount);
-        m_descriptionEdit->setText(QString::fromStdString(it->description));
-        m_categoryComboBox->setCurrentText(QString::fromStdString(it->category));
-        m_dateEdit->setDate(QDate::fromString(QString::fromStdString(it->date), "yyyy-MM-dd"));
+        m_amountSpinBox->setValue(expense.amount);
+        m_descriptionEdit->setText(QString::fromStdString(expense.description));
+        m_categoryComboBox->setCurrentText(QString::fromStdString(expense.category));
+        m_dateEdit->setDate(QDate::fromString(QString::fromStdString(expense.date), "yyyy-MM-dd"));
         
         // Ask for confirmation
         if (QMessageBox::question(this, "Edit Expense", 
                                 "Update this expense with the new values?",
                                 QMessageBox::Yes | QMessageBox::No) == QMessageBox::Yes) {
-            Expense updatedExpense = *it;
+            Expense updatedExpense = expense;
             updatedExpense.amount = m_amountSpinBox->value();
             updatedExpense.description = m_descriptionEdit->text().toStdString();
             updatedExpense.category = m_categoryComboBox->currentText().toStdString();
@@ -254,18 +432,162 @@ void MainWindow::deleteExpense()
         QMessageBox::warning(this, "Warning", "Please select an expense to delete.");
         return;
     }
+    if (expenseId == 0) {
+        QMessageBox::information(this, "Scheduled Expense",
+                                 "This is an upcoming recurring expense. Change it under Recurring.");
+        return;
+    }
     
     if (QMessageBox::question(this, "Delete Expense", 
                             "Are you sure you want to delete this expense?",
                             QMessageBox::Yes | QMessageBox::No) == QMessageBox::Yes) {
         if (m_expenseManager->deleteExpense(expenseId)) {
             refreshData();
+            statusBar()->showMessage("Expense deleted. Press Ctrl+Z to undo.", 5000);
         } else {
             QMessageBox::critical(this, "Error", "Failed to delete expense.");
         }
     }
 }
 
+void MainWindow::checkStorage()
+{
+    for (const auto& name : m_workspace->getLedgerNames()) {
+        std::shared_ptr<ExpenseManager> ledger = m_workspace->ledger(name);
+        if (ledger) {
+            checkLedgerStorage(QString::fromStdString(name), ledger.get());
+        }
+    }
+}
+
+void MainWindow::checkLedgerStorage(const QString& name, ExpenseManager* ledger)
+{
+    StorageReport report = ledger->verifyStorage();
+    if (report.ok()) {
+        return;
+    }
+    
+    QStringList problems;
+    if (!report.manifestReadable) {
+        problems << "The ledger index could not be read. Changes will not be saved until it is recovered.";
+    }
+    for (const auto& partition : report.partitions) {
+        QString file = QString::fromStdString(partition.fileName);
+        if (partition.status == PartitionStatus::Missing) {
+            problems << QString("%1 is missing (%2 expenses).").arg(file).arg(partition.expectedRows);
+        } else if (partition.status == PartitionStatus::Damaged) {
+            problems << QString("%1 is damaged in %2 month(s).").arg(file).arg(partition.damagedMonths.size());
+        }
+    }
+    
+    if (QMessageBox::warning(this, "Damaged Ledger",
+                             QString("Ledger \"%1\":\n").arg(name) + problems.join("\n") +
+                             "\n\nRecover everything that can still be read? The damaged files are kept as copies.",
+                             QMessageBox::Yes | QMessageBox::No) != QMessageBox::Yes) {
+        return;
+    }
+    
+    RecoveryReport recovery = ledger->recoverData();
+    if (ledger == m_expenseManager) {
+        updateCategoryComboBox();
+        refreshData();
+    }
+    
+    QString message = QString("Recovered %1 expenses from damaged files.").arg(recovery.rowsRecovered);
+    if (recovery.rowsLost > 0) {
+        message += QString(" %1 could not be read.").arg(recovery.rowsLost);
+    }
+    if (recovery.manifestRebuilt) {
+        message += " The ledger index was rebuilt; budgets and recurring expenses need to be set up again.";
+    }
+    QMessageBox::information(this, "Recovery", message);
+}
+
+void MainWindow::undo()
+{
+    QString description = QString::fromStdString(m_expenseManager->undoDescription());
+    if (description.isEmpty()) {
+        statusBar()->showMessage("Nothing to undo.", 3000);
+        return;
+    }
+    
+    if (m_expenseManager->undo()) {
+        updateCategoryComboBox();
+        refreshData();
+        statusBar()->showMessage("Undone: " + description, 5000);
+    } else {
+        QMessageBox::critical(this, "Error", "Failed to undo: " + description);
+    }
+}
+
+void MainWindow::redo()
+{
+    QString description = QString::fromStdString(m_expenseManager->redoDescription());
+    if (description.isEmpty()) {
+        statusBar()->showMessage("Nothing to redo.", 3000);
+        return;
+    }
+    
+    if (m_expenseManager->redo()) {
+        updateCategoryComboBox();
+        refreshData();
+        statusBar()->showMessage("Redone: " + description, 5000);
+    } else {
+        QMessageBox::critical(this, "Error", "Failed to redo: " + description);
+    }
+}
+
+void MainWindow::importExpenses()
+{
+    QString fileName = QFileDialog::getOpenFileName(this, "Import Expenses", QString(),
+                                                    "Bank Statements (*.csv *.ofx *.qfx);;All Files (*)");
+    if (fileName.isEmpty()) {
+        return;
+    }
+    
+    ExpenseImporter importer(m_expenseManager);
+    
+    // Optional rule table mapping bank categories and payees onto ours
+    if (!importer.loadCategoryRules("import_rules.json")) {
+        importer.setDefaultCategory("Miscellaneous");
+    }
+    
+    QApplication::setOverrideCursor(Qt::WaitCursor);
+    ImportResult result = importer.importFile(fileName.toStdString());
+    QApplication::restoreOverrideCursor();
+    
+    if (!result.success) {
+        QMessageBox::critical(this, "Import Failed",
+                              result.errors.empty() ? QString("Failed to save imported expenses.")
+                                                    : QString::fromStdString(result.errors.front().message));
+        return;
+    }
+    
+    refreshData();
+    
+    QMessageBox summary(this);
+    summary.setWindowTitle("Import Complete");
+    summary.setIcon(result.errors.empty() ? QMessageBox::Information : QMessageBox::Warning);
+    summary.setText(QString("Imported %1 of %2 rows (%3 rejected, %4 already in the ledger).\n"
+                            "%5 rows/s, %6 MB/s parse, %7 s commit.")
+                    .arg(result.rowsImported)
+                    .arg(result.rowsRead)
+                    .arg(result.errors.size())
+                    .arg(result.duplicateRows)
+                    .arg(result.rowsPerSecond(), 0, 'f', 0)
+                    .arg(result.megabytesPerSecond(), 0, 'f', 1)
+                    .arg(result.commitSeconds, 0, 'f', 2));
+    
+    if (!result.errors.empty()) {
+        QString details;
+        for (const auto& error : result.errors) {
+            details += QString("Line %1: %2\n").arg(error.line).arg(QString::fromStdString(error.message));
+        }
+        summary.setDetailedText(details);
+    }
+    summary.exec();
+}
+
 void MainWindow::manageCategories()
 {
     CategoryDialog dialog(m_expenseManager, this);
@@ -275,17 +597,125 @@ void MainWindow::manageCategories()
     updateCategoryComboBox();
 }
 
+void MainWindow::manageBudgets()
+{
+    BudgetDialog dialog(m_expenseManager, m_yearComboBox->currentData().toInt(),
+                        m_monthComboBox->currentData().toInt(), this);
+    dialog.exec();
+    
+    updateBudgetStatus();
+}
+
+void MainWindow::manageRecurring()
+{
+    RecurringDialog dialog(m_expenseManager, this);
+    dialog.exec();
+    
+    refreshData();
+}
+
+void MainWindow::manageDuplicates()
+{
+    DuplicateDialog dialog(m_expenseManager, this);
+    dialog.exec();
+    
+    refreshData();
+}
+
+void MainWindow::updateBudgetStatus()
+{
+    // Read from running totals, so this costs the same on any ledger size
+    int year = m_yearComboBox->currentData().toInt();
+    int month = m_monthComboBox->currentData().toInt();
+    
+    QStringList parts;
+    for (const auto& status : m_expenseManager->getBudgetStatus(year, month)) {
+        QString part = QString("%1 %2%").arg(budgetName(status.budget)).arg(status.utilization() * 100.0, 0, 'f', 0);
+        if (status.utilization() >= 1.0) {
+            part = QString("<span style=\"color:#c62828\">%1</span>").arg(part.toHtmlEscaped());
+        } else {
+            part = part.toHtmlEscaped();
+        }
+        parts << part;
+    }
+    
+    m_budgetLabel->setText(parts.isEmpty() ? QString() : "Budgets: " + parts.join(" | "));
+}
+
+void MainWindow::showBudgetAlert(const BudgetAlert& alert)
+{
+    QString period = alert.status.month > 0
+        ? QDate(alert.status.year, alert.status.month, 1).toString("MMMM yyyy")
+        : QString::number(alert.status.year);
+    QString message = QString("%1 budget for %2: $%3 of $%4 spent (%5%)")
+                          .arg(budgetName(alert.status.budget))
+                          .arg(period)
+                          .arg(alert.status.spent, 0, 'f', 2)
+                          .arg(alert.status.budget.limit, 0, 'f', 2)
+                          .arg(alert.status.utilization() * 100.0, 0, 'f', 0);
+    
+    updateBudgetStatus();
+    if (alert.threshold >= 1.0) {
+        QMessageBox::warning(this, "Budget Exceeded", message);
+    } else {
+        statusBar()->showMessage(message, 10000);
+    }
+}
+
 void MainWindow::generateReport()
 {
     int year = m_yearComboBox->currentData().toInt();
     int month = m_monthComboBox->currentData().toInt();
     
-    showReport(year, month);
+    showReport(year, month, false);
+}
+
+void MainWindow::generateConsolidatedReport()
+{
+    int year = m_yearComboBox->currentData().toInt();
+    int month = m_monthComboBox->currentData().toInt();
+    
+    showReport(year, month, true);
+}
+
+void MainWindow::switchLedger(int index)
+{
+    std::shared_ptr<ExpenseManager> ledger = m_workspace->ledger(m_ledgerComboBox->itemText(index).toStdString());
+    if (!ledger || ledger == m_ledger) {
+        return;
+    }
+    
+    // Nothing is loaded here: the ledger has been open, with its caches, since startup
+    m_expenseManager->setBudgetAlertCallback(nullptr);
+    m_ledger = ledger;
+    m_expenseManager = ledger.get();
+    watchBudgetAlerts();
+    
+    m_pageOffset = 0;
+    m_caughtUpThrough.clear();
+    updateCategoryComboBox();
+    refreshData();
+    statusBar()->showMessage("Switched to " + m_ledgerComboBox->itemText(index), 3000);
 }
 
 void MainWindow::refreshData()
 {
-    filterByMonth();
+    PFM_SCOPED_TIMER("MainWindow::refreshData");
+    
+    // Store recurring expenses that came due while the window was open. The
+    // catch-up takes the ledger's write lock, so only try once the date changes.
+    std::string today = DateUtils::today();
+    if (today != m_caughtUpThrough) {
+        m_expenseManager->materializeRecurring(today);
+        m_caughtUpThrough = today;
+    }
+    
+    if (m_searchEdit->text().trimmed().isEmpty()) {
+        filterByMonth();
+    } else {
+        searchExpenses();
+    }
+    updateBudgetStatus();
 }
 
 void MainWindow::filterByMonth()
@@ -293,16 +723,50 @@ void MainWindow::filterByMonth()
     int year = m_yearComboBox->currentData().toInt();
     int month = m_monthComboBox->currentData().toInt();
     
-    std::vector<Expense> expenses = m_expenseManager->getExpensesByMonth(year, month);
-    updateExpenseTable(expenses);
+    // Upcoming recurring expenses are listed alongside the stored ones
+    ExpenseQuery query = ExpenseQuery::forMonth(year, month);
+    query.includeProjected = true;
+    QueryResult result = showQueryPage(query);
+    m_totalExpensesLabel->setText(QString("Total: $%1").arg(result.totalAmount, 0, 'f', 2));
 }
 
-void MainWindow::showReport(int year, int month)
+void MainWindow::searchExpenses()
+{
+    QString query = m_searchEdit->text().trimmed();
+    if (query.isEmpty()) {
+        filterByMonth();
+        return;
+    }
+    
+    // Searches the whole history, newest first, one page at a time
+    ExpenseQuery expenseQuery;
+    expenseQuery.text = query.toStdString();
+    QueryResult result = showQueryPage(expenseQuery);
+    
+    m_totalExpensesLabel->setText(QString("Matches: %1, Total: $%2")
+                                  .arg(static_cast<qulonglong>(result.totalMatches))
+                                  .arg(result.totalAmount, 0, 'f', 2));
+}
+
+void MainWindow::previousPage()
+{
+    m_pageOffset -= std::min(m_pageOffset, kPageSize);
+    refreshData();
+}
+
+void MainWindow::nextPage()
+{
+    m_pageOffset += kPageSize;
+    refreshData();
+}
+
+void MainWindow::showReport(int year, int month, bool allLedgers)
 {
     QDialog* reportDialog = new QDialog(this);
-    reportDialog->setWindowTitle(QString("Expense Report - %1 %2")
+    reportDialog->setWindowTitle(QString("Expense Report - %1 %2 - %3")
                                .arg(m_monthComboBox->currentText())
-                               .arg(year));
+                               .arg(year)
+                               .arg(allLedgers ? QString("All Ledgers") : m_ledgerComboBox->currentText()));
     reportDialog->setMinimumSize(600, 400);
     
     QVBoxLayout* layout = new QVBoxLayout(reportDialog);
@@ -315,9 +779,10 @@ void MainWindow::showReport(int year, int month)
     // Add pie series
     QPieSeries* series = new QPieSeries();
     
-    // Get category summary
-    std::map<std::string, double> categorySummary = 
-        m_expenseManager->generateCategorySummary(year, month);
+    // Get category summary; across ledgers, each is summarized on its own thread
+    std::map<std::string, double> categorySummary = allLedgers
+        ? m_workspace->consolidatedReport(year, month).categories
+        : m_expenseManager->generateCategorySummary(year, month);
     
     // Add slices and calculate total
     double total = 0.0;
@@ -415,6 +880,114 @@ void MainWindow::showReport(int year, int month)
     reportDialog->exec();
 }
 
+void MainWindow::showMetrics()
+{
+    QDialog* metricsDialog = new QDialog(this);
+    metricsDialog->setAttribute(Qt::WA_DeleteOnClose);
+    metricsDialog->setWindowTitle("Performance Metrics");
+    metricsDialog->setMinimumSize(700, 500);
+    
+    QVBoxLayout* layout = new QVBoxLayout(metricsDialog);
+    if (!Metrics::isCompiledIn()) {
+        layout->addWidget(new QLabel("Metrics are disabled in this build (PFM_ENABLE_METRICS=OFF)."));
+    }
+    
+    // Create timer and counter tables
+    QTableWidget* timerTable = new QTableWidget();
+    timerTable->setColumnCount(7);
+    timerTable->setHorizontalHeaderLabels({"Timer", "Count", "Mean (ms)", "p50 (ms)", "p90 (ms)", "p99 (ms)", "Max (ms)"});
+    timerTable->horizontalHeader()->setSectionResizeMode(0, QHeaderView::Stretch);
+    timerTable->setEditTriggers(QAbstractItemView::NoEditTriggers);
+    timerTable->verticalHeader()->setVisible(false);
+    
+    QTableWidget* counterTable = new QTableWidget();
+    counterTable->setColumnCount(2);
+    counterTable->setHorizontalHeaderLabels({"Counter", "Value"});
+    counterTable->horizontalHeader()->setSectionResizeMode(0, QHeaderView::Stretch);
+    counterTable->setEditTriggers(QAbstractItemView::NoEditTriggers);
+    counterTable->verticalHeader()->setVisible(false);
+    
+    QCheckBox* traceCheckBox = new QCheckBox("Record trace");
+    traceCheckBox->setChecked(Metrics::instance().isTracing());
+    QLabel* traceLabel = new QLabel();
+    
+    auto refresh = [=]() {
+        MetricsReport report = Metrics::instance().report();
+        
+        timerTable->setRowCount(0);
+        for (const auto& timer : report.timers) {
+            int row = timerTable->rowCount();
+            timerTable->insertRow(row);
+            timerTable->setItem(row, 0, new QTableWidgetItem(QString::fromStdString(timer.name)));
+            
+            QStringList values = {
+                QString::number(timer.count),
+                QString::number(timer.meanMs, 'f', 3),
+                QString::number(timer.p50Ms, 'f', 3),
+                QString::number(timer.p90Ms, 'f', 3),
+                QString::number(timer.p99Ms, 'f', 3),
+                QString::number(timer.maxMs, 'f', 3)
+            };
+            for (int column = 0; column < values.size(); ++column) {
+                QTableWidgetItem* item = new QTableWidgetItem(values[column]);
+                item->setTextAlignment(Qt::AlignRight | Qt::AlignVCenter);
+                timerTable->setItem(row, column + 1, item);
+            }
+        }
+        
+        counterTable->setRowCount(0);
+        for (const auto& counter : report.counters) {
+            int row = counterTable->rowCount();
+            counterTable->insertRow(row);
+            counterTable->setItem(row, 0, new QTableWidgetItem(QString::fromStdString(counter.first)));
+            QTableWidgetItem* item = new QTableWidgetItem(QString::number(counter.second));
+            item->setTextAlignment(Qt::AlignRight | Qt::AlignVCenter);
+            counterTable->setItem(row, 1, item);
+        }
+        
+        traceLabel->setText(QString("Trace events: %1").arg(Metrics::instance().traceEventCount()));
+    };
+    
+    QPushButton* refreshButton = new QPushButton("Refresh");
+    QPushButton* resetButton = new QPushButton("Reset");
+    QPushButton* saveTraceButton = new QPushButton("Save Trace...");
+    QPushButton* closeButton = new QPushButton("Close");
+    
+    connect(refreshButton, &QPushButton::clicked, refresh);
+    connect(resetButton, &QPushButton::clicked, [=]() {
+        Metrics::instance().reset();
+        refresh();
+    });
+    connect(traceCheckBox, &QCheckBox::toggled, [](bool checked) {
+        Metrics::instance().setTracing(checked);
+    });
+    connect(saveTraceButton, &QPushButton::clicked, [=]() {
+        QString fileName = QFileDialog::getSaveFileName(metricsDialog, "Save Trace",
+                                                       "pfm_trace.json", "Chrome Trace (*.json)");
+        if (!fileName.isEmpty() && !Metrics::instance().writeChromeTrace(fileName.toStdString())) {
+            QMessageBox::critical(metricsDialog, "Save Failed", "Failed to write the trace file.");
+        }
+    });
+    connect(closeButton, &QPushButton::clicked, metricsDialog, &QDialog::accept);
+    
+    QHBoxLayout* buttonLayout = new QHBoxLayout();
+    buttonLayout->addWidget(traceCheckBox);
+    buttonLayout->addWidget(traceLabel);
+    buttonLayout->addStretch();
+    buttonLayout->addWidget(refreshButton);
+    buttonLayout->addWidget(resetButton);
+    buttonLayout->addWidget(saveTraceButton);
+    buttonLayout->addWidget(closeButton);
+    
+    // Add widgets to layout
+    layout->addWidget(timerTable, 2);
+    layout->addWidget(counterTable, 1);
+    layout->addLayout(buttonLayout);
+    
+    refresh();
+    metricsDialog->show();
+}
+
 // CategoryDialog implementation
 MainWindow::CategoryDialog::CategoryDialog(ExpenseManager* manager, QWidget* parent)
     : QDialog(parent), m_manager(manager)
@@ -577,4 +1150,521 @@ void MainWindow::CategoryDialog::selectCategory(int row, int column)
     
     m_nameEdit->setText(name);
     m_descriptionEdit->setText(description);
-}
\ No newline at end of file
+}
+// BudgetDialog implementation
+MainWindow::BudgetDialog::BudgetDialog(ExpenseManager* manager, int year, int month, QWidget* parent)
+    : QDialog(parent), m_manager(manager), m_year(year), m_month(month)
+{
+    setWindowTitle("Budgets");
+    setMinimumSize(550, 350);
+    
+    setupUI();
+    refreshBudgets();
+}
+
+void MainWindow::BudgetDialog::setupUI()
+{
+    QVBoxLayout* mainLayout = new QVBoxLayout(this);
+    
+    // Create budget table
+    m_budgetTable = new QTableWidget();
+    m_budgetTable->setColumnCount(5);
+    m_budgetTable->setHorizontalHeaderLabels({"Category", "Period", "Limit", "Spent", "Used"});
+    m_budgetTable->setSelectionBehavior(QAbstractItemView::SelectRows);
+    m_budgetTable->setSelectionMode(QAbstractItemView::SingleSelection);
+    m_budgetTable->setEditTriggers(QAbstractItemView::NoEditTriggers);
+    m_budgetTable->horizontalHeader()->setSectionResizeMode(0, QHeaderView::Stretch);
+    m_budgetTable->verticalHeader()->setVisible(false);
+    
+    // Create form for setting budgets
+    QGroupBox* inputGroupBox = new QGroupBox("Set Budget");
+    QFormLayout* formLayout = new QFormLayout(inputGroupBox);
+    
+    m_categoryComboBox = new QComboBox();
+    m_categoryComboBox->addItem("All spending", QString());
+    for (const auto& category : m_manager->getAllCategories()) {
+        QString name = QString::fromStdString(category.name);
+        m_categoryComboBox->addItem(name, name);
+    }
+    
+    m_periodComboBox = new QComboBox();
+    m_periodComboBox->addItem("Monthly", static_cast<int>(BudgetPeriod::Monthly));
+    m_periodComboBox->addItem("Yearly", static_cast<int>(BudgetPeriod::Yearly));
+    
+    m_limitSpinBox = new QDoubleSpinBox();
+    m_limitSpinBox->setRange(0.01, 100000000.00);
+    m_limitSpinBox->setPrefix("$");
+    m_limitSpinBox->setDecimals(2);
+    
+    formLayout->addRow("Category:", m_categoryComboBox);
+    formLayout->addRow("Period:", m_periodComboBox);
+    formLayout->addRow("Limit:", m_limitSpinBox);
+    
+    // Create buttons
+    QHBoxLayout* buttonLayout = new QHBoxLayout();
+    
+    m_setButton = new QPushButton("Set");
+    m_removeButton = new QPushButton("Remove");
+    
+    buttonLayout->addWidget(m_setButton);
+    buttonLayout->addWidget(m_removeButton);
+    
+    // Close button
+    QPushButton* closeButton = new QPushButton("Close");
+    
+    // Add all widgets to main layout
+    mainLayout->addWidget(new QLabel(QString("Spending for %1").arg(QDate(m_year, m_month, 1).toString("MMMM yyyy"))));
+    mainLayout->addWidget(m_budgetTable);
+    mainLayout->addWidget(inputGroupBox);
+    mainLayout->addLayout(buttonLayout);
+    mainLayout->addWidget(closeButton);
+    
+    // Connect signals and slots
+    connect(m_setButton, &QPushButton::clicked, this, &BudgetDialog::setBudget);
+    connect(m_removeButton, &QPushButton::clicked, this, &BudgetDialog::removeBudget);
+    connect(closeButton, &QPushButton::clicked, this, &QDialog::accept);
+    connect(m_budgetTable, &QTableWidget::cellClicked, this, &BudgetDialog::selectBudget);
+}
+
+void MainWindow::BudgetDialog::refreshBudgets()
+{
+    m_budgetTable->setRowCount(0);
+    
+    for (const auto& status : m_manager->getBudgetStatus(m_year, m_month)) {
+        int row = m_budgetTable->rowCount();
+        m_budgetTable->insertRow(row);
+        
+        QTableWidgetItem* categoryItem = new QTableWidgetItem(
+            status.budget.isOverall() ? QString("All spending") : QString::fromStdString(status.budget.category));
+        categoryItem->setData(Qt::UserRole, QString::fromStdString(status.budget.category));
+        m_budgetTable->setItem(row, 0, categoryItem);
+        
+        QTableWidgetItem* periodItem = new QTableWidgetItem(
+            status.budget.period == BudgetPeriod::Yearly ? "Yearly" : "Monthly");
+        periodItem->setData(Qt::UserRole, static_cast<int>(status.budget.period));
+        m_budgetTable->setItem(row, 1, periodItem);
+        
+        QStringList values = {
+            QString("$%1").arg(status.budget.limit, 0, 'f', 2),
+            QString("$%1").arg(status.spent, 0, 'f', 2),
+            QString("%1%").arg(status.utilization() * 100.0, 0, 'f', 0)
+        };
+        for (int column = 0; column < values.size(); ++column) {
+            QTableWidgetItem* item = new QTableWidgetItem(values[column]);
+            item->setTextAlignment(Qt::AlignRight | Qt::AlignVCenter);
+            if (status.utilization() >= 1.0) {
+                item->setForeground(QColor("#c62828"));
+            }
+            m_budgetTable->setItem(row, column + 2, item);
+        }
+        m_budgetTable->item(row, 2)->setData(Qt::UserRole, status.budget.limit);
+    }
+}
+
+void MainWindow::BudgetDialog::setBudget()
+{
+    Budget budget(m_categoryComboBox->currentData().toString().toStdString(),
+                  static_cast<BudgetPeriod>(m_periodComboBox->currentData().toInt()),
+                  m_limitSpinBox->value());
+    
+    if (m_manager->setBudget(budget)) {
+        refreshBudgets();
+    } else {
+        QMessageBox::critical(this, "Error", "Failed to set budget.");
+    }
+}
+
+void MainWindow::BudgetDialog::removeBudget()
+{
+    QList<QTableWidgetItem*> selectedItems = m_budgetTable->selectedItems();
+    if (selectedItems.isEmpty()) {
+        QMessageBox::warning(this, "Warning", "Please select a budget to remove.");
+        return;
+    }
+    
+    int row = selectedItems.first()->row();
+    std::string category = m_budgetTable->item(row, 0)->data(Qt::UserRole).toString().toStdString();
+    BudgetPeriod period = static_cast<BudgetPeriod>(m_budgetTable->item(row, 1)->data(Qt::UserRole).toInt());
+    
+    if (m_manager->removeBudget(category, period)) {
+        refreshBudgets();
+    } else {
+        QMessageBox::critical(this, "Error", "Failed to remove budget.");
+    }
+}
+
+void MainWindow::BudgetDialog::selectBudget(int row, int column)
+{
+    Q_UNUSED(column);
+    
+    m_categoryComboBox->setCurrentIndex(m_categoryComboBox->findData(m_budgetTable->item(row, 0)->data(Qt::UserRole)));
+    m_periodComboBox->setCurrentIndex(m_periodComboBox->findData(m_budgetTable->item(row, 1)->data(Qt::UserRole)));
+    m_limitSpinBox->setValue(m_budgetTable->item(row, 2)->data(Qt::UserRole).toDouble());
+}
+
+// RecurringDialog implementation
+MainWindow::RecurringDialog::RecurringDialog(ExpenseManager* manager, QWidget* parent)
+    : QDialog(parent), m_manager(manager)
+{
+    setWindowTitle("Recurring Expenses");
+    setMinimumSize(650, 450);
+    
+    setupUI();
+    refreshRules();
+}
+
+void MainWindow::RecurringDialog::setupUI()
+{
+    QVBoxLayout* mainLayout = new QVBoxLayout(this);
+    
+    // Create rule table
+    m_ruleTable = new QTableWidget();
+    m_ruleTable->setColumnCount(6);
+    m_ruleTable->setHorizontalHeaderLabels({"ID", "Description", "Category", "Amount", "Schedule", "Dates"});
+    m_ruleTable->setSelectionBehavior(QAbstractItemView::SelectRows);
+    m_ruleTable->setSelectionMode(QAbstractItemView::SingleSelection);
+    m_ruleTable->setEditTriggers(QAbstractItemView::NoEditTriggers);
+    m_ruleTable->horizontalHeader()->setSectionResizeMode(1, QHeaderView::Stretch);
+    m_ruleTable->verticalHeader()->setVisible(false);
+    
+    // Create form for adding/editing rules
+    QGroupBox* inputGroupBox = new QGroupBox("Recurring Expense Details");
+    QFormLayout* formLayout = new QFormLayout(inputGroupBox);
+    
+    m_descriptionEdit = new QLineEdit();
+    
+    m_categoryComboBox = new QComboBox();
+    for (const auto& category : m_manager->getAllCategories()) {
+        m_categoryComboBox->addItem(QString::fromStdString(category.name));
+    }
+    
+    m_amountSpinBox = new QDoubleSpinBox();
+    m_amountSpinBox->setRange(0.01, 1000000.00);
+    m_amountSpinBox->setPrefix("$");
+    m_amountSpinBox->setDecimals(2);
+    
+    m_frequencyComboBox = new QComboBox();
+    m_frequencyComboBox->addItem("Months", static_cast<int>(RecurrenceFrequency::Monthly));
+    m_frequencyComboBox->addItem("Weeks", static_cast<int>(RecurrenceFrequency::Weekly));
+    m_frequencyComboBox->addItem("Days", static_cast<int>(RecurrenceFrequency::Custom));
+    
+    m_intervalSpinBox = new QSpinBox();
+    m_intervalSpinBox->setRange(1, 365);
+    
+    QHBoxLayout* scheduleLayout = new QHBoxLayout();
+    scheduleLayout->addWidget(new QLabel("Every"));
+    scheduleLayout->addWidget(m_intervalSpinBox);
+    scheduleLayout->addWidget(m_frequencyComboBox);
+    scheduleLayout->addStretch();
+    
+    m_startDateEdit = new QDateEdit(QDate::currentDate());
+    m_startDateEdit->setCalendarPopup(true);
+    m_startDateEdit->setDisplayFormat("yyyy-MM-dd");
+    
+    m_endCheckBox = new QCheckBox("Ends on");
+    m_endDateEdit = new QDateEdit(QDate::currentDate().addYears(1));
+    m_endDateEdit->setCalendarPopup(true);
+    m_endDateEdit->setDisplayFormat("yyyy-MM-dd");
+    m_endDateEdit->setEnabled(false);
+    
+    QHBoxLayout* endLayout = new QHBoxLayout();
+    endLayout->addWidget(m_endCheckBox);
+    endLayout->addWidget(m_endDateEdit);
+    endLayout->addStretch();
+    
+    formLayout->addRow("Description:", m_descriptionEdit);
+    formLayout->addRow("Category:", m_categoryComboBox);
+    formLayout->addRow("Amount:", m_amountSpinBox);
+    formLayout->addRow("Repeats:", scheduleLayout);
+    formLayout->addRow("First date:", m_startDateEdit);
+    formLayout->addRow("", endLayout);
+    
+    // Create buttons
+    QHBoxLayout* buttonLayout = new QHBoxLayout();
+    
+    m_addButton = new QPushButton("Add");
+    m_updateButton = new QPushButton("Update");
+    m_deleteButton = new QPushButton("Delete");
+    
+    buttonLayout->addWidget(m_addButton);
+    buttonLayout->addWidget(m_updateButton);
+    buttonLayout->addWidget(m_deleteButton);
+    
+    // Close button
+    QPushButton* closeButton = new QPushButton("Close");
+    
+    // Add all widgets to main layout
+    mainLayout->addWidget(new QLabel("Due occurrences are added as expenses; upcoming ones are shown as scheduled."));
+    mainLayout->addWidget(m_ruleTable);
+    mainLayout->addWidget(inputGroupBox);
+    mainLayout->addLayout(buttonLayout);
+    mainLayout->addWidget(closeButton);
+    
+    // Connect signals and slots
+    connect(m_addButton, &QPushButton::clicked, this, &RecurringDialog::addRule);
+    connect(m_updateButton, &QPushButton::clicked, this, &RecurringDialog::updateRule);
+    connect(m_deleteButton, &QPushButton::clicked, this, &RecurringDialog::deleteRule);
+    connect(closeButton, &QPushButton::clicked, this, &QDialog::accept);
+    connect(m_endCheckBox, &QCheckBox::toggled, m_endDateEdit, &QDateEdit::setEnabled);
+    connect(m_ruleTable, &QTableWidget::cellClicked, this, &RecurringDialog::selectRule);
+}
+
+void MainWindow::RecurringDialog::refreshRules()
+{
+    m_ruleTable->setRowCount(0);
+    
+    for (const auto& rule : m_manager->getRecurringRules()) {
+        int row = m_ruleTable->rowCount();
+        m_ruleTable->insertRow(row);
+        
+        QString dates = QString::fromStdString(rule.startDate) + " to " +
+                        (rule.endDate.empty() ? QString("no end") : QString::fromStdString(rule.endDate));
+        
+        m_ruleTable->setItem(row, 0, new QTableWidgetItem(QString::number(rule.id)));
+        m_ruleTable->setItem(row, 1, new QTableWidgetItem(QString::fromStdString(rule.description)));
+        m_ruleTable->setItem(row, 2, new QTableWidgetItem(QString::fromStdString(rule.category)));
+        
+        QTableWidgetItem* amountItem = new QTableWidgetItem(QString("$%1").arg(rule.amount, 0, 'f', 2));
+        amountItem->setTextAlignment(Qt::AlignRight | Qt::AlignVCenter);
+        m_ruleTable->setItem(row, 3, amountItem);
+        
+        m_ruleTable->setItem(row, 4, new QTableWidgetItem(scheduleName(rule)));
+        m_ruleTable->setItem(row, 5, new QTableWidgetItem(dates));
+    }
+}
+
+RecurringRule MainWindow::RecurringDialog::ruleFromForm() const
+{
+    RecurringRule rule;
+    rule.description = m_descriptionEdit->text().toStdString();
+    rule.category = m_categoryComboBox->currentText().toStdString();
+    rule.amount = m_amountSpinBox->value();
+    rule.frequency = static_cast<RecurrenceFrequency>(m_frequencyComboBox->currentData().toInt());
+    rule.interval = m_intervalSpinBox->value();
+    rule.startDate = m_startDateEdit->date().toString("yyyy-MM-dd").toStdString();
+    if (m_endCheckBox->isChecked()) {
+        rule.endDate = m_endDateEdit->date().toString("yyyy-MM-dd").toStdString();
+    }
+    return rule;
+}
+
+int MainWindow::RecurringDialog::selectedRuleId() const
+{
+    QList<QTableWidgetItem*> selectedItems = m_ruleTable->selectedItems();
+    if (selectedItems.isEmpty()) {
+        return -1;
+    }
+    
+    return m_ruleTable->item(selectedItems.first()->row(), 0)->text().toInt();
+}
+
+void MainWindow::RecurringDialog::addRule()
+{
+    if (m_descriptionEdit->text().trimmed().isEmpty()) {
+        QMessageBox::warning(this, "Warning", "Please enter a description.");
+        return;
+    }
+    
+    if (m_manager->addRecurringRule(ruleFromForm())) {
+        refreshRules();
+        m_descriptionEdit->clear();
+    } else {
+        QMessageBox::critical(this, "Error", "Failed to add recurring expense. Check that the end date is after the first date.");
+    }
+}
+
+void MainWindow::RecurringDialog::updateRule()
+{
+    int ruleId = selectedRuleId();
+    if (ruleId < 0) {
+        QMessageBox::warning(this, "Warning", "Please select a recurring expense to update.");
+        return;
+    }
+    
+    // Occurrences already added stay as they are; the change applies from now on
+    if (m_manager->updateRecurringRule(ruleId, ruleFromForm())) {
+        refreshRules();
+    } else {
+        QMessageBox::critical(this, "Error", "Failed to update recurring expense.");
+    }
+}
+
+void MainWindow::RecurringDialog::deleteRule()
+{
+    int ruleId = selectedRuleId();
+    if (ruleId < 0) {
+        QMessageBox::warning(this, "Warning", "Please select a recurring expense to delete.");
+        return;
+    }
+    
+    if (QMessageBox::question(this, "Delete Recurring Expense",
+                            "Stop this recurring expense? Expenses it already added are kept.",
+                            QMessageBox::Yes | QMessageBox::No) == QMessageBox::Yes) {
+        if (m_manager->deleteRecurringRule(ruleId)) {
+            refreshRules();
+        } else {
+            QMessageBox::critical(this, "Error", "Failed to delete recurring expense.");
+        }
+    }
+}
+
+void MainWindow::RecurringDialog::selectRule(int row, int column)
+{
+    Q_UNUSED(column);
+    
+    int ruleId = m_ruleTable->item(row, 0)->text().toInt();
+    for (const auto& rule : m_manager->getRecurringRules()) {
+        if (rule.id != ruleId) {
+            continue;
+        }
+        
+        m_descriptionEdit->setText(QString::fromStdString(rule.description));
+        m_categoryComboBox->setCurrentText(QString::fromStdString(rule.category));
+        m_amountSpinBox->setValue(rule.amount);
+        m_frequencyComboBox->setCurrentIndex(m_frequencyComboBox->findData(static_cast<int>(rule.frequency)));
+        m_intervalSpinBox->setValue(rule.interval);
+        m_startDateEdit->setDate(QDate::fromString(QString::fromStdString(rule.startDate), "yyyy-MM-dd"));
+        m_endCheckBox->setChecked(!rule.endDate.empty());
+        if (!rule.endDate.empty()) {
+            m_endDateEdit->setDate(QDate::fromString(QString::fromStdString(rule.endDate), "yyyy-MM-dd"));
+        }
+    }
+}
+
+// DuplicateDialog implementation
+MainWindow::DuplicateDialog::DuplicateDialog(ExpenseManager* manager, QWidget* parent)
+    : QDialog(parent), m_manager(manager)
+{
+    setWindowTitle("Duplicates");
+    setMinimumSize(650, 450);
+    
+    setupUI();
+}
+
+void MainWindow::DuplicateDialog::setupUI()
+{
+    QVBoxLayout* mainLayout = new QVBoxLayout(this);
+    
+    // Create form for the policy applied to new expenses
+    QGroupBox* policyGroupBox = new QGroupBox("When a New Expense Matches an Existing One");
+    QFormLayout* formLayout = new QFormLayout(policyGroupBox);
+    
+    m_policyComboBox = new QComboBox();
+    m_policyComboBox->addItem("Add it", static_cast<int>(DuplicatePolicy::Allow));
+    m_policyComboBox->addItem("Ask / report it", static_cast<int>(DuplicatePolicy::Flag));
+    m_policyComboBox->addItem("Skip it", static_cast<int>(DuplicatePolicy::Reject));
+    m_policyComboBox->setCurrentIndex(m_policyComboBox->findData(static_cast<int>(m_manager->getDuplicatePolicy())));
+    
+    m_windowSpinBox = new QSpinBox();
+    m_windowSpinBox->setRange(0, 31);
+    m_windowSpinBox->setSuffix(" days");
+    m_windowSpinBox->setValue(m_manager->getDuplicateWindow());
+    
+    formLayout->addRow("Action:", m_policyComboBox);
+    formLayout->addRow("Date tolerance:", m_windowSpinBox);
+    
+    // Create table of duplicate groups
+    m_groupTable = new QTableWidget();
+    m_groupTable->setColumnCount(5);
+    m_groupTable->setHorizontalHeaderLabels({"Kept", "Date", "Description", "Amount", "Duplicates"});
+    m_groupTable->setSelectionBehavior(QAbstractItemView::SelectRows);
+    m_groupTable->setEditTriggers(QAbstractItemView::NoEditTriggers);
+    m_groupTable->horizontalHeader()->setSectionResizeMode(2, QHeaderView::Stretch);
+    m_groupTable->verticalHeader()->setVisible(false);
+    
+    m_summaryLabel = new QLabel("Scan the ledger for expenses entered more than once.");
+    
+    // Create buttons
+    QHBoxLayout* buttonLayout = new QHBoxLayout();
+    
+    m_scanButton = new QPushButton("Scan");
+    m_deleteButton = new QPushButton("Delete Duplicates");
+    m_deleteButton->setEnabled(false);
+    
+    buttonLayout->addWidget(m_scanButton);
+    buttonLayout->addWidget(m_deleteButton);
+    
+    // Close button
+    QPushButton* closeButton = new QPushButton("Close");
+    
+    // Add all widgets to main layout
+    mainLayout->addWidget(policyGroupBox);
+    mainLayout->addWidget(m_summaryLabel);
+    mainLayout->addWidget(m_groupTable);
+    mainLayout->addLayout(buttonLayout);
+    mainLayout->addWidget(closeButton);
+    
+    // Connect signals and slots
+    connect(m_policyComboBox, static_cast<void (QComboBox::*)(int)>(&QComboBox::currentIndexChanged),
+            this, &DuplicateDialog::applyPolicy);
+    connect(m_windowSpinBox, static_cast<void (QSpinBox::*)(int)>(&QSpinBox::valueChanged),
+            this, &DuplicateDialog::applyPolicy);
+    connect(m_scanButton, &QPushButton::clicked, this, &DuplicateDialog::scan);
+    connect(m_deleteButton, &QPushButton::clicked, this, &DuplicateDialog::deleteDuplicates);
+    connect(closeButton, &QPushButton::clicked, this, &QDialog::accept);
+}
+
+void MainWindow::DuplicateDialog::applyPolicy()
+{
+    if (!m_manager->setDuplicatePolicy(static_cast<DuplicatePolicy>(m_policyComboBox->currentData().toInt()),
+                                       m_windowSpinBox->value())) {
+        QMessageBox::critical(this, "Error", "Failed to save the duplicate settings.");
+    }
+}
+
+void MainWindow::DuplicateDialog::scan()
+{
+    // Runs on every core; the ledger stays editable meanwhile
+    QApplication::setOverrideCursor(Qt::WaitCursor);
+    m_groups = m_manager->findDuplicateGroups();
+    QApplication::restoreOverrideCursor();
+    
+    m_groupTable->setRowCount(0);
+    size_t duplicateCount = 0;
+    for (const auto& group : m_groups) {
+        int row = m_groupTable->rowCount();
+        m_groupTable->insertRow(row);
+        
+        QStringList ids;
+        for (const auto& duplicate : group.duplicates) {
+            ids << QString("%1 (%2)").arg(duplicate.id).arg(QString::fromStdString(duplicate.date));
+        }
+        duplicateCount += group.duplicates.size();
+        
+        m_groupTable->setItem(row, 0, new QTableWidgetItem(QString::number(group.keeper.id)));
+        m_groupTable->setItem(row, 1, new QTableWidgetItem(QString::fromStdString(group.keeper.date)));
+        m_groupTable->setItem(row, 2, new QTableWidgetItem(QString::fromStdString(group.keeper.description)));
+        
+        QTableWidgetItem* amountItem = new QTableWidgetItem(QString("$%1").arg(group.keeper.amount, 0, 'f', 2));
+        amountItem->setTextAlignment(Qt::AlignRight | Qt::AlignVCenter);
+        m_groupTable->setItem(row, 3, amountItem);
+        
+        m_groupTable->setItem(row, 4, new QTableWidgetItem(ids.join(", ")));
+    }
+    
+    m_summaryLabel->setText(QString("%1 duplicate expenses in %2 groups. The earliest of each group is kept.")
+                            .arg(static_cast<qulonglong>(duplicateCount))
+                            .arg(static_cast<qulonglong>(m_groups.size())));
+    m_deleteButton->setEnabled(duplicateCount > 0);
+}
+
+void MainWindow::DuplicateDialog::deleteDuplicates()
+{
+    std::vector<int> ids;
+    for (const auto& group : m_groups) {
+        for (const auto& duplicate : group.duplicates) {
+            ids.push_back(duplicate.id);
+        }
+    }
+    
+    if (QMessageBox::question(this, "Delete Duplicates",
+                            QString("Delete %1 duplicate expenses?").arg(static_cast<qulonglong>(ids.size())),
+                            QMessageBox::Yes | QMessageBox::No) != QMessageBox::Yes) {
+        return;
+    }
+    
+    if (!m_manager->deleteExpenses(ids)) {
+        QMessageBox::critical(this, "Error", "Failed to delete some duplicates.");
+    }
+    scan();
+}
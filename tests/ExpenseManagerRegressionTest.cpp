@@ -0,0 +1,267 @@
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "core/ExpenseImporter.h"
+#include "core/ExpenseManager.h"
+
+// Checks for bugs that were fixed once and must stay fixed. Each runs on a
+// fresh ledger in its own directory under the system temp directory.
+
+namespace {
+
+int failures = 0;
+
+void check(bool condition, const std::string& message)
+{
+    if (!condition) {
+        std::cerr << "FAIL: " << message << std::endl;
+        ++failures;
+    }
+}
+
+std::string freshLedger(const std::string& name)
+{
+    fs::path directory = fs::temp_directory_path() / "pfm_regression" / name;
+    fs::remove_all(directory);
+    fs::create_directories(directory);
+    return (directory / "expenses.json").string();
+}
+
+// A weekly rule under a 7-day reject window used to match its own previous
+// occurrence, which was then skipped for good
+void recurringOccurrencesBypassDuplicateDetection()
+{
+    ExpenseManager manager(freshLedger("recurring_duplicates"));
+    manager.setDuplicatePolicy(DuplicatePolicy::Reject, 7);
+    
+    RecurringRule rule;
+    rule.amount = 12.5;
+    rule.description = "Cleaner";
+    rule.category = "Housing";
+    rule.frequency = RecurrenceFrequency::Weekly;
+    rule.startDate = "2099-01-01";
+    check(manager.addRecurringRule(rule), "weekly rule is added");
+    
+    check(manager.materializeRecurring("2099-01-10") == 2, "first catch-up adds 01-01 and 01-08");
+    check(manager.materializeRecurring("2099-01-31") == 3, "second catch-up adds 01-15, 01-22 and 01-29");
+    check(manager.getExpensesByMonth(2099, 1, false).size() == 5, "all five occurrences are stored");
+}
+
+// A Latin-1 description used to be imported, fail the save, and stay in
+// memory until restart
+void invalidUtf8IsRejectedPerRow()
+{
+    ExpenseManager manager(freshLedger("invalid_utf8"));
+    ExpenseImporter importer(&manager);
+    std::string csv = "Date,Amount,Category,Description\n"
+                      "2099-03-01,3.50,Food,Caf\xe9 latte\n"
+                      "2099-03-02,4.00,Food,Caf\xc3\xa9 au lait\n";
+    ImportResult result = importer.importBuffer(csv.data(), csv.size(), ImportFormat::Csv);
+    check(result.success && result.rowsImported == 1, "the UTF-8 row is imported");
+    check(result.errors.size() == 1 && result.errors[0].line == 2, "the Latin-1 row is rejected on its own line");
+    
+    // A batch that cannot be saved is rolled back as a whole
+    check(!manager.addExpenses({Expense(0, 1.0, "Caf\xe9", "Food", "2099-03-03")}), "unsavable batch fails");
+    check(manager.getExpensesByMonth(2099, 3, false).size() == 1, "the failed batch is not left in memory");
+    check(manager.undoDescription() == "Add expense", "the failed batch is not logged");
+    check(!manager.addExpense(Expense(0, 1.0, "Caf\xe9", "Food", "2099-03-04")), "unsavable single add fails");
+    check(manager.getExpensesByMonth(2099, 3, false).size() == 1 && manager.undoDescription() == "Add expense",
+          "a failed single add is rolled back the same way");
+}
+
+// Edits to a ledger whose manifest could not be read used to change memory
+// and only fail at save time, so they showed up until the next restart
+void readOnlyLedgerRefusesEdits()
+{
+    std::string dataFile = freshLedger("read_only");
+    {
+        ExpenseManager manager(dataFile);
+        manager.addExpense(Expense(0, 20.0, "Groceries", "Food", "2099-05-01"));
+    }
+    std::ofstream(dataFile) << "{\"categories\": [";
+    
+    ExpenseManager manager(dataFile);
+    check(manager.isReadOnly(), "a damaged manifest opens read-only");
+    check(!manager.addExpense(Expense(0, 5.0, "Coffee", "Food", "2099-05-02")), "adding is refused");
+    check(!manager.addCategory(Category("Travel", "")), "adding a category is refused");
+    check(!manager.setDuplicatePolicy(DuplicatePolicy::Reject, 0), "changing settings is refused");
+    check(manager.getExpensesByMonth(2099, 5, false).empty(), "nothing was added in memory");
+    check(manager.getAllCategories().size() == 9 && !manager.canUndo(), "nothing else changed either");
+    
+    manager.recoverData();
+    check(!manager.isReadOnly() && manager.getExpensesByMonth(2099, 5, false).size() == 1,
+          "recovery brings the stored expense back and allows edits");
+}
+
+// Editing or deleting a row in a cold year used to load every year on disk
+void idLookupLoadsOnlyItsYear()
+{
+    std::string dataFile = freshLedger("id_lookup");
+    {
+        ExpenseManager manager(dataFile);
+        for (int year = 2090; year <= 2095; ++year) {
+            manager.addExpense(Expense(0, year - 2000.0, "Rent " + std::to_string(year), "Housing",
+                                       std::to_string(year) + "-02-01"));
+        }
+    }
+    
+    ExpenseManager manager(dataFile);
+    Expense expense;
+    check(manager.getExpense(2, expense) && expense.date == "2091-02-01", "a cold row is found by id");
+    check(manager.getLoadedYears() == std::vector<int>{2091}, "only its year is loaded to find it");
+    check(manager.updateExpense(5, Expense(5, 120.0, "Rent 2094", "Housing", "2094-02-01")), "a cold row is updated");
+    check(manager.getLoadedYears() == std::vector<int>{2091, 2094}, "only its year is loaded to update it");
+    check(manager.deleteExpenses({1, 6}), "cold rows are deleted by id");
+    check(!manager.deleteExpense(42), "an unknown id is not deleted");
+    check(manager.getLoadedYears() == std::vector<int>{2091, 2094}, "an unknown id loads nothing");
+}
+
+// Partitions used to be rewritten in place before the manifest holding their
+// checksums, so a save that failed in between made the year look damaged
+void failedManifestWriteKeepsLastSave()
+{
+    std::string dataFile = freshLedger("failed_manifest");
+    {
+        ExpenseManager manager(dataFile);
+        manager.addExpense(Expense(0, 20.0, "Groceries", "Food", "2099-06-01"));
+        
+        // A directory where the manifest's temporary file goes makes its write fail
+        fs::create_directory(dataFile + ".tmp");
+        check(!manager.addExpense(Expense(0, 5.0, "Coffee", "Food", "2099-06-02")), "the failed save is reported");
+    }
+    fs::remove(dataFile + ".tmp");
+    
+    ExpenseManager manager(dataFile);
+    std::vector<Expense> rows = manager.getExpensesByMonth(2099, 6, false);
+    check(manager.verifyStorage().ok(), "the ledger is not damaged");
+    check(rows.size() == 1 && rows[0].description == "Groceries", "the last completed save is loaded");
+    
+    size_t files = 0;
+    for (const auto& entry : fs::directory_iterator(fs::path(dataFile).parent_path())) {
+        files += entry.path().filename().string().compare(0, 14, "expenses.2099.") == 0 ? 1 : 0;
+    }
+    check(files == 1, "the partition written for the failed save is removed");
+}
+
+// A limited search used to return the last rows inserted, so importing an
+// old statement after recent entries pushed the recent ones out
+void limitedSearchKeepsNewestDates()
+{
+    ExpenseManager manager(freshLedger("search_limit"));
+    manager.setDuplicatePolicy(DuplicatePolicy::Allow, 0);
+    manager.addExpense(Expense(0, 3.0, "Coffee beans", "Food", "2099-07-25"));
+    manager.addExpense(Expense(0, 3.0, "Coffee beans", "Food", "2099-07-20"));
+    manager.addExpenses({Expense(0, 3.0, "Coffee beans", "Food", "2099-07-03"),
+                         Expense(0, 3.0, "Coffee beans", "Food", "2098-11-14")});
+    
+    SearchFilters filters;
+    filters.limit = 2;
+    std::vector<Expense> found = manager.searchExpenses("coffee", filters);
+    check(found.size() == 2 && found[0].date == "2099-07-25" && found[1].date == "2099-07-20",
+          "text search returns the newest dates");
+    
+    filters.limit = 1;
+    filters.fromDate = "2099-07-01";
+    found = manager.searchExpenses("", filters);
+    check(found.size() == 1 && found[0].date == "2099-07-25", "a month is cut by date, not by id");
+}
+
+// Every logged bulk add used to keep a copy of all its rows for the whole
+// session; now only their ids are kept until it is undone
+void undoLogKeepsIdsOfAddedRows()
+{
+    ExpenseManager manager(freshLedger("undo_rows"));
+    manager.setDuplicatePolicy(DuplicatePolicy::Allow, 0);
+    std::vector<Expense> batch;
+    for (int i = 0; i < 3; ++i) {
+        batch.push_back(Expense(0, 1.0 + i, "Batch row", "Food", "2099-08-0" + std::to_string(i + 1)));
+    }
+    manager.addExpenses(batch);
+    manager.updateExpense(2, Expense(2, 9.0, "Edited row", "Food", "2099-08-02"));
+    
+    check(manager.undo() && manager.undo(), "the edit and the batch are undone");
+    check(manager.getExpensesByMonth(2099, 8, false).empty(), "the batch rows are gone");
+    check(manager.redo() && manager.redo(), "the batch and the edit are redone");
+    std::vector<Expense> rows = manager.getExpensesByMonth(2099, 8, false);
+    check(rows.size() == 3 && rows[1].id == 2 && rows[1].description == "Edited row",
+          "redo brings the rows back with their ids");
+}
+
+// Records used to be split on every newline, so a quoted multi-line memo
+// became two invalid rows, and a chunk could start inside one
+void quotedFieldsMaySpanLines()
+{
+    ExpenseManager manager(freshLedger("multiline_csv"));
+    manager.setDuplicatePolicy(DuplicatePolicy::Allow, 0);
+    ExpenseImporter importer(&manager);
+    importer.setChunkSize(4096);
+    
+    std::string csv = "Date,Amount,Category,\"Description\"\n";
+    for (int row = 0; row < 100; ++row) {
+        csv += "2099-10-01,2.00,Food,\"Card payment " + std::to_string(row) + "\r\n";
+        csv += "Reference \"\"" + std::string(60, 'x') + "\"\"\nEnd of memo\"\r\n";
+    }
+    csv += "2099-10-02,oops,Food,After the memos\n";
+    ImportResult result = importer.importBuffer(csv.data(), csv.size(), ImportFormat::Csv);
+    check(result.rowsImported == 100, "every multi-line row is imported across chunks");
+    check(result.errors.size() == 1 && result.errors[0].line == 302, "lines count the breaks inside quotes");
+    
+    std::vector<Expense> rows = manager.getExpensesByMonth(2099, 10, false);
+    check(!rows.empty() && rows[0].description.find("Card payment 0 Reference \"x") == 0 &&
+              rows[0].description.find("\n") == std::string::npos,
+          "line breaks in a memo become spaces");
+}
+
+// Negative amounts were rejected outright, so bank exports with negative
+// debits imported almost nothing; and a CSV mentioning OFX was read as OFX
+void bankCsvSignsAreDetected()
+{
+    ExpenseManager manager(freshLedger("amount_sign"));
+    manager.setDuplicatePolicy(DuplicatePolicy::Allow, 0);
+    ExpenseImporter importer(&manager);
+    std::string bank = "Date,Amount,Category,Description\n"
+                       "2099-11-01,-12.50,Food,OFX test merchant\n"
+                       "2099-11-02,-40.00,Food,Groceries\n"
+                       "2099-11-03,1500.00,Food,Salary\n";
+    ImportResult result = importer.importBuffer(bank.data(), bank.size(), ImportFormat::Auto);
+    check(result.rowsImported == 2 && result.errors.size() == 1 && result.errors[0].line == 4,
+          "negative debits are imported and the credit is reported");
+    check(manager.getTotalExpenses(2099, 11) == 52.5, "debits are stored as positive expenses");
+    
+    std::string ledger = "Date,Amount,Category,Description\n"
+                         "2099-12-01,8.00,Food,Lunch\n"
+                         "2099-12-02,-8.00,Food,Lunch refund\n"
+                         "2099-12-03,9.00,Food,Dinner\n";
+    result = importer.importBuffer(ledger.data(), ledger.size(), ImportFormat::Auto);
+    check(result.rowsImported == 2 && result.errors.size() == 1 && result.errors[0].line == 3,
+          "a mostly positive file keeps positive expenses");
+    
+    importer.setAmountSign(AmountSign::Negative);
+    result = importer.importBuffer(ledger.data(), ledger.size(), ImportFormat::Csv);
+    check(result.rowsImported == 1 && result.errors.size() == 2, "an explicit sign overrides the detection");
+}
+
+} // namespace
+
+int main()
+{
+    recurringOccurrencesBypassDuplicateDetection();
+    invalidUtf8IsRejectedPerRow();
+    readOnlyLedgerRefusesEdits();
+    idLookupLoadsOnlyItsYear();
+    failedManifestWriteKeepsLastSave();
+    limitedSearchKeepsNewestDates();
+    undoLogKeepsIdsOfAddedRows();
+    quotedFieldsMaySpanLines();
+    bankCsvSignsAreDetected();
+    
+    fs::remove_all(fs::temp_directory_path() / "pfm_regression");
+    if (failures > 0) {
+        std::cerr << failures << " check(s) failed" << std::endl;
+        return 1;
+    }
+    std::cout << "pfm_regression: all checks passed" << std::endl;
+    return 0;
+}
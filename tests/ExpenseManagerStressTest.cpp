@@ -0,0 +1,226 @@
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdlib>
+#include <filesystem>
+#include <iostream>
+#include <mutex>
+#include <set>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include "core/DateUtils.h"
+#include "core/ExpenseImporter.h"
+#include "core/ExpenseManager.h"
+
+// Concurrent readers against concurrent writers on one ledger. Meant to be
+// built with -DPFM_ENABLE_TSAN=ON, where ThreadSanitizer reports any access
+// the reader-writer lock misses; without it the test still checks that every
+// read sees a consistent ledger and that no write is lost.
+//
+//   pfm_stress [rounds]
+
+namespace {
+
+const int kReaders = 4;
+const int kDefaultRounds = 60;
+const int kImportRows = 50;
+const int kImportBatches = 10;
+
+std::atomic<int> failures(0);
+std::mutex outputMutex;
+
+void fail(const std::string& message)
+{
+    std::lock_guard<std::mutex> lock(outputMutex);
+    std::cerr << "FAIL: " << message << std::endl;
+    ++failures;
+}
+
+// Spread over this year and the last, so cold partitions are loaded and evicted
+std::string dateFor(int round)
+{
+    int year = DateUtils::currentYear() - round % 2;
+    return DateUtils::formatDate(year, round % 12 + 1, round % 28 + 1);
+}
+
+std::string csvBatch(int batch)
+{
+    std::ostringstream csv;
+    csv << "Date,Amount,Category,Description\n";
+    for (int row = 0; row < kImportRows; ++row) {
+        csv << dateFor(batch * kImportRows + row) << "," << (row + 1) << ".25,Utilities,Import " << batch << "-"
+            << row << "\n";
+    }
+    return csv.str();
+}
+
+void checkMonth(const ExpenseManager& manager, int year, int month)
+{
+    int previousId = 0;
+    for (const auto& expense : manager.getExpensesByMonth(year, month, false)) {
+        if (DateUtils::monthKey(expense.date) != DateUtils::monthKey(year, month)) {
+            fail("row " + std::to_string(expense.id) + " dated " + expense.date + " listed in " +
+                 std::to_string(DateUtils::monthKey(year, month)));
+        }
+        if (expense.id <= previousId) {
+            fail("month " + std::to_string(DateUtils::monthKey(year, month)) + " is not sorted by id");
+        }
+        previousId = expense.id;
+    }
+}
+
+void checkSummary(const ExpenseManager& manager, int year, int month)
+{
+    for (const auto& entry : manager.generateCategorySummary(year, month)) {
+        if (!std::isfinite(entry.second) || entry.second < -0.005) {
+            fail("category " + entry.first + " totals " + std::to_string(entry.second));
+        }
+    }
+}
+
+// Totals come from the month index and rows from the partitions; both must
+// describe the same ledger even when the query has to load a cold year
+void checkQuery(const ExpenseManager& manager)
+{
+    ExpenseQuery query;
+    query.fromDate = DateUtils::formatDate(DateUtils::currentYear() - 1, 6, 1);
+    query.toDate = DateUtils::formatDate(DateUtils::currentYear(), 6, 30);
+    QueryResult result = manager.query(query);
+    if (result.rows.size() != result.totalMatches) {
+        fail("query counted " + std::to_string(result.totalMatches) + " matches but returned " +
+             std::to_string(result.rows.size()) + " rows (" + result.plan + ")");
+    }
+}
+
+void checkSnapshot(const ExpenseManager& manager)
+{
+    auto snapshot = manager.snapshot();
+    std::set<int> ids;
+    size_t rows = 0;
+    snapshot->forEachExpense([&ids, &rows](const Expense& expense) {
+        ids.insert(expense.id);
+        ++rows;
+    });
+    if (rows != snapshot->expenseCount() || ids.size() != rows) {
+        fail("snapshot counts " + std::to_string(snapshot->expenseCount()) + " rows, holds " +
+             std::to_string(rows) + " with " + std::to_string(ids.size()) + " distinct ids");
+    }
+}
+
+} // namespace
+
+int main(int argc, char* argv[])
+{
+    int rounds = argc > 1 ? std::max(1, std::atoi(argv[1])) : kDefaultRounds;
+    fs::path directory = fs::temp_directory_path() / "pfm_stress";
+    fs::remove_all(directory);
+    fs::create_directories(directory);
+    
+    size_t kept = 0;
+    size_t imported = 0;
+    {
+        ThreadPool pool(2);  // Imports parse on it while readers run
+        ExpenseManager manager((directory / "expenses.json").string());
+        manager.setThreadPool(&pool);
+        manager.setDuplicatePolicy(DuplicatePolicy::Allow, 0);
+        manager.setMemoryBudget(64 * 1024);  // Keeps last year going in and out of the cache
+        
+        std::atomic<bool> writing(true);
+        std::vector<std::thread> readers;
+        for (int reader = 0; reader < kReaders; ++reader) {
+            readers.emplace_back([&manager, &writing, reader]() {
+                for (int round = reader; writing; ++round) {
+                    int year = DateUtils::currentYear() - round % 2;
+                    int month = round % 12 + 1;
+                    checkMonth(manager, year, month);
+                    checkSummary(manager, year, month);
+                    if (round % 8 == reader) {
+                        checkSnapshot(manager);
+                    } else if (round % 8 == reader + 4) {
+                        checkQuery(manager);
+                    }
+                }
+            });
+        }
+        
+        // Adds two rows a round and deletes one of them again
+        std::thread editor([&manager, &kept, rounds]() {
+            for (int round = 0; round < rounds; ++round) {
+                std::string date = dateFor(round);
+                manager.addExpense(Expense(0, 10.0 + round, "Keep " + std::to_string(round), "Food", date));
+                manager.addExpense(Expense(0, 5.0, "Drop " + std::to_string(round), "Food", date));
+                
+                int year = 0, month = 0, day = 0;
+                DateUtils::parseDate(date, year, month, day);
+                bool deleted = false;
+                for (const auto& expense : manager.getExpensesByMonth(year, month, false)) {
+                    if (expense.description == "Drop " + std::to_string(round)) {
+                        deleted = manager.deleteExpense(expense.id);
+                        break;
+                    }
+                }
+                if (!deleted) {
+                    fail("could not delete the row added in round " + std::to_string(round));
+                }
+                ++kept;
+            }
+        });
+        
+        std::thread importer([&manager, &imported]() {
+            ExpenseImporter expenseImporter(&manager);
+            expenseImporter.setThreadCount(2);
+            for (int batch = 0; batch < kImportBatches; ++batch) {
+                std::string csv = csvBatch(batch);
+                ImportResult result = expenseImporter.importBuffer(csv.data(), csv.size(), ImportFormat::Csv);
+                if (!result.success || result.rowsImported != static_cast<size_t>(kImportRows)) {
+                    fail("import batch " + std::to_string(batch) + " stored " +
+                         std::to_string(result.rowsImported) + " rows");
+                }
+                imported += result.rowsImported;
+            }
+        });
+        
+        editor.join();
+        importer.join();
+        writing = false;
+        for (auto& reader : readers) {
+            reader.join();
+        }
+        
+        // Nothing lost, and the running totals agree with the rows
+        auto snapshot = manager.snapshot();
+        if (snapshot->expenseCount() != kept + imported) {
+            fail("ledger holds " + std::to_string(snapshot->expenseCount()) + " rows, expected " +
+                 std::to_string(kept + imported));
+        }
+        for (int year = DateUtils::currentYear() - 1; year <= DateUtils::currentYear(); ++year) {
+            for (int month = 1; month <= 12; ++month) {
+                double total = manager.getTotalExpenses(year, month);
+                if (std::fabs(total - snapshot->getTotalExpenses(year, month)) > 0.005) {
+                    fail("running total of " + std::to_string(DateUtils::monthKey(year, month)) +
+                         " disagrees with its rows");
+                }
+            }
+        }
+    }
+    
+    // And everything was saved
+    {
+        ExpenseManager reopened((directory / "expenses.json").string());
+        size_t rows = reopened.snapshot()->expenseCount();
+        if (rows != kept + imported) {
+            fail("reopened ledger holds " + std::to_string(rows) + " rows");
+        }
+    }
+    
+    fs::remove_all(directory);
+    if (failures > 0) {
+        std::cerr << failures << " check(s) failed" << std::endl;
+        return 1;
+    }
+    std::cout << "pfm_stress: " << kept + imported << " rows written while " << kReaders
+              << " readers checked the ledger" << std::endl;
+    return 0;
+}